@@ -32,8 +32,8 @@ stage2_start:
 
     ; Initialize bootlog at 0x500 with magic
     mov dword [0x500], 0x424F4F54  ; "BOOT" magic
-    mov byte [0x500 + 2], 0  ; boot_method (0=CHS, 1=EDD, 2=error)
-    mov byte [0x500 + 3], 0  ; retry_count
+    mov byte [0x500 + 6], 0  ; boot_method (0=CHS, 1=EDD, 2=error)
+    mov byte [0x500 + 7], 0  ; retry_count
     
     ; Detect memory size using INT 15h E820
     call detect_memory
@@ -143,13 +143,16 @@ detect_memory:
     mov edi, 0x620       ; Buffer at 0x620
     
     mov dword [0x500 + 0x0C], 0  ; Initialize memory field to 0
+    mov dword [0x500 + 0x70], 0  ; e820_count: entries kept at 0x620 for the kernel
     
 .memory_loop:
     mov eax, 0xE820
     mov ecx, 24          ; Structure size
+    mov edx, 0x534D4150  ; "SMAP" again; edx is reused for the total below
     int 0x15
     
     jc .memory_done
+    inc dword [0x500 + 0x70]
     
     ; Check entry type (offset 20)
     cmp dword [edi + 20], 1  ; Type 1 = usable memory
@@ -165,6 +168,8 @@ detect_memory:
 .memory_next:
     cmp ebx, 0
     je .memory_done
+    cmp dword [0x500 + 0x70], 32  ; BOOTLOG_E820_MAX
+    jae .memory_done
     
     ; Move buffer forward for next entry
     add edi, 24
@@ -1,4 +1,5 @@
 #include "disk.h"
+#include "include/kernel/clock.h"
 
 /* Performance counters */
 static uint32_t g_disk_reads = 0;
@@ -7,18 +8,14 @@ static uint32_t g_disk_multi_reads = 0;
 static uint32_t g_disk_multi_writes = 0;
 static uint32_t g_disk_read_sectors = 0;
 static uint32_t g_disk_write_sectors = 0;
+static uint32_t g_disk_read_us = 0;
+static uint32_t g_disk_write_us = 0;
 
-/* I/O Port Functions */
-static inline uint8_t inb(uint16_t port) {
-    uint8_t result;
-    __asm__ volatile("inb %1, %0" : "=a"(result) : "Nd"(port));
-    return result;
-}
-
-static inline void outb(uint16_t port, uint8_t value) {
-    __asm__ volatile("outb %0, %1" : : "a"(value), "Nd"(port));
+static uint32_t disk_elapsed_us(uint64_t start) {
+    return (uint32_t)div_u64_rem(ktime_ns() - start, NSEC_PER_USEC, 0);
 }
 
+/* I/O Port Functions */
 static inline uint16_t inw(uint16_t port) {
     uint16_t result;
     __asm__ volatile("inw %1, %0" : "=a"(result) : "Nd"(port));
@@ -112,6 +109,7 @@ int disk_read_sector(uint32_t lba, uint8_t *buffer) {
     if (!buffer) {
         return -1;
     }
+    uint64_t start = ktime_ns();
     
     /* Select drive */
     select_drive();
@@ -145,6 +143,7 @@ int disk_read_sector(uint32_t lba, uint8_t *buffer) {
     
     g_disk_reads++;
     g_disk_read_sectors++;
+    g_disk_read_us += disk_elapsed_us(start);
     return 0;  /* Success */
 }
 
@@ -153,6 +152,7 @@ int disk_write_sector(uint32_t lba, const uint8_t *buffer) {
     if (!buffer) {
         return -1;
     }
+    uint64_t start = ktime_ns();
     
     /* Select drive */
     select_drive();
@@ -196,6 +196,7 @@ int disk_write_sector(uint32_t lba, const uint8_t *buffer) {
     
     g_disk_writes++;
     g_disk_write_sectors++;
+    g_disk_write_us += disk_elapsed_us(start);
     return 0;  /* Success */
 }
 
@@ -204,6 +205,7 @@ static int disk_read_sectors_multi_pio(uint32_t lba, uint8_t *buffer, uint16_t n
     if (!buffer || num_sectors == 0 || num_sectors > 256) {
         return -1;
     }
+    uint64_t start = ktime_ns();
     
     select_drive();
     
@@ -235,6 +237,7 @@ static int disk_read_sectors_multi_pio(uint32_t lba, uint8_t *buffer, uint16_t n
     g_disk_multi_reads++;
     g_disk_reads++;
     g_disk_read_sectors += num_sectors;
+    g_disk_read_us += disk_elapsed_us(start);
     return 0;
 }
 
@@ -266,6 +269,7 @@ static int disk_write_sectors_multi_pio(uint32_t lba, const uint8_t *buffer, uin
     if (!buffer || num_sectors == 0 || num_sectors > 256) {
         return -1;
     }
+    uint64_t start = ktime_ns();
     
     select_drive();
     
@@ -305,6 +309,7 @@ static int disk_write_sectors_multi_pio(uint32_t lba, const uint8_t *buffer, uin
     g_disk_multi_writes++;
     g_disk_writes++;
     g_disk_write_sectors += num_sectors;
+    g_disk_write_us += disk_elapsed_us(start);
     return 0;
 }
 
@@ -371,6 +376,8 @@ void disk_get_stats(disk_stats_t *stats) {
         stats->write_multi_ops = g_disk_multi_writes;
         stats->read_sectors = g_disk_read_sectors;
         stats->write_sectors = g_disk_write_sectors;
+        stats->read_us = g_disk_read_us;
+        stats->write_us = g_disk_write_us;
     }
 }
 
@@ -382,4 +389,6 @@ void disk_reset_stats(void) {
     g_disk_multi_writes = 0;
     g_disk_read_sectors = 0;
     g_disk_write_sectors = 0;
+    g_disk_read_us = 0;
+    g_disk_write_us = 0;
 }
\ No newline at end of file
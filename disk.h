@@ -54,6 +54,8 @@ typedef struct {
     uint32_t write_multi_ops;
     uint32_t read_sectors;
     uint32_t write_sectors;
+    uint32_t read_us;           /* time spent in successful transfers */
+    uint32_t write_us;
 } disk_stats_t;
 
 /* Function Prototypes */
@@ -0,0 +1,123 @@
+#include "../../include/drivers/acpi.h"
+#include "../../include/kernel/paging.h"
+
+static const acpi_rsdp_t *acpi_rsdp = 0;
+static const acpi_sdt_header_t *acpi_root = 0;
+static int acpi_root_is_xsdt = 0;
+
+static int acpi_checksum_ok(const void *data, uint32_t length) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < length; i++) {
+        sum = (uint8_t)(sum + bytes[i]);
+    }
+    return sum == 0;
+}
+
+static int acpi_signature_matches(const char *a, const char *b, int length) {
+    for (int i = 0; i < length; i++) {
+        if (a[i] != b[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* The RSDP sits on a 16-byte boundary in the first KiB of the EBDA or
+ * in the BIOS read-only area between 0xE0000 and 0xFFFFF. */
+static const acpi_rsdp_t *acpi_scan_rsdp(uint32_t start, uint32_t end) {
+    for (uint32_t addr = start; addr + 20 <= end; addr += 16) {
+        const acpi_rsdp_t *rsdp = (const acpi_rsdp_t *)addr;
+        if (!acpi_signature_matches(rsdp->signature, ACPI_RSDP_SIGNATURE, 8)) {
+            continue;
+        }
+        if (acpi_checksum_ok(rsdp, 20)) {
+            return rsdp;
+        }
+    }
+    return 0;
+}
+
+static const acpi_sdt_header_t *acpi_map_table(uint64_t address) {
+    /* Tables above 4 GiB are out of reach of the flat 32-bit address space */
+    if (address == 0 || address > 0xFFFFFFFFull) {
+        return 0;
+    }
+    /* Tables sit in firmware-reserved RAM that paging does not map by
+     * itself; the header gives the length of the rest */
+    paging_map_identity((uint32_t)address, sizeof(acpi_sdt_header_t), PAGING_CACHE_WB);
+    const acpi_sdt_header_t *table = (const acpi_sdt_header_t *)(uint32_t)address;
+    if (table->length < sizeof(acpi_sdt_header_t) ||
+        paging_map_identity((uint32_t)address, table->length, PAGING_CACHE_WB) != 0 ||
+        !acpi_checksum_ok(table, table->length)) {
+        return 0;
+    }
+    return table;
+}
+
+int acpi_init(void) {
+    acpi_rsdp = 0;
+    acpi_root = 0;
+    acpi_root_is_xsdt = 0;
+
+    uint32_t ebda = (uint32_t)(*(volatile uint16_t *)ACPI_EBDA_SEGMENT_PTR) << 4;
+    if (ebda >= 0x80000 && ebda < 0xA0000) {
+        acpi_rsdp = acpi_scan_rsdp(ebda, ebda + 1024);
+    }
+    if (!acpi_rsdp) {
+        acpi_rsdp = acpi_scan_rsdp(ACPI_BIOS_AREA_START, ACPI_BIOS_AREA_END);
+    }
+    if (!acpi_rsdp) {
+        return -1;
+    }
+
+    if (acpi_rsdp->revision >= 2 && acpi_checksum_ok(acpi_rsdp, acpi_rsdp->length)) {
+        acpi_root = acpi_map_table(acpi_rsdp->xsdt_address);
+        acpi_root_is_xsdt = (acpi_root != 0);
+    }
+    if (!acpi_root) {
+        acpi_root = acpi_map_table(acpi_rsdp->rsdt_address);
+    }
+    return acpi_root ? 0 : -2;
+}
+
+int acpi_is_available(void) {
+    return acpi_root != 0;
+}
+
+const acpi_rsdp_t *acpi_get_rsdp(void) {
+    return acpi_rsdp;
+}
+
+const acpi_sdt_header_t *acpi_find_table(const char *signature) {
+    if (!acpi_root || !signature) {
+        return 0;
+    }
+
+    uint32_t entry_size = acpi_root_is_xsdt ? 8 : 4;
+    uint32_t entry_count = (acpi_root->length - sizeof(acpi_sdt_header_t)) / entry_size;
+    const uint8_t *entries = (const uint8_t *)acpi_root + sizeof(acpi_sdt_header_t);
+
+    for (uint32_t i = 0; i < entry_count; i++) {
+        uint64_t address;
+        if (acpi_root_is_xsdt) {
+            address = *(const uint64_t *)(entries + i * 8);
+        } else {
+            address = *(const uint32_t *)(entries + i * 4);
+        }
+        if (address == 0 || address > 0xFFFFFFFFull) {
+            continue;
+        }
+        /* Compare the signature before paying for a full checksum pass */
+        paging_map_identity((uint32_t)address, sizeof(acpi_sdt_header_t), PAGING_CACHE_WB);
+        const acpi_sdt_header_t *header = (const acpi_sdt_header_t *)(uint32_t)address;
+        if (!acpi_signature_matches(header->signature, signature, 4)) {
+            continue;
+        }
+        const acpi_sdt_header_t *table = acpi_map_table(address);
+        if (table) {
+            return table;
+        }
+    }
+    return 0;
+}
@@ -1,20 +1,13 @@
 #include "../../include/drivers/pci.h"
+#include "../../include/drivers/acpi.h"
+#include "../../include/kernel/paging.h"
 
 typedef unsigned char uint8_t;
 typedef unsigned short uint16_t;
 typedef unsigned int uint32_t;
+typedef unsigned long long uint64_t;
 
 /* I/O Port Functions */
-static inline uint8_t inb(uint16_t port) {
-    uint8_t result;
-    __asm__ volatile("inb %1, %0" : "=a"(result) : "Nd"(port));
-    return result;
-}
-
-static inline void outb(uint16_t port, uint8_t value) {
-    __asm__ volatile("outb %0, %1" : : "a"(value), "Nd"(port));
-}
-
 static inline uint16_t inw(uint16_t port) {
     uint16_t result;
     __asm__ volatile("inw %1, %0" : "=a"(result) : "Nd"(port));
@@ -38,41 +31,249 @@ static inline void outl(uint16_t port, uint32_t value) {
 #define PCI_CONFIG_ADDR 0xCF8
 #define PCI_CONFIG_DATA 0xCFC
 
+#define PCI_MAX_ECAM_REGIONS 4
+
+/* One MCFG allocation: a window of 1 MiB per bus on segment 0 */
+typedef struct {
+    uint32_t base;
+    uint8_t start_bus;
+    uint8_t end_bus;
+} pci_ecam_region_t;
+
+static pci_ecam_region_t pci_ecam_regions[PCI_MAX_ECAM_REGIONS];
+static int pci_ecam_count = 0;
+
 static pci_device_t pci_devices[PCI_MAX_DEVICES];
 static int pci_device_count = 0;
+static pci_scan_stats_t pci_stats;
+static uint32_t pci_bus_visited[256 / 32];
+
+/* Pick up ECAM windows from the ACPI MCFG table. Only segment 0 is used,
+ * since bus numbers are the only addressing the rest of the code knows. */
+static void pci_ecam_init(void) {
+    pci_ecam_count = 0;
+
+    const acpi_mcfg_t *mcfg = (const acpi_mcfg_t *)acpi_find_table("MCFG");
+    if (!mcfg || mcfg->header.length < sizeof(acpi_mcfg_t)) {
+        return;
+    }
 
-/* Read a PCI configuration register using mechanism 1 */
-uint32_t pci_read_config(uint8_t bus, uint8_t dev, uint8_t fn, uint8_t offset) {
+    uint32_t entry_count = (mcfg->header.length - sizeof(acpi_mcfg_t)) / sizeof(acpi_mcfg_entry_t);
+    const acpi_mcfg_entry_t *entries = (const acpi_mcfg_entry_t *)(mcfg + 1);
+    for (uint32_t i = 0; i < entry_count && pci_ecam_count < PCI_MAX_ECAM_REGIONS; i++) {
+        const acpi_mcfg_entry_t *entry = &entries[i];
+        if (entry->segment_group != 0 || entry->end_bus < entry->start_bus) {
+            continue;
+        }
+        /* base_address is where bus 0 would be, even if the entry starts later */
+        uint64_t window_start = entry->base_address + ((uint64_t)entry->start_bus << 20);
+        uint64_t window_end = entry->base_address + ((uint64_t)(entry->end_bus + 1) << 20) - 1;
+        if (entry->base_address == 0 || window_end > 0xFFFFFFFFull) {
+            continue;
+        }
+        paging_map_mmio((uint32_t)window_start, (uint32_t)(window_end - window_start + 1));
+        pci_ecam_regions[pci_ecam_count].base = (uint32_t)entry->base_address;
+        pci_ecam_regions[pci_ecam_count].start_bus = entry->start_bus;
+        pci_ecam_regions[pci_ecam_count].end_bus = entry->end_bus;
+        pci_ecam_count++;
+    }
+}
+
+static volatile uint32_t *pci_ecam_address(uint8_t bus, uint8_t dev, uint8_t fn, uint16_t offset) {
+    for (int i = 0; i < pci_ecam_count; i++) {
+        const pci_ecam_region_t *region = &pci_ecam_regions[i];
+        if (bus < region->start_bus || bus > region->end_bus) {
+            continue;
+        }
+        uint32_t addr = region->base +
+                        (((uint32_t)bus << 20) |
+                         ((uint32_t)dev << 15) | ((uint32_t)fn << 12) | (offset & 0xFFC));
+        return (volatile uint32_t *)addr;
+    }
+    return 0;
+}
+
+int pci_ecam_available(void) {
+    return pci_ecam_count > 0;
+}
+
+/* Read a PCI configuration register through ECAM when the bus is covered
+ * by MCFG, otherwise through mechanism 1 (which stops at offset 0xFF) */
+uint32_t pci_read_config(uint8_t bus, uint8_t dev, uint8_t fn, uint16_t offset) {
+    pci_stats.config_reads++;
+    if (offset >= PCI_EXT_CONFIG_SPACE_SIZE) {
+        return 0xFFFFFFFF;
+    }
+    volatile uint32_t *ecam = pci_ecam_address(bus, dev, fn, offset);
+    if (ecam) {
+        return *ecam;
+    }
+    if (offset >= PCI_CONFIG_SPACE_SIZE) {
+        return 0xFFFFFFFF;
+    }
     uint32_t addr = 0x80000000 | ((uint32_t)bus << 16) | ((uint32_t)dev << 11) | ((uint32_t)fn << 8) | (offset & 0xFC);
     outl(PCI_CONFIG_ADDR, addr);
     return inl(PCI_CONFIG_DATA);
 }
 
-void pci_write_config(uint8_t bus, uint8_t dev, uint8_t fn, uint8_t offset, uint32_t value) {
+void pci_write_config(uint8_t bus, uint8_t dev, uint8_t fn, uint16_t offset, uint32_t value) {
+    if (offset >= PCI_EXT_CONFIG_SPACE_SIZE) {
+        return;
+    }
+    volatile uint32_t *ecam = pci_ecam_address(bus, dev, fn, offset);
+    if (ecam) {
+        *ecam = value;
+        return;
+    }
+    if (offset >= PCI_CONFIG_SPACE_SIZE) {
+        return;
+    }
     uint32_t addr = 0x80000000 | ((uint32_t)bus << 16) | ((uint32_t)dev << 11) | ((uint32_t)fn << 8) | (offset & 0xFC);
     outl(PCI_CONFIG_ADDR, addr);
     outl(PCI_CONFIG_DATA, value);
 }
 
 /* Get a value from a specific byte offset in config space */
-static uint8_t pci_read_byte(uint8_t bus, uint8_t dev, uint8_t fn, uint8_t offset) {
+static uint8_t pci_read_byte(uint8_t bus, uint8_t dev, uint8_t fn, uint16_t offset) {
     uint32_t data = pci_read_config(bus, dev, fn, offset);
     return (data >> ((offset & 3) * 8)) & 0xFF;
 }
 
-static uint16_t pci_read_word(uint8_t bus, uint8_t dev, uint8_t fn, uint8_t offset) {
+static uint16_t pci_read_word(uint8_t bus, uint8_t dev, uint8_t fn, uint16_t offset) {
     uint32_t data = pci_read_config(bus, dev, fn, offset);
     return (data >> ((offset & 2) * 8)) & 0xFFFF;
 }
 
-/* Get BAR with proper size detection */
-uint32_t pci_get_bar(pci_device_t *dev, int bar_index) {
-    if (bar_index < 0 || bar_index >= 6) {
+uint64_t pci_get_bar(pci_device_t *dev, int bar_index) {
+    if (!dev || bar_index < 0 || bar_index >= 6) {
         return 0;
     }
     return dev->bar[bar_index];
 }
 
+uint64_t pci_get_bar_size(pci_device_t *dev, int bar_index) {
+    if (!dev || bar_index < 0 || bar_index >= 6) {
+        return 0;
+    }
+    return dev->bar_size[bar_index];
+}
+
+/* Return an uncached identity mapping of a memory BAR, or 0 if it is absent,
+ * an I/O BAR, or placed above 4 GiB where 32-bit paging cannot reach. */
+volatile void *pci_map_bar(pci_device_t *dev, int bar_index) {
+    if (!dev || bar_index < 0 || bar_index >= 6) {
+        return 0;
+    }
+    uint8_t type = dev->bar_type[bar_index];
+    if (type != PCI_BAR_TYPE_MEM32 && type != PCI_BAR_TYPE_MEM64) {
+        return 0;
+    }
+    uint64_t base = dev->bar[bar_index];
+    uint64_t size = dev->bar_size[bar_index];
+    if (base == 0 || size == 0 || base + size - 1 > 0xFFFFFFFFull) {
+        return 0;
+    }
+    return paging_map_mmio((uint32_t)base, (uint32_t)size);
+}
+
+/* Decode type and base of every BAR and size it with the all-ones probe.
+ * Decoding is switched off while probing so the device never responds at
+ * the temporary all-ones address. */
+static void pci_decode_bars(pci_device_t *d, int bar_count) {
+    /* Only the low word is written back so RW1C status bits stay untouched */
+    uint32_t command = pci_read_config(d->bus, d->dev, d->fn, PCI_COMMAND) & 0xFFFF;
+    pci_write_config(d->bus, d->dev, d->fn, PCI_COMMAND,
+                     command & ~(uint32_t)(PCI_CMD_IO_SPACE | PCI_CMD_MEMORY_SPACE));
+
+    for (int i = 0; i < bar_count; i++) {
+        uint16_t offset = (uint16_t)(PCI_BAR0 + i * 4);
+        uint32_t original = pci_read_config(d->bus, d->dev, d->fn, offset);
+
+        pci_write_config(d->bus, d->dev, d->fn, offset, 0xFFFFFFFF);
+        uint32_t probe = pci_read_config(d->bus, d->dev, d->fn, offset);
+        pci_write_config(d->bus, d->dev, d->fn, offset, original);
+
+        if (probe == 0 || probe == 0xFFFFFFFF) {
+            continue;
+        }
+
+        if (original & PCI_BAR_SPACE_IO) {
+            uint32_t mask = probe & PCI_BAR_IO_ADDR_MASK;
+            d->bar_type[i] = PCI_BAR_TYPE_IO;
+            d->bar[i] = original & PCI_BAR_IO_ADDR_MASK;
+            d->bar_size[i] = (~mask + 1) & 0xFFFF;
+            continue;
+        }
+
+        d->bar_prefetchable[i] = (original & PCI_BAR_MEM_PREFETCH) ? 1 : 0;
+        uint64_t base = original & PCI_BAR_MEM_ADDR_MASK;
+        uint64_t mask = 0xFFFFFFFF00000000ull | (probe & PCI_BAR_MEM_ADDR_MASK);
+
+        if ((original & PCI_BAR_MEM_TYPE_MASK) == PCI_BAR_MEM_TYPE_64 && i + 1 < bar_count) {
+            uint16_t high_offset = (uint16_t)(offset + 4);
+            uint32_t original_high = pci_read_config(d->bus, d->dev, d->fn, high_offset);
+            pci_write_config(d->bus, d->dev, d->fn, high_offset, 0xFFFFFFFF);
+            uint32_t probe_high = pci_read_config(d->bus, d->dev, d->fn, high_offset);
+            pci_write_config(d->bus, d->dev, d->fn, high_offset, original_high);
+
+            base |= (uint64_t)original_high << 32;
+            mask = ((uint64_t)probe_high << 32) | (probe & PCI_BAR_MEM_ADDR_MASK);
+            d->bar_type[i] = PCI_BAR_TYPE_MEM64;
+            d->bar_type[i + 1] = PCI_BAR_TYPE_UPPER;
+            d->bar[i] = base;
+            d->bar_size[i] = ~mask + 1;
+            i++;
+            continue;
+        }
+
+        d->bar_type[i] = PCI_BAR_TYPE_MEM32;
+        d->bar[i] = base;
+        d->bar_size[i] = (~mask + 1) & 0xFFFFFFFFull;
+    }
+
+    pci_write_config(d->bus, d->dev, d->fn, PCI_COMMAND, command);
+}
+
+/* Walk the classic capability list; returns the capability offset or 0 */
+uint8_t pci_find_capability(pci_device_t *dev, uint8_t cap_id) {
+    if (!dev) {
+        return 0;
+    }
+    uint16_t status = pci_read_word(dev->bus, dev->dev, dev->fn, PCI_STATUS);
+    if ((status & PCI_STATUS_CAP_LIST) == 0) {
+        return 0;
+    }
+    uint8_t ptr = pci_read_byte(dev->bus, dev->dev, dev->fn, PCI_CAPABILITY_LIST) & 0xFC;
+    /* At most 48 capabilities fit in the 192 bytes after the header */
+    for (int guard = 0; ptr >= 0x40 && guard < 48; guard++) {
+        uint32_t header = pci_read_config(dev->bus, dev->dev, dev->fn, ptr);
+        if ((header & 0xFF) == cap_id) {
+            return ptr;
+        }
+        ptr = (uint8_t)((header >> 8) & 0xFC);
+    }
+    return 0;
+}
+
+/* Walk the PCIe extended capability list at 0x100; needs ECAM */
+uint16_t pci_find_ext_capability(pci_device_t *dev, uint16_t cap_id) {
+    if (!dev || !pci_ecam_available()) {
+        return 0;
+    }
+    uint16_t offset = PCI_EXT_CAP_START;
+    for (int guard = 0; offset >= PCI_EXT_CAP_START && guard < 480; guard++) {
+        uint32_t header = pci_read_config(dev->bus, dev->dev, dev->fn, offset);
+        if (header == 0 || header == 0xFFFFFFFF) {
+            return 0;
+        }
+        if ((header & 0xFFFF) == cap_id) {
+            return offset;
+        }
+        offset = (uint16_t)((header >> 20) & 0xFFC);
+    }
+    return 0;
+}
+
 int pci_enable_memory_space(pci_device_t *dev) {
     uint16_t cmd = pci_read_word(dev->bus, dev->dev, dev->fn, PCI_COMMAND);
     cmd |= PCI_CMD_MEMORY_SPACE | PCI_CMD_BUS_MASTER;
@@ -80,47 +281,121 @@ int pci_enable_memory_space(pci_device_t *dev) {
     return 0;
 }
 
-/* Enumerate PCI devices via configuration mechanism 1 */
+static void pci_scan_bus(uint8_t bus);
+
+/* Record one present function and descend into it if it is a PCI-to-PCI bridge */
+static void pci_scan_function(uint8_t bus, uint8_t dev, uint8_t fn, uint32_t id, uint8_t header_type) {
+    if (pci_device_count >= PCI_MAX_DEVICES) {
+        return;
+    }
+
+    /* Revision, prog IF, subclass and class share one dword */
+    uint32_t class_reg = pci_read_config(bus, dev, fn, PCI_REVISION_ID);
+
+    pci_device_t *dev_entry = &pci_devices[pci_device_count];
+    dev_entry->bus = bus;
+    dev_entry->dev = dev;
+    dev_entry->fn = fn;
+    dev_entry->vendor_id = (uint16_t)(id & 0xFFFF);
+    dev_entry->device_id = (uint16_t)(id >> 16);
+    dev_entry->prog_if = (uint8_t)(class_reg >> 8);
+    dev_entry->subclass_code = (uint8_t)(class_reg >> 16);
+    dev_entry->class_code = (uint8_t)(class_reg >> 24);
+    dev_entry->header_type = header_type & PCI_HEADER_TYPE_MASK;
+
+    for (int bar_idx = 0; bar_idx < 6; bar_idx++) {
+        dev_entry->bar[bar_idx] = 0;
+        dev_entry->bar_size[bar_idx] = 0;
+        dev_entry->bar_type[bar_idx] = PCI_BAR_TYPE_NONE;
+        dev_entry->bar_prefetchable[bar_idx] = 0;
+    }
+    /* Type 0 headers carry six BARs, bridges only two */
+    pci_decode_bars(dev_entry, (dev_entry->header_type == PCI_HEADER_TYPE_DEVICE) ? 6 : 2);
+
+    pci_device_count++;
+    pci_stats.functions_found++;
+
+    if (dev_entry->header_type == PCI_HEADER_TYPE_BRIDGE &&
+        dev_entry->class_code == PCI_CLASS_BRIDGE &&
+        dev_entry->subclass_code == PCI_SUBCLASS_PCI_BRIDGE) {
+        uint8_t secondary_bus = pci_read_byte(bus, dev, fn, PCI_SECONDARY_BUS);
+        if (secondary_bus != 0) {
+            pci_scan_bus(secondary_bus);
+        }
+    }
+}
+
+/* Probe function 0 and only look at functions 1-7 on multifunction devices */
+static void pci_scan_device(uint8_t bus, uint8_t dev) {
+    uint32_t id = pci_read_config(bus, dev, 0, PCI_VENDOR_ID);
+    if ((id & 0xFFFF) == 0xFFFF) {
+        return;
+    }
+
+    uint8_t header_type = pci_read_byte(bus, dev, 0, PCI_HEADER_TYPE);
+    pci_scan_function(bus, dev, 0, id, header_type);
+    if ((header_type & PCI_HEADER_TYPE_MULTIFUNC) == 0) {
+        return;
+    }
+
+    for (uint8_t fn = 1; fn < 8; fn++) {
+        id = pci_read_config(bus, dev, fn, PCI_VENDOR_ID);
+        if ((id & 0xFFFF) == 0xFFFF) {
+            continue;
+        }
+        pci_scan_function(bus, dev, fn, id, pci_read_byte(bus, dev, fn, PCI_HEADER_TYPE));
+    }
+}
+
+static void pci_scan_bus(uint8_t bus) {
+    /* Misconfigured bridges could point back at a bus we already walked */
+    uint32_t mask = 1u << (bus & 31);
+    if (pci_bus_visited[bus >> 5] & mask) {
+        return;
+    }
+    pci_bus_visited[bus >> 5] |= mask;
+    pci_stats.buses_scanned++;
+
+    for (uint8_t dev = 0; dev < 32; dev++) {
+        pci_scan_device(bus, dev);
+    }
+}
+
+/* Enumerate PCI devices by walking the bridge topology from the host bridge */
 int pci_enumerate(void) {
     pci_device_count = 0;
-    
-    for (int bus = 0; bus < 256 && pci_device_count < PCI_MAX_DEVICES; bus++) {
-        for (int dev = 0; dev < 32 && pci_device_count < PCI_MAX_DEVICES; dev++) {
-            for (int fn = 0; fn < 8 && pci_device_count < PCI_MAX_DEVICES; fn++) {
-                uint16_t vendor_id = pci_read_word(bus, dev, fn, PCI_VENDOR_ID);
-                
-                if (vendor_id == 0xFFFF) {
-                    continue;
-                }
-                
-                uint16_t device_id = pci_read_word(bus, dev, fn, PCI_DEVICE_ID);
-                uint8_t class_code = pci_read_byte(bus, dev, fn, PCI_CLASS_CODE);
-                uint8_t subclass_code = pci_read_byte(bus, dev, fn, PCI_SUBCLASS_CODE);
-                uint8_t prog_if = pci_read_byte(bus, dev, fn, PCI_PROG_IF);
-                
-                pci_device_t *dev_entry = &pci_devices[pci_device_count];
-                dev_entry->bus = bus;
-                dev_entry->dev = dev;
-                dev_entry->fn = fn;
-                dev_entry->vendor_id = vendor_id;
-                dev_entry->device_id = device_id;
-                dev_entry->class_code = class_code;
-                dev_entry->subclass_code = subclass_code;
-                dev_entry->prog_if = prog_if;
-                
-                for (int bar_idx = 0; bar_idx < 6; bar_idx++) {
-                    uint32_t bar_offset = PCI_BAR0 + (bar_idx * 4);
-                    dev_entry->bar[bar_idx] = pci_read_config(bus, dev, fn, bar_offset) & 0xFFFFFFF0;
-                }
-                
-                pci_device_count++;
+    pci_ecam_init();
+    pci_stats.config_reads = 0;
+    pci_stats.buses_scanned = 0;
+    pci_stats.functions_found = 0;
+    pci_stats.ecam_regions = (uint32_t)pci_ecam_count;
+    for (int i = 0; i < (int)(sizeof(pci_bus_visited) / sizeof(pci_bus_visited[0])); i++) {
+        pci_bus_visited[i] = 0;
+    }
+
+    uint8_t header_type = pci_read_byte(0, 0, 0, PCI_HEADER_TYPE);
+    if ((header_type & PCI_HEADER_TYPE_MULTIFUNC) == 0) {
+        /* Single host controller owns bus 0 */
+        pci_scan_bus(0);
+    } else {
+        /* Each host controller function owns the bus matching its number */
+        for (uint8_t fn = 0; fn < 8; fn++) {
+            if (pci_read_word(0, 0, fn, PCI_VENDOR_ID) == 0xFFFF) {
+                continue;
             }
+            pci_scan_bus(fn);
         }
     }
-    
+
     return pci_device_count;
 }
 
+void pci_get_scan_stats(pci_scan_stats_t *stats) {
+    if (stats) {
+        *stats = pci_stats;
+    }
+}
+
 int pci_get_device_count(void) {
     return pci_device_count;
 }
@@ -131,3 +406,8 @@ pci_device_t *pci_get_device(int index) {
     }
     return &pci_devices[index];
 }
+
+void pci_get_footprint(uint32_t *static_bytes, uint32_t *heap_bytes) {
+    *static_bytes = sizeof(pci_devices) + sizeof(pci_ecam_regions) + sizeof(pci_stats) + sizeof(pci_bus_visited);
+    *heap_bytes = 0;
+}
@@ -1,9 +1,22 @@
 #include "../../include/drivers/keyboard.h"
 #include "../../include/shell/prompt.h"
 #include "../../include/shell/nano.h"
+#include "../../include/kernel/interrupts.h"
+
+#define KEYBOARD_DATA_PORT   0x60
+#define KEYBOARD_STATUS_PORT 0x64
 
 static keyboard_state_t global_keyboard_state = {0, 0};
 
+/* Single producer (the IRQ handler) and single consumer (the shell loop):
+ * each index is written by one side only, so no lock is needed. The
+ * indices run freely and are masked on access. */
+static volatile uint8_t scancode_ring[KEYBOARD_BUFFER_SIZE];
+static volatile uint32_t ring_head = 0;
+static volatile uint32_t ring_tail = 0;
+static uint32_t ring_dropped = 0;
+static int irq_enabled = 0;
+
 void keyboard_init(keyboard_state_t *state) {
     if (state) {
         state->ctrl_pressed = 0;
@@ -15,14 +28,61 @@ keyboard_state_t *keyboard_get_state(void) {
     return &global_keyboard_state;
 }
 
+static void keyboard_irq_handler(interrupt_frame_t *frame) {
+    (void)frame;
+    uint8_t scancode = inb(KEYBOARD_DATA_PORT);
+    uint32_t head = ring_head;
+    if (head - ring_tail >= KEYBOARD_BUFFER_SIZE) {
+        ring_dropped++;
+        return;
+    }
+    scancode_ring[head & (KEYBOARD_BUFFER_SIZE - 1)] = scancode;
+    __asm__ volatile("" : : : "memory");
+    ring_head = head + 1;
+}
+
+void keyboard_enable_irq(void) {
+    if (!interrupts_are_ready() || irq_enabled) {
+        return;
+    }
+    /* A byte latched before the handler existed would hold the line */
+    while (inb(KEYBOARD_STATUS_PORT) & 1) {
+        inb(KEYBOARD_DATA_PORT);
+    }
+    irq_set_handler(IRQ_KEYBOARD, keyboard_irq_handler);
+    irq_unmask(IRQ_KEYBOARD);
+    irq_enabled = 1;
+}
+
 int keyboard_ready(void) {
-    return (inb(0x64) & 1) != 0;
+    if (irq_enabled) {
+        return ring_head != ring_tail;
+    }
+    return (inb(KEYBOARD_STATUS_PORT) & 1) != 0;
 }
 
 uint8_t read_keyboard(void) {
     while (!keyboard_ready()) {
+        if (irq_enabled) {
+            interrupts_disable();
+            if (!keyboard_ready()) {
+                cpu_idle();
+            }
+            interrupts_enable();
+        }
     }
-    return inb(0x60);
+    if (!irq_enabled) {
+        return inb(KEYBOARD_DATA_PORT);
+    }
+    uint32_t tail = ring_tail;
+    uint8_t scancode = scancode_ring[tail & (KEYBOARD_BUFFER_SIZE - 1)];
+    __asm__ volatile("" : : : "memory");
+    ring_tail = tail + 1;
+    return scancode;
+}
+
+uint32_t keyboard_dropped_scancodes(void) {
+    return ring_dropped;
 }
 
 char scancode_to_ascii(uint16_t scancode) {
@@ -5,7 +5,7 @@
 typedef unsigned char uint8_t;
 typedef unsigned short uint16_t;
 typedef unsigned int uint32_t;
-typedef unsigned long uint64_t;
+typedef unsigned long long uint64_t;
 
 #define AHCI_CAP            0x00
 #define AHCI_GHC            0x04
@@ -46,7 +46,7 @@ typedef unsigned long uint64_t;
 /* AHCI device private data */
 typedef struct {
     pci_device_t *pci_dev;
-    uint32_t *hba_mem;
+    volatile uint32_t *hba_mem;
     uint32_t sector_size;
     uint32_t capacity_sectors;
     int port_index;
@@ -66,18 +66,7 @@ static int ahci_write(block_device_t *dev, uint32_t lba, const uint8_t *buffer,
     return -1;
 }
 
-int ahci_init(block_device_t *dev) {
-    pci_device_t *pci_dev = 0;
-    
-    /* Find first AHCI controller */
-    for (int i = 0; i < pci_get_device_count(); i++) {
-        pci_device_t *d = pci_get_device(i);
-        if (d && d->class_code == PCI_CLASS_STORAGE && d->subclass_code == PCI_SUBCLASS_SATA) {
-            pci_dev = d;
-            break;
-        }
-    }
-    
+int ahci_init(block_device_t *dev, pci_device_t *pci_dev) {
     if (!pci_dev) {
         return -1;
     }
@@ -85,25 +74,22 @@ int ahci_init(block_device_t *dev) {
     /* Enable memory space and bus master */
     pci_enable_memory_space(pci_dev);
     
-    /* Get ABAR (BAR5 for AHCI) */
-    uint32_t abar = pci_dev->bar[5];
-    if (abar == 0) {
-        abar = pci_dev->bar[0];
+    /* Map ABAR (BAR5 for AHCI) */
+    volatile uint32_t *hba_mem = (volatile uint32_t *)pci_map_bar(pci_dev, 5);
+    if (!hba_mem) {
+        hba_mem = (volatile uint32_t *)pci_map_bar(pci_dev, 0);
     }
     
-    if (abar == 0 || abar == 0xFFFFFFFF) {
+    if (!hba_mem) {
         return -2;
     }
     
-    /* Map ABAR to memory */
-    uint32_t *hba_mem = (uint32_t *)abar;
-    
     /* Initialize AHCI host controller */
-    uint32_t ghc = *(volatile uint32_t *)(hba_mem + (AHCI_GHC / 4));
+    uint32_t ghc = hba_mem[AHCI_GHC / 4];
     
     if ((ghc & AHCI_GHC_AE) == 0) {
         /* Enable AHCI */
-        *(volatile uint32_t *)(hba_mem + (AHCI_GHC / 4)) = ghc | AHCI_GHC_AE;
+        hba_mem[AHCI_GHC / 4] = ghc | AHCI_GHC_AE;
     }
     
     /* Allocate and set up device private data */
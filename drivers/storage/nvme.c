@@ -5,7 +5,7 @@
 typedef unsigned char uint8_t;
 typedef unsigned short uint16_t;
 typedef unsigned int uint32_t;
-typedef unsigned long uint64_t;
+typedef unsigned long long uint64_t;
 
 /* NVMe registers */
 #define NVME_CAP            0x00
@@ -26,7 +26,7 @@ typedef unsigned long uint64_t;
 /* NVMe device private data */
 typedef struct {
     pci_device_t *pci_dev;
-    uint32_t *bar0;
+    volatile uint32_t *bar0;
     uint32_t sector_size;
     uint32_t capacity_sectors;
 } nvme_private_t;
@@ -42,18 +42,7 @@ static int nvme_write(block_device_t *dev, uint32_t lba, const uint8_t *buffer,
     return -1;
 }
 
-int nvme_init(block_device_t *dev) {
-    pci_device_t *pci_dev = 0;
-    
-    /* Find first NVMe controller */
-    for (int i = 0; i < pci_get_device_count(); i++) {
-        pci_device_t *d = pci_get_device(i);
-        if (d && d->class_code == PCI_CLASS_STORAGE && d->subclass_code == PCI_SUBCLASS_NVME) {
-            pci_dev = d;
-            break;
-        }
-    }
-    
+int nvme_init(block_device_t *dev, pci_device_t *pci_dev) {
     if (!pci_dev) {
         return -1;
     }
@@ -61,21 +50,18 @@ int nvme_init(block_device_t *dev) {
     /* Enable memory space and bus master */
     pci_enable_memory_space(pci_dev);
     
-    /* Get BAR0 */
-    uint32_t bar0_addr = pci_dev->bar[0];
+    /* Map BAR0 (usually a 64-bit BAR spanning BAR0/BAR1) */
+    volatile uint32_t *bar0_mem = (volatile uint32_t *)pci_map_bar(pci_dev, 0);
     
-    if (bar0_addr == 0 || bar0_addr == 0xFFFFFFFF) {
+    if (!bar0_mem) {
         return -2;
     }
     
-    /* Map BAR0 to memory */
-    uint32_t *bar0_mem = (uint32_t *)bar0_addr;
-    
     /* Read device capabilities */
-    uint64_t *cap_reg = (uint64_t *)(bar0_mem + (NVME_CAP / 4));
+    volatile uint32_t *cap_reg = bar0_mem + (NVME_CAP / 4);
     
     /* Initialize NVMe controller (minimal setup) */
-    uint32_t *cc_reg = (uint32_t *)(bar0_mem + (NVME_CC / 4));
+    volatile uint32_t *cc_reg = bar0_mem + (NVME_CC / 4);
     
     /* Allocate and set up device private data */
     nvme_private_t *priv = (nvme_private_t *)0;
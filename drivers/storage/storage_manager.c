@@ -14,8 +14,24 @@ static block_device_t *primary_device = 0;
 
 /* Forward declarations for device drivers */
 extern int ata_pio_init(block_device_t *dev);
-extern int ahci_init(block_device_t *dev);
-extern int nvme_init(block_device_t *dev);
+extern int ahci_init(block_device_t *dev, pci_device_t *pci_dev);
+extern int nvme_init(block_device_t *dev, pci_device_t *pci_dev);
+
+/* PCI storage drivers, matched by class/subclass; lower priority wins primary */
+typedef struct {
+    uint8_t class_code;
+    uint8_t subclass_code;
+    int priority;
+    int (*init)(block_device_t *dev, pci_device_t *pci_dev);
+} storage_pci_match_t;
+
+static const storage_pci_match_t storage_pci_matches[] = {
+    { PCI_CLASS_STORAGE, PCI_SUBCLASS_NVME, 0, nvme_init },
+    { PCI_CLASS_STORAGE, PCI_SUBCLASS_SATA, 1, ahci_init },
+};
+
+#define STORAGE_PCI_MATCH_COUNT ((int)(sizeof(storage_pci_matches) / sizeof(storage_pci_matches[0])))
+#define STORAGE_PRIORITY_ATA    2
 
 int storage_register_device(block_device_t *dev) {
     if (storage_device_count >= STORAGE_MAX_DEVICES) {
@@ -35,33 +51,29 @@ int storage_manager_init(void) {
     /* Initialize PCI enumeration */
     pci_enumerate();
     
-    /* First, try to initialize NVMe devices (highest priority) */
+    /* Single pass over the PCI table: NVMe > AHCI > legacy ATA for primary */
+    int primary_priority = STORAGE_PRIORITY_ATA + 1;
     for (int i = 0; i < pci_get_device_count(); i++) {
         pci_device_t *dev = pci_get_device(i);
-        if (dev && dev->class_code == PCI_CLASS_STORAGE && dev->subclass_code == PCI_SUBCLASS_NVME) {
-            block_device_t bd;
-            if (nvme_init(&bd) == 0) {
-                if (storage_register_device(&bd) == 0 && primary_device == 0) {
-                    primary_device = &storage_devices[storage_device_count - 1];
-                }
-            }
+        if (!dev) {
+            continue;
         }
-    }
-    
-    /* Then, try to initialize AHCI devices (middle priority) */
-    for (int i = 0; i < pci_get_device_count(); i++) {
-        pci_device_t *dev = pci_get_device(i);
-        if (dev && dev->class_code == PCI_CLASS_STORAGE && dev->subclass_code == PCI_SUBCLASS_SATA) {
+        for (int m = 0; m < STORAGE_PCI_MATCH_COUNT; m++) {
+            const storage_pci_match_t *match = &storage_pci_matches[m];
+            if (dev->class_code != match->class_code || dev->subclass_code != match->subclass_code) {
+                continue;
+            }
             block_device_t bd;
-            if (ahci_init(&bd) == 0) {
-                if (storage_register_device(&bd) == 0 && primary_device == 0) {
-                    primary_device = &storage_devices[storage_device_count - 1];
-                }
+            if (match->init(&bd, dev) == 0 && storage_register_device(&bd) == 0 &&
+                match->priority < primary_priority) {
+                primary_device = &storage_devices[storage_device_count - 1];
+                primary_priority = match->priority;
             }
+            break;
         }
     }
     
-    /* Finally, try to initialize legacy ATA (lowest priority) */
+    /* Legacy ATA is not PCI-discovered and only becomes primary as a fallback */
     block_device_t ata_bd;
     if (ata_pio_init(&ata_bd) == 0) {
         if (storage_register_device(&ata_bd) == 0 && primary_device == 0) {
@@ -86,3 +98,8 @@ int storage_get_device_count(void) {
 block_device_t *storage_get_primary_device(void) {
     return primary_device;
 }
+
+void storage_get_footprint(uint32_t *static_bytes, uint32_t *heap_bytes) {
+    *static_bytes = sizeof(storage_devices);
+    *heap_bytes = 0;
+}
@@ -0,0 +1,101 @@
+#include "../../include/drivers/hpet.h"
+#include "../../include/drivers/acpi.h"
+#include "../../include/kernel/paging.h"
+#include "../../include/kernel/interrupts.h"
+
+static volatile uint32_t *hpet_regs = 0;
+static uint32_t period_fs = 0;
+static uint32_t timer_count = 0;
+static int counter_64bit = 0;
+static uint32_t last_low = 0;
+static uint32_t high_word = 0;
+
+static uint32_t hpet_read32(uint32_t offset) {
+    return hpet_regs[offset / 4];
+}
+
+static void hpet_write32(uint32_t offset, uint32_t value) {
+    hpet_regs[offset / 4] = value;
+}
+
+int hpet_init(void) {
+    if (hpet_regs) {
+        return 0;
+    }
+    const acpi_hpet_t *table = (const acpi_hpet_t *)acpi_find_table("HPET");
+    if (!table || table->header.length < sizeof(acpi_hpet_t)) {
+        return -1;
+    }
+    if (table->address_space_id != 0 || table->base_address == 0 ||
+        table->base_address > 0xFFFFFFFFull) {
+        return -1;
+    }
+    volatile void *base = paging_map_mmio((uint32_t)table->base_address, HPET_MMIO_SIZE);
+    if (!base) {
+        return -1;
+    }
+    volatile uint32_t *regs = (volatile uint32_t *)base;
+    uint32_t caps = regs[HPET_REG_CAPABILITIES / 4];
+    uint32_t period = regs[(HPET_REG_CAPABILITIES + 4) / 4];
+    if (period == 0 || period > HPET_MAX_PERIOD_FS) {
+        return -1;
+    }
+    hpet_regs = regs;
+    period_fs = period;
+    timer_count = ((caps >> 8) & 0x1F) + 1;
+    counter_64bit = (caps & HPET_CAP_COUNTER_64) != 0;
+
+    /* The counter may only be written while halted; start it from zero */
+    uint32_t config = hpet_read32(HPET_REG_CONFIG);
+    hpet_write32(HPET_REG_CONFIG, config & ~HPET_CONFIG_ENABLE);
+    hpet_write32(HPET_REG_COUNTER, 0);
+    hpet_write32(HPET_REG_COUNTER + 4, 0);
+    hpet_write32(HPET_REG_CONFIG, config | HPET_CONFIG_ENABLE);
+    last_low = 0;
+    high_word = 0;
+    return 0;
+}
+
+int hpet_is_available(void) {
+    return hpet_regs != 0;
+}
+
+uint64_t hpet_read_counter(void) {
+    if (!hpet_regs) {
+        return 0;
+    }
+    if (counter_64bit) {
+        /* Two 32-bit reads can straddle a carry into the high half */
+        uint32_t high = hpet_read32(HPET_REG_COUNTER + 4);
+        uint32_t low;
+        uint32_t check;
+        do {
+            check = high;
+            low = hpet_read32(HPET_REG_COUNTER);
+            high = hpet_read32(HPET_REG_COUNTER + 4);
+        } while (high != check);
+        return ((uint64_t)high << 32) | low;
+    }
+    /* Read and extension must not be split by an interrupt that reads too */
+    uint32_t flags = interrupts_save();
+    uint32_t low = hpet_read32(HPET_REG_COUNTER);
+    if (low < last_low) {
+        high_word++;
+    }
+    last_low = low;
+    uint64_t value = ((uint64_t)high_word << 32) | low;
+    interrupts_restore(flags);
+    return value;
+}
+
+int hpet_counter_is_64bit(void) {
+    return counter_64bit;
+}
+
+uint32_t hpet_period_fs(void) {
+    return period_fs;
+}
+
+uint32_t hpet_timer_count(void) {
+    return timer_count;
+}
@@ -0,0 +1,135 @@
+#include "../../include/drivers/lapic.h"
+#include "../../include/kernel/interrupts.h"
+#include "../../include/kernel/clock.h"
+#include "../../include/kernel/paging.h"
+
+#define MSR_IA32_APIC_BASE    0x1B
+#define MSR_IA32_TSC_DEADLINE 0x6E0
+#define APIC_BASE_ENABLE      (1u << 11)
+#define APIC_BASE_ADDRESS     0xFFFFF000u
+
+#define LAPIC_CALIBRATION_NS  (CLOCK_CALIBRATION_MS * NSEC_PER_MSEC)
+
+static volatile uint32_t *lapic_regs = 0;
+static int timer_mode = LAPIC_TIMER_NONE;
+static uint32_t timer_khz = 0;
+static uint32_t tsc_khz = 0;
+
+static uint32_t lapic_read(uint32_t offset) {
+    return lapic_regs[offset / 4];
+}
+
+static void lapic_write(uint32_t offset, uint32_t value) {
+    lapic_regs[offset / 4] = value;
+}
+
+static uint64_t rdmsr(uint32_t msr) {
+    uint32_t lo;
+    uint32_t hi;
+    __asm__ volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ volatile("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)) : "memory");
+}
+
+/* Runs the count-down timer masked for one calibration window of ktime */
+static uint32_t lapic_calibrate_khz(void) {
+    lapic_write(LAPIC_REG_TIMER_DIVIDE, LAPIC_DIVIDE_BY_16);
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED | LAPIC_LVT_ONESHOT | LAPIC_TIMER_VECTOR);
+    uint64_t start = ktime_ns();
+    lapic_write(LAPIC_REG_TIMER_INITIAL, 0xFFFFFFFFu);
+    uint64_t elapsed;
+    do {
+        elapsed = ktime_ns() - start;
+    } while (elapsed < LAPIC_CALIBRATION_NS);
+    uint32_t ticks = 0xFFFFFFFFu - lapic_read(LAPIC_REG_TIMER_CURRENT);
+    lapic_write(LAPIC_REG_TIMER_INITIAL, 0);
+    return (uint32_t)div_u64_rem((uint64_t)ticks * NSEC_PER_MSEC, (uint32_t)elapsed, 0);
+}
+
+int lapic_init(void) {
+    if (lapic_regs) {
+        return 0;
+    }
+    uint32_t eax = 1, ebx, ecx, edx;
+    __asm__ volatile("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    if ((edx & (1u << 9)) == 0) {
+        return -1;
+    }
+    clock_info_t clock;
+    clock_get_info(&clock);
+    if (!clock.source) {
+        return -1;
+    }
+    uint64_t base = rdmsr(MSR_IA32_APIC_BASE);
+    if ((base >> 32) != 0) {
+        return -1;
+    }
+    wrmsr(MSR_IA32_APIC_BASE, base | APIC_BASE_ENABLE);
+    volatile void *regs = paging_map_mmio((uint32_t)base & APIC_BASE_ADDRESS, LAPIC_MMIO_SIZE);
+    if (!regs) {
+        return -1;
+    }
+    lapic_regs = (volatile uint32_t *)regs;
+    lapic_write(LAPIC_REG_SPURIOUS, LAPIC_SPURIOUS_ENABLE | LAPIC_SPURIOUS_VECTOR);
+
+    tsc_khz = clock.tsc_khz;
+    if ((ecx & (1u << 24)) && tsc_khz != 0) {
+        /* The deadline MSR only works once the LVT is in deadline mode */
+        lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_TSC_DEADLINE | LAPIC_TIMER_VECTOR);
+        wrmsr(MSR_IA32_TSC_DEADLINE, 0);
+        timer_mode = LAPIC_TIMER_TSC_DEADLINE;
+        return 0;
+    }
+    timer_khz = lapic_calibrate_khz();
+    if (timer_khz == 0) {
+        lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED | LAPIC_TIMER_VECTOR);
+        return -1;
+    }
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_ONESHOT | LAPIC_TIMER_VECTOR);
+    timer_mode = LAPIC_TIMER_ONESHOT;
+    return 0;
+}
+
+int lapic_timer_mode(void) {
+    return timer_mode;
+}
+
+uint32_t lapic_timer_khz(void) {
+    return timer_khz;
+}
+
+void lapic_timer_arm(uint64_t delta_ns) {
+    if (delta_ns > LAPIC_MAX_ARM_NS) {
+        delta_ns = LAPIC_MAX_ARM_NS;
+    }
+    if (timer_mode == LAPIC_TIMER_TSC_DEADLINE) {
+        uint64_t cycles = div_u64_rem(delta_ns * tsc_khz, NSEC_PER_MSEC, 0);
+        wrmsr(MSR_IA32_TSC_DEADLINE, read_tsc() + cycles + 1);
+    } else if (timer_mode == LAPIC_TIMER_ONESHOT) {
+        uint64_t count = div_u64_rem(delta_ns * timer_khz, NSEC_PER_MSEC, 0);
+        if (count == 0) {
+            count = 1;
+        }
+        if (count > 0xFFFFFFFFull) {
+            count = 0xFFFFFFFFull;
+        }
+        lapic_write(LAPIC_REG_TIMER_INITIAL, (uint32_t)count);
+    }
+}
+
+void lapic_timer_cancel(void) {
+    if (timer_mode == LAPIC_TIMER_TSC_DEADLINE) {
+        wrmsr(MSR_IA32_TSC_DEADLINE, 0);
+    } else if (timer_mode == LAPIC_TIMER_ONESHOT) {
+        lapic_write(LAPIC_REG_TIMER_INITIAL, 0);
+    }
+}
+
+void lapic_eoi(void) {
+    if (lapic_regs) {
+        lapic_write(LAPIC_REG_EOI, 0);
+    }
+}
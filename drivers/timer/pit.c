@@ -0,0 +1,29 @@
+#include "../../include/drivers/pit.h"
+
+#define PIT_GATE_CHANNEL2   0x01
+#define PIT_GATE_SPEAKER    0x02
+#define PIT_GATE_OUT2       0x20
+
+/* Channel 2, lobyte/hibyte access, mode 0 (interrupt on terminal count) */
+#define PIT_CMD_CH2_ONESHOT 0xB0
+
+static uint8_t saved_gate = 0;
+
+void pit_oneshot_start(uint16_t count) {
+    saved_gate = inb(PIT_GATE_PORT);
+    uint8_t gate = (uint8_t)((saved_gate & ~PIT_GATE_SPEAKER) & ~PIT_GATE_CHANNEL2);
+    outb(PIT_GATE_PORT, gate);
+    outb(PIT_COMMAND_PORT, PIT_CMD_CH2_ONESHOT);
+    outb(PIT_CHANNEL2_PORT, (uint8_t)(count & 0xFF));
+    outb(PIT_CHANNEL2_PORT, (uint8_t)(count >> 8));
+    /* Counting starts on the rising edge of the gate */
+    outb(PIT_GATE_PORT, (uint8_t)(gate | PIT_GATE_CHANNEL2));
+}
+
+int pit_oneshot_expired(void) {
+    return (inb(PIT_GATE_PORT) & PIT_GATE_OUT2) != 0;
+}
+
+void pit_oneshot_stop(void) {
+    outb(PIT_GATE_PORT, saved_gate);
+}
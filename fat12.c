@@ -1,13 +1,40 @@
 #include "fat12.h"
+#include "include/kernel/heap.h"
 
 #define FAT12_CLUSTER_FREE 0x000
-#define FAT12_CLUSTER_EOC  0x0FF8
+/* Written as the end-of-chain marker; set_fat_entry masks it to the entry
+ * width. Chains end at any value outside the volume's cluster range. */
+#define FAT12_CLUSTER_EOC  0x0FFFFFFF
 #define FAT12_DIR_ENTRY_SIZE 32
 
-#define FAT12_MAX_FAT_SECTORS          64
+/* Cluster-count limits that decide the FAT type (Microsoft FAT spec) */
+#define FAT12_FAT12_MAX_CLUSTERS       4084
+#define FAT12_FAT16_MAX_CLUSTERS       65524
+
+#define FAT12_FSINFO_LEAD_SIG          0x41615252
+#define FAT12_FSINFO_STRUCT_SIG        0x61417272
+#define FAT12_FSINFO_UNKNOWN           0xFFFFFFFF
+
+#define FAT12_FAT_CACHE_SLOTS          4
+/* Clusters the free bitmap can track; larger volumes stay readable but only
+ * the first FAT12_MAX_CLUSTERS clusters are used for new allocations */
+#define FAT12_MAX_CLUSTERS             (1u << 21)
 #define FAT12_MAX_ROOT_DIR_SECTORS     64
-#define FAT12_MAX_SECTORS_PER_CLUSTER  32
+#define FAT12_ROOT_DIRTY_WORDS         ((FAT12_MAX_ROOT_DIR_SECTORS + 31) / 32)
+#define FAT12_MAX_SECTORS_PER_CLUSTER  64
 #define FAT12_MAX_PATH_DEPTH           16
+#define FAT12_MAX_TRANSFER_SECTORS     256
+#define FAT12_MAX_FILE_EXTENTS         32
+#define FAT12_DENTRY_CACHE_SETS        32
+#define FAT12_DENTRY_CACHE_WAYS        4
+#define FAT12_DIR_INDEX_SLOTS          2
+/* Largest directory that gets an index; bigger ones are scanned */
+#define FAT12_DIR_INDEX_MAX_ENTRIES    2048
+#define FAT12_DIR_INDEX_MAX_CLUSTERS   (FAT12_DIR_INDEX_MAX_ENTRIES / (SECTOR_SIZE / FAT12_DIR_ENTRY_SIZE))
+#define FAT12_DIR_INDEX_BUCKETS        4096
+#define FAT12_DIR_INDEX_EMPTY          0x0000
+#define FAT12_DIR_INDEX_TOMBSTONE      0xFFFF
+#define FAT12_DEFRAG_BATCH             32
 
 typedef struct __attribute__((packed)) {
     uint8_t name[11];
@@ -41,6 +68,16 @@ typedef struct __attribute__((packed)) {
     uint32_t total_sectors_32;
 } fat12_bpb_t;
 
+/* FAT32 extension that follows the common BPB */
+typedef struct __attribute__((packed)) {
+    uint32_t sectors_per_fat_32;
+    uint16_t ext_flags;
+    uint16_t fs_version;
+    uint32_t root_cluster;
+    uint16_t fs_info_sector;
+    uint16_t backup_boot_sector;
+} fat12_bpb32_t;
+
 typedef struct {
     uint16_t bytes_per_sector;
     uint8_t sectors_per_cluster;
@@ -49,7 +86,12 @@ typedef struct {
     uint16_t root_entry_count;
     uint16_t root_dir_sectors;
     uint32_t total_sectors;
-    uint16_t sectors_per_fat;
+    uint32_t sectors_per_fat;
+    uint8_t fat_type;
+    uint8_t active_fat;
+    uint8_t mirror_fats;
+    uint32_t root_cluster;
+    uint16_t fs_info_sector;
     uint32_t fat_start_lba;
     uint32_t root_dir_start_lba;
     uint32_t data_start_lba;
@@ -58,20 +100,121 @@ typedef struct {
     uint32_t cluster_size_bytes;
     uint32_t base_lba;
     uint32_t fat_size_bytes;
+    uint32_t bitmap_end;
 } fat12_fs_t;
 
+/* One cached FAT sector; `sector` is relative to the start of the FAT */
+typedef struct {
+    uint32_t sector;
+    uint8_t valid;
+    uint8_t dirty;
+    uint32_t last_used;
+    uint8_t data[SECTOR_SIZE];
+} fat12_fat_cache_slot_t;
+
+/* Run of physically contiguous clusters starting `file_cluster` clusters
+ * into a file */
+typedef struct {
+    uint32_t file_cluster;
+    uint32_t disk_cluster;
+    uint32_t length;
+} fat12_extent_t;
+
+/* Streaming handle. The extent map covers the first `mapped_clusters`
+ * clusters of the chain; past that (a file with more runs than the map
+ * holds), `cluster` caches where the chain walk last stopped
+ * (`cluster_index` clusters into the file). */
+typedef struct {
+    uint8_t in_use;
+    uint8_t flags;
+    uint8_t entry_dirty;
+    uint8_t map_valid;
+    uint8_t short_name[11];
+    uint32_t dir_cluster;
+    uint32_t first_cluster;
+    uint32_t cluster_count;
+    uint32_t size;
+    uint32_t position;
+    uint32_t cluster;
+    uint32_t cluster_index;
+    uint32_t extent_count;
+    uint32_t mapped_clusters;
+    fat12_extent_t extents[FAT12_MAX_FILE_EXTENTS];
+} fat12_open_file_t;
+
+/* Cached result of looking `short_name` up in the directory starting at
+ * `dir_cluster`; negative entries remember names that are not there */
+typedef struct {
+    uint8_t valid;
+    uint8_t negative;
+    uint32_t dir_cluster;
+    uint8_t short_name[11];
+    uint32_t owner_cluster;
+    uint32_t entry_index;
+    uint32_t last_used;
+    fat12_raw_dir_entry_t entry;
+} fat12_dentry_t;
+
+/* In-memory index of one directory. Slots number the 32-byte entries in
+ * directory order; `buckets` is an open-addressed hash from short name to
+ * slot + 1. `free_slots` is a stack: a fresh index has the lowest free slot
+ * on top and slots freed later are reused first. Every free slot sits
+ * before the directory's end marker or is the marker itself, so new
+ * entries never leave a hole past it. */
+typedef struct {
+    uint8_t valid;
+    uint8_t overflow;
+    uint32_t dir_cluster;
+    uint32_t last_used;
+    uint32_t slot_count;
+    uint32_t cluster_count;
+    uint32_t free_count;
+    uint32_t tombstones;
+    uint32_t clusters[FAT12_DIR_INDEX_MAX_CLUSTERS];
+    uint32_t used[FAT12_DIR_INDEX_MAX_ENTRIES / 32];
+    uint32_t hashes[FAT12_DIR_INDEX_MAX_ENTRIES];
+    uint16_t free_slots[FAT12_DIR_INDEX_MAX_ENTRIES];
+    uint16_t buckets[FAT12_DIR_INDEX_BUCKETS];
+} fat12_dir_index_t;
+
 static fat12_fs_t g_fs;
-static uint8_t g_fat_primary[FAT12_MAX_FAT_SECTORS * SECTOR_SIZE];
-static uint8_t g_fat_secondary[FAT12_MAX_FAT_SECTORS * SECTOR_SIZE];
-static uint8_t g_root_dir[FAT12_MAX_ROOT_DIR_SECTORS * SECTOR_SIZE];
-static uint8_t g_cluster_buffer[FAT12_MAX_SECTORS_PER_CLUSTER * SECTOR_SIZE];
+static fat12_fat_cache_slot_t g_fat_cache[FAT12_FAT_CACHE_SLOTS];
+static uint32_t g_fat_cache_tick = 0;
+static uint8_t g_fat_flush_buffer[FAT12_FAT_CACHE_SLOTS * SECTOR_SIZE];
+/* Sized for the mounted volume and taken from the kernel heap; g_root_dir
+ * stays 0 on FAT32, whose root is an ordinary cluster chain */
+static uint8_t *g_root_dir = 0;
+static uint8_t *g_cluster_buffer = 0;
+static fat12_stats_t g_stats;
+
+/* FAT32 FSInfo sector, kept so the free-count hint can be rewritten */
+static uint8_t g_fsinfo[SECTOR_SIZE];
+static int g_fsinfo_valid = 0;
+static uint32_t g_fsinfo_free = FAT12_FSINFO_UNKNOWN;
+static uint32_t g_fsinfo_next = FAT12_FSINFO_UNKNOWN;
+
+/* One bit per cluster, set when the cluster is in use (clusters 0 and 1
+ * and the padding past the last cluster are permanently set) */
+static uint32_t *g_cluster_bitmap = 0;
+static uint32_t g_free_clusters = 0;
+static uint32_t g_alloc_cursor = 2;
+static int g_bitmap_ready = 0;
+static int g_root_loaded = 0;
+
+static fat12_open_file_t g_open_files[FAT12_MAX_OPEN_FILES];
+static fat12_dentry_t g_dentry_cache[FAT12_DENTRY_CACHE_SETS][FAT12_DENTRY_CACHE_WAYS];
+static uint32_t g_dentry_tick = 0;
+/* Taken from the heap the first time a directory is indexed; 0 while the
+ * slot has never been used */
+static fat12_dir_index_t *g_dir_index[FAT12_DIR_INDEX_SLOTS];
+static uint32_t g_dir_index_tick = 0;
 
 static int g_fs_ready = 0;
-static int g_fat_dirty = 0;
-static int g_root_dirty = 0;
+/* One bit per root directory sector modified since the last flush */
+static uint32_t g_root_dirty_sectors[FAT12_ROOT_DIRTY_WORDS];
 
-static uint16_t g_current_dir_cluster = 0;
-static uint16_t g_path_stack[FAT12_MAX_PATH_DEPTH];
+static uint32_t g_current_dir_cluster = 0;
+static uint32_t g_path_stack[FAT12_MAX_PATH_DEPTH];
 static char g_path_names[FAT12_MAX_PATH_DEPTH][FAT12_MAX_DISPLAY_NAME];
 static int g_path_depth = 0;
 static char g_cwd[FAT12_PATH_MAX] = "/";
@@ -242,7 +385,7 @@ static int fat12_make_short_name(const char *input, uint8_t out[11]) {
 }
 
 
-static uint32_t fat12_cluster_to_lba(uint16_t cluster) {
+static uint32_t fat12_cluster_to_lba(uint32_t cluster) {
     if (cluster < 2) {
         return g_fs.data_start_lba;
     }
@@ -250,98 +393,607 @@ static uint32_t fat12_cluster_to_lba(uint16_t cluster) {
     return g_fs.data_start_lba + (rel_cluster * g_fs.sectors_per_cluster);
 }
 
-static int fat12_read_cluster(uint16_t cluster, uint8_t *buffer) {
+static int fat12_read_cluster(uint32_t cluster, uint8_t *buffer) {
     uint32_t lba = fat12_cluster_to_lba(cluster);
     return disk_read_sectors(g_fs.base_lba + lba, buffer, g_fs.sectors_per_cluster);
 }
 
-static int fat12_write_cluster(uint16_t cluster, const uint8_t *buffer) {
+/* Read `count` physically contiguous clusters straight into `buffer`,
+ * splitting the transfer only where the device request limit forces it. */
+static int fat12_read_cluster_run(uint32_t first_cluster, uint32_t count, uint8_t *buffer) {
+    uint32_t lba = g_fs.base_lba + fat12_cluster_to_lba(first_cluster);
+    uint32_t sectors_left = count * g_fs.sectors_per_cluster;
+    while (sectors_left > 0) {
+        uint16_t chunk = (sectors_left > FAT12_MAX_TRANSFER_SECTORS) ? FAT12_MAX_TRANSFER_SECTORS : (uint16_t)sectors_left;
+        if (disk_read_sectors(lba, buffer, chunk) != 0) {
+            return FAT12_ERR_IO;
+        }
+        lba += chunk;
+        buffer += (uint32_t)chunk * SECTOR_SIZE;
+        sectors_left -= chunk;
+    }
+    return FAT12_OK;
+}
+
+static int fat12_write_cluster(uint32_t cluster, const uint8_t *buffer) {
     uint32_t lba = fat12_cluster_to_lba(cluster);
     return disk_write_sectors(g_fs.base_lba + lba, buffer, g_fs.sectors_per_cluster);
 }
 
-static uint16_t fat12_get_fat_entry(uint16_t cluster) {
-    uint32_t index = (uint32_t)cluster + (cluster / 2);
+/* Write `count` physically contiguous clusters from `buffer` */
+static int fat12_write_cluster_run(uint32_t first_cluster, uint32_t count, const uint8_t *buffer) {
+    uint32_t lba = g_fs.base_lba + fat12_cluster_to_lba(first_cluster);
+    uint32_t sectors_left = count * g_fs.sectors_per_cluster;
+    while (sectors_left > 0) {
+        uint16_t chunk = (sectors_left > FAT12_MAX_TRANSFER_SECTORS) ? FAT12_MAX_TRANSFER_SECTORS : (uint16_t)sectors_left;
+        if (disk_write_sectors(lba, buffer, chunk) != 0) {
+            return FAT12_ERR_IO;
+        }
+        lba += chunk;
+        buffer += (uint32_t)chunk * SECTOR_SIZE;
+        sectors_left -= chunk;
+    }
+    return FAT12_OK;
+}
+
+/* Write one cached FAT sector back to every FAT copy */
+static int fat12_fat_cache_writeback(fat12_fat_cache_slot_t *slot) {
+    for (uint8_t fat_index = 0; fat_index < g_fs.num_fats; fat_index++) {
+        if (!g_fs.mirror_fats && fat_index != g_fs.active_fat) {
+            continue;
+        }
+        uint32_t lba = g_fs.base_lba + g_fs.fat_start_lba + (fat_index * g_fs.sectors_per_fat) + slot->sector;
+        if (disk_write_sector(lba, slot->data) != 0) {
+            return FAT12_ERR_IO;
+        }
+        g_stats.fat_sector_writes++;
+    }
+    slot->dirty = 0;
+    return FAT12_OK;
+}
+
+static void fat12_fat_cache_invalidate(void) {
+    for (int i = 0; i < FAT12_FAT_CACHE_SLOTS; i++) {
+        g_fat_cache[i].valid = 0;
+        g_fat_cache[i].dirty = 0;
+    }
+    g_fat_cache_tick = 0;
+}
+
+/* Return the cache slot holding FAT sector `sector`, loading it from the
+ * active FAT on a miss and evicting the least recently used slot. */
+static fat12_fat_cache_slot_t *fat12_fat_cache_get(uint32_t sector) {
+    fat12_fat_cache_slot_t *victim = &g_fat_cache[0];
+    for (int i = 0; i < FAT12_FAT_CACHE_SLOTS; i++) {
+        fat12_fat_cache_slot_t *slot = &g_fat_cache[i];
+        if (slot->valid && slot->sector == sector) {
+            slot->last_used = ++g_fat_cache_tick;
+            g_stats.fat_cache_hits++;
+            return slot;
+        }
+        if (!slot->valid) {
+            if (victim->valid) {
+                victim = slot;
+            }
+        } else if (victim->valid && slot->last_used < victim->last_used) {
+            victim = slot;
+        }
+    }
+
+    g_stats.fat_cache_misses++;
+    if (victim->valid && victim->dirty) {
+        if (fat12_fat_cache_writeback(victim) != FAT12_OK) {
+            return 0;
+        }
+    }
+    victim->valid = 0;
+    uint32_t lba = g_fs.base_lba + g_fs.fat_start_lba + g_fs.active_fat * g_fs.sectors_per_fat + sector;
+    if (disk_read_sector(lba, victim->data) != 0) {
+        return 0;
+    }
+    victim->sector = sector;
+    victim->valid = 1;
+    victim->dirty = 0;
+    victim->last_used = ++g_fat_cache_tick;
+    return victim;
+}
+
+/* Byte `offset` of the FAT, or 0 if its sector could not be loaded */
+static uint8_t *fat12_fat_byte(uint32_t offset, int for_write) {
+    fat12_fat_cache_slot_t *slot = fat12_fat_cache_get((uint32_t)(offset / SECTOR_SIZE));
+    if (!slot) {
+        return 0;
+    }
+    if (for_write) {
+        slot->dirty = 1;
+    }
+    return &slot->data[offset % SECTOR_SIZE];
+}
+
+static void fat12_bitmap_update(uint32_t cluster, int in_use) {
+    /* Before the bitmap is built the FAT itself is the only record */
+    if (!g_bitmap_ready || cluster < 2 || cluster >= g_fs.bitmap_end) {
+        return;
+    }
+    uint32_t mask = 1u << (cluster & 31);
+    uint32_t *word = &g_cluster_bitmap[cluster >> 5];
+    if (in_use && (*word & mask) == 0) {
+        *word |= mask;
+        g_free_clusters--;
+    } else if (!in_use && (*word & mask) != 0) {
+        *word &= ~mask;
+        g_free_clusters++;
+    }
+}
+
+/* First free cluster in [from, to), scanning a 32-bit word at a time */
+static uint32_t fat12_bitmap_scan(uint32_t from, uint32_t to) {
+    uint32_t bit = from;
+    while (bit < to) {
+        uint32_t word_index = bit >> 5;
+        /* Treat bits below `bit` in the first word as used */
+        uint32_t word = g_cluster_bitmap[word_index] | ((1u << (bit & 31)) - 1);
+        if (word != 0xFFFFFFFF) {
+            uint32_t found = (word_index << 5) + (uint32_t)__builtin_ctz(~word);
+            return (found < to) ? found : 0;
+        }
+        bit = (word_index + 1) << 5;
+    }
+    return 0;
+}
+
+static int fat12_bitmap_in_use(uint32_t cluster) {
+    return (g_cluster_bitmap[cluster >> 5] & (1u << (cluster & 31))) != 0;
+}
+
+/* Look for a free run of at least `want` clusters in [from, to). Returns 1
+ * as soon as one is found; either way the longest run seen is reported. */
+static int fat12_bitmap_find_run(uint32_t from, uint32_t to, uint32_t want, uint32_t *best_start, uint32_t *best_len) {
+    uint32_t cluster = from;
+    while (cluster < to) {
+        cluster = fat12_bitmap_scan(cluster, to);
+        if (!cluster) {
+            break;
+        }
+        uint32_t start = cluster;
+        while (cluster < to) {
+            /* Whole free words extend the run 32 clusters at a time */
+            if ((cluster & 31) == 0 && cluster + 32 <= to && g_cluster_bitmap[cluster >> 5] == 0) {
+                cluster += 32;
+                continue;
+            }
+            if (fat12_bitmap_in_use(cluster)) {
+                break;
+            }
+            cluster++;
+        }
+        uint32_t length = cluster - start;
+        if (length > *best_len) {
+            *best_start = start;
+            *best_len = length;
+        }
+        if (length >= want) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Chain links are only followed while they stay inside the volume;
+ * end-of-chain markers, bad-cluster marks and garbage all end a chain */
+static int fat12_cluster_valid(uint32_t cluster) {
+    return cluster >= 2 && cluster < g_fs.total_clusters + 2;
+}
+
+static uint32_t fat12_get_fat_entry(uint32_t cluster) {
+    if (g_fs.fat_type == 32 || g_fs.fat_type == 16) {
+        uint32_t width = (g_fs.fat_type == 32) ? 4 : 2;
+        uint32_t offset = cluster * width;
+        if (offset + width > g_fs.fat_size_bytes) {
+            return FAT12_CLUSTER_EOC;
+        }
+        /* Entries are naturally aligned, so one never straddles sectors */
+        uint8_t *ptr = fat12_fat_byte(offset, 0);
+        if (!ptr) {
+            return FAT12_CLUSTER_EOC;
+        }
+        if (width == 2) {
+            return (uint32_t)ptr[0] | ((uint32_t)ptr[1] << 8);
+        }
+        uint32_t value = (uint32_t)ptr[0] | ((uint32_t)ptr[1] << 8) |
+                         ((uint32_t)ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+        return value & 0x0FFFFFFF;
+    }
+
+    uint32_t index = cluster + (cluster / 2);
     if (index + 1 >= g_fs.fat_size_bytes) {
         return FAT12_CLUSTER_EOC;
     }
-    uint16_t value;
+    /* A 12-bit entry may straddle two sectors, so fetch the bytes one at a time */
+    uint8_t *lo_ptr = fat12_fat_byte(index, 0);
+    if (!lo_ptr) {
+        return FAT12_CLUSTER_EOC;
+    }
+    uint8_t lo = *lo_ptr;
+    uint8_t *hi_ptr = fat12_fat_byte(index + 1, 0);
+    if (!hi_ptr) {
+        return FAT12_CLUSTER_EOC;
+    }
+    uint8_t hi = *hi_ptr;
+    uint32_t value;
     if ((cluster & 1) == 0) {
-        value = (uint16_t)(g_fat_primary[index] | ((g_fat_primary[index + 1] & 0x0F) << 8));
+        value = (uint32_t)(lo | ((hi & 0x0F) << 8));
     } else {
-        value = (uint16_t)(((g_fat_primary[index] & 0xF0) >> 4) | (g_fat_primary[index + 1] << 4));
+        value = (uint32_t)(((lo & 0xF0) >> 4) | (hi << 4));
     }
-    return (uint16_t)(value & 0x0FFF);
+    return value & 0x0FFF;
 }
 
-static void fat12_set_fat_entry(uint16_t cluster, uint16_t value) {
-    uint32_t index = (uint32_t)cluster + (cluster / 2);
+static void fat12_set_fat_entry(uint32_t cluster, uint32_t value) {
+    if (g_fs.fat_type == 32 || g_fs.fat_type == 16) {
+        uint32_t width = (g_fs.fat_type == 32) ? 4 : 2;
+        uint32_t offset = cluster * width;
+        if (offset + width > g_fs.fat_size_bytes) {
+            return;
+        }
+        value &= (width == 4) ? 0x0FFFFFFF : 0xFFFF;
+        fat12_bitmap_update(cluster, value != FAT12_CLUSTER_FREE);
+        uint8_t *ptr = fat12_fat_byte(offset, 1);
+        if (!ptr) {
+            return;
+        }
+        ptr[0] = (uint8_t)(value & 0xFF);
+        ptr[1] = (uint8_t)((value >> 8) & 0xFF);
+        if (width == 4) {
+            /* The top four bits are reserved and must be preserved */
+            ptr[2] = (uint8_t)((value >> 16) & 0xFF);
+            ptr[3] = (uint8_t)((ptr[3] & 0xF0) | ((value >> 24) & 0x0F));
+        }
+        return;
+    }
+
+    uint32_t index = cluster + (cluster / 2);
+    if (index + 1 >= g_fs.fat_size_bytes) {
+        return;
+    }
     value &= 0x0FFF;
+    fat12_bitmap_update(cluster, value != FAT12_CLUSTER_FREE);
+    uint8_t *lo = fat12_fat_byte(index, 1);
+    if (!lo) {
+        return;
+    }
+    if ((cluster & 1) == 0) {
+        *lo = (uint8_t)(value & 0xFF);
+    } else {
+        *lo = (uint8_t)((*lo & 0x0F) | ((value & 0x0F) << 4));
+    }
+    uint8_t *hi = fat12_fat_byte(index + 1, 1);
+    if (!hi) {
+        return;
+    }
     if ((cluster & 1) == 0) {
-        g_fat_primary[index] = (uint8_t)(value & 0xFF);
-        g_fat_primary[index + 1] = (uint8_t)((g_fat_primary[index + 1] & 0xF0) | ((value >> 8) & 0x0F));
+        *hi = (uint8_t)((*hi & 0xF0) | ((value >> 8) & 0x0F));
     } else {
-        g_fat_primary[index] = (uint8_t)((g_fat_primary[index] & 0x0F) | ((value & 0x0F) << 4));
-        g_fat_primary[index + 1] = (uint8_t)((value >> 4) & 0xFF);
+        *hi = (uint8_t)((value >> 4) & 0xFF);
     }
-    g_fat_dirty = 1;
 }
 
-static uint16_t fat12_allocate_cluster(void) {
-    for (uint16_t cluster = 2; cluster < g_fs.total_clusters + 2; cluster++) {
-        if (fat12_get_fat_entry(cluster) == FAT12_CLUSTER_FREE) {
-            fat12_set_fat_entry(cluster, FAT12_CLUSTER_EOC);
-            fat12_memset(g_cluster_buffer, 0, g_fs.cluster_size_bytes);
-            if (fat12_write_cluster(cluster, g_cluster_buffer) != 0) {
-                fat12_set_fat_entry(cluster, FAT12_CLUSTER_FREE);
-                return 0;
+static void fat12_bitmap_mark_free(uint32_t cluster) {
+    g_cluster_bitmap[cluster >> 5] &= ~(1u << (cluster & 31));
+    g_free_clusters++;
+}
+
+/* Build the bitmap from the FAT. The table is streamed through a temporary
+ * heap buffer in large reads rather than pulled one sector at a time through
+ * the FAT cache, so dirty cached sectors must be on disk first. FAT12
+ * chunks are a multiple of 3 sectors so no entry straddles two reads. */
+static int fat12_bitmap_build(void) {
+    uint8_t *buffer = (uint8_t *)kmalloc(FAT12_MAX_SECTORS_PER_CLUSTER * SECTOR_SIZE);
+    if (!buffer) {
+        return FAT12_ERR_NO_MEMORY;
+    }
+    uint32_t words = (g_fs.bitmap_end + 31) / 32;
+    for (uint32_t i = 0; i < words; i++) {
+        g_cluster_bitmap[i] = 0xFFFFFFFF;
+    }
+    g_free_clusters = 0;
+    g_alloc_cursor = 2;
+
+    uint32_t fat_bytes;
+    uint32_t max_chunk;
+    if (g_fs.fat_type == 12) {
+        fat_bytes = (g_fs.bitmap_end * 3 + 1) / 2;
+        max_chunk = (FAT12_MAX_SECTORS_PER_CLUSTER / 3) * 3;
+    } else {
+        fat_bytes = g_fs.bitmap_end * (g_fs.fat_type / 8);
+        max_chunk = FAT12_MAX_SECTORS_PER_CLUSTER;
+    }
+    uint32_t fat_sectors = (fat_bytes + SECTOR_SIZE - 1) / SECTOR_SIZE;
+    uint32_t lba = g_fs.base_lba + g_fs.fat_start_lba + g_fs.active_fat * g_fs.sectors_per_fat;
+    uint32_t sector = 0;
+    while (sector < fat_sectors) {
+        uint32_t chunk = fat_sectors - sector;
+        if (chunk > max_chunk) {
+            chunk = max_chunk;
+        }
+        if (disk_read_sectors(lba + sector, buffer, (uint16_t)chunk) != 0) {
+            kfree(buffer);
+            return FAT12_ERR_IO;
+        }
+        uint32_t first;
+        uint32_t count;
+        if (g_fs.fat_type == 12) {
+            first = sector * SECTOR_SIZE * 2 / 3;
+            count = chunk * SECTOR_SIZE * 2 / 3;
+        } else {
+            first = sector * (SECTOR_SIZE / (g_fs.fat_type / 8));
+            count = chunk * (SECTOR_SIZE / (g_fs.fat_type / 8));
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t cluster = first + i;
+            if (cluster < 2) {
+                continue;
+            }
+            if (cluster >= g_fs.bitmap_end) {
+                break;
+            }
+            uint32_t value;
+            if (g_fs.fat_type == 12) {
+                const uint8_t *ptr = buffer + i + i / 2;
+                value = (uint32_t)ptr[0] | ((uint32_t)ptr[1] << 8);
+                value = (i & 1) ? (value >> 4) : (value & 0x0FFF);
+            } else {
+                const uint8_t *ptr = buffer + i * (g_fs.fat_type / 8);
+                value = (uint32_t)ptr[0] | ((uint32_t)ptr[1] << 8);
+                if (g_fs.fat_type == 32) {
+                    value |= ((uint32_t)ptr[2] << 16) | ((uint32_t)(ptr[3] & 0x0F) << 24);
+                }
+            }
+            if (value == FAT12_CLUSTER_FREE) {
+                fat12_bitmap_mark_free(cluster);
             }
-            return cluster;
         }
+        sector += chunk;
     }
-    return 0;
+    kfree(buffer);
+    return FAT12_OK;
 }
 
-static void fat12_free_chain(uint16_t start_cluster) {
-    uint16_t cluster = start_cluster;
-    while (cluster >= 2 && cluster < FAT12_CLUSTER_EOC) {
-        uint16_t next = fat12_get_fat_entry(cluster);
+/* Callers make sure no other handle is open on the chain: delete, truncate
+ * and rewrite are refused with FAT12_ERR_BUSY while it is */
+static void fat12_free_chain(uint32_t start_cluster) {
+    uint32_t cluster = start_cluster;
+    while (fat12_cluster_valid(cluster)) {
+        uint32_t next = fat12_get_fat_entry(cluster);
         fat12_set_fat_entry(cluster, FAT12_CLUSTER_FREE);
         cluster = next;
     }
 }
 
+static int fat12_root_sector_dirty(uint32_t sector) {
+    return (g_root_dirty_sectors[sector >> 5] & (1u << (sector & 31))) != 0;
+}
+
+/* Write back only the modified root sectors, one request per dirty run */
 static int fat12_flush_root(void) {
-    if (!g_root_dirty) {
-        return FAT12_OK;
-    }
-    for (uint16_t i = 0; i < g_fs.root_dir_sectors; i++) {
-        int res = disk_write_sector(g_fs.base_lba + g_fs.root_dir_start_lba + i, g_root_dir + i * SECTOR_SIZE);
-        if (res != 0) {
+    uint32_t sector = 0;
+    while (sector < g_fs.root_dir_sectors) {
+        if (!fat12_root_sector_dirty(sector)) {
+            sector++;
+            continue;
+        }
+        uint32_t run_start = sector;
+        while (sector < g_fs.root_dir_sectors && fat12_root_sector_dirty(sector)) {
+            sector++;
+        }
+        uint32_t run_length = (uint32_t)(sector - run_start);
+        if (disk_write_sectors(g_fs.base_lba + g_fs.root_dir_start_lba + run_start,
+                               g_root_dir + run_start * SECTOR_SIZE, run_length) != 0) {
             return FAT12_ERR_IO;
         }
+        g_stats.root_sector_writes += run_length;
+        for (uint32_t i = run_start; i < sector; i++) {
+            g_root_dirty_sectors[i >> 5] &= ~(1u << (i & 31));
+        }
     }
-    g_root_dirty = 0;
     return FAT12_OK;
 }
 
-static int fat12_flush_fats(void) {
-    if (!g_fat_dirty) {
+static uint32_t fat12_read_le32(const uint8_t *ptr) {
+    return (uint32_t)ptr[0] | ((uint32_t)ptr[1] << 8) | ((uint32_t)ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+}
+
+static void fat12_write_le32(uint8_t *ptr, uint32_t value) {
+    ptr[0] = (uint8_t)value;
+    ptr[1] = (uint8_t)(value >> 8);
+    ptr[2] = (uint8_t)(value >> 16);
+    ptr[3] = (uint8_t)(value >> 24);
+}
+
+/* The FSInfo free count is only a hint; it is reported as unknown when the
+ * bitmap does not cover the whole volume */
+static uint32_t fat12_fsinfo_free_count(void) {
+    if (g_fs.bitmap_end < g_fs.total_clusters + 2) {
+        return FAT12_FSINFO_UNKNOWN;
+    }
+    return g_free_clusters;
+}
+
+static int fat12_fsinfo_load(void) {
+    g_fsinfo_valid = 0;
+    if (g_fs.fat_type != 32 || g_fs.fs_info_sector == 0 || g_fs.fs_info_sector >= g_fs.reserved_sectors) {
         return FAT12_OK;
     }
-    for (uint8_t fat_index = 0; fat_index < g_fs.num_fats; fat_index++) {
-        uint32_t start_lba = g_fs.base_lba + g_fs.fat_start_lba + (fat_index * g_fs.sectors_per_fat);
-        for (uint16_t sector = 0; sector < g_fs.sectors_per_fat; sector++) {
-            int res = disk_write_sector(start_lba + sector, g_fat_primary + sector * SECTOR_SIZE);
-            if (res != 0) {
+    if (disk_read_sector(g_fs.base_lba + g_fs.fs_info_sector, g_fsinfo) != 0) {
+        return FAT12_ERR_IO;
+    }
+    if (fat12_read_le32(g_fsinfo) != FAT12_FSINFO_LEAD_SIG ||
+        fat12_read_le32(g_fsinfo + 484) != FAT12_FSINFO_STRUCT_SIG) {
+        return FAT12_OK;
+    }
+    g_fsinfo_valid = 1;
+    g_fsinfo_free = fat12_read_le32(g_fsinfo + 488);
+    g_fsinfo_next = fat12_read_le32(g_fsinfo + 492);
+    /* Start the next-fit search where the last writer left off */
+    if (g_fsinfo_next >= 2 && g_fsinfo_next < g_fs.bitmap_end) {
+        g_alloc_cursor = g_fsinfo_next;
+    }
+    return FAT12_OK;
+}
+
+static int fat12_fsinfo_flush(void) {
+    if (!g_fsinfo_valid) {
+        return FAT12_OK;
+    }
+    uint32_t free_count = fat12_fsinfo_free_count();
+    if (free_count == g_fsinfo_free && g_alloc_cursor == g_fsinfo_next) {
+        return FAT12_OK;
+    }
+    fat12_write_le32(g_fsinfo + 488, free_count);
+    fat12_write_le32(g_fsinfo + 492, g_alloc_cursor);
+    if (disk_write_sector(g_fs.base_lba + g_fs.fs_info_sector, g_fsinfo) != 0) {
+        return FAT12_ERR_IO;
+    }
+    g_fsinfo_free = free_count;
+    g_fsinfo_next = g_alloc_cursor;
+    return FAT12_OK;
+}
+
+static fat12_fat_cache_slot_t *fat12_fat_cache_find_dirty(uint32_t sector) {
+    for (int i = 0; i < FAT12_FAT_CACHE_SLOTS; i++) {
+        fat12_fat_cache_slot_t *slot = &g_fat_cache[i];
+        if (slot->valid && slot->dirty && slot->sector == sector) {
+            return slot;
+        }
+    }
+    return 0;
+}
+
+/* Dirty slots holding neighbouring sectors are staged together so each
+ * FAT copy receives one request per dirty run */
+static int fat12_flush_fats(void) {
+    for (;;) {
+        fat12_fat_cache_slot_t *first = 0;
+        for (int i = 0; i < FAT12_FAT_CACHE_SLOTS; i++) {
+            fat12_fat_cache_slot_t *slot = &g_fat_cache[i];
+            if (slot->valid && slot->dirty && (!first || slot->sector < first->sector)) {
+                first = slot;
+            }
+        }
+        if (!first) {
+            return fat12_fsinfo_flush();
+        }
+
+        fat12_fat_cache_slot_t *run[FAT12_FAT_CACHE_SLOTS];
+        uint32_t run_length = 0;
+        fat12_fat_cache_slot_t *slot = first;
+        while (slot) {
+            fat12_memcpy(g_fat_flush_buffer + run_length * SECTOR_SIZE, slot->data, SECTOR_SIZE);
+            run[run_length++] = slot;
+            slot = fat12_fat_cache_find_dirty((uint32_t)first->sector + run_length);
+        }
+
+        for (uint8_t fat_index = 0; fat_index < g_fs.num_fats; fat_index++) {
+            if (!g_fs.mirror_fats && fat_index != g_fs.active_fat) {
+                continue;
+            }
+            uint32_t lba = g_fs.base_lba + g_fs.fat_start_lba + (fat_index * g_fs.sectors_per_fat) + first->sector;
+            if (disk_write_sectors(lba, g_fat_flush_buffer, run_length) != 0) {
                 return FAT12_ERR_IO;
             }
+            g_stats.fat_sector_writes += run_length;
+        }
+        for (uint32_t i = 0; i < run_length; i++) {
+            run[i]->dirty = 0;
         }
     }
-    g_fat_dirty = 0;
+}
+
+/* Lazy mount: the root directory region and the free bitmap are loaded the
+ * first time something needs them, each with multi-sector reads */
+static int fat12_root_ensure(void) {
+    if (g_root_loaded) {
+        return FAT12_OK;
+    }
+    if (g_fs.root_dir_sectors > 0 &&
+        disk_read_sectors(g_fs.base_lba + g_fs.root_dir_start_lba, g_root_dir, g_fs.root_dir_sectors) != 0) {
+        return FAT12_ERR_IO;
+    }
+    g_root_loaded = 1;
+    return FAT12_OK;
+}
+
+static int fat12_bitmap_ensure(void) {
+    if (g_bitmap_ready) {
+        return FAT12_OK;
+    }
+    int res = fat12_flush_fats();
+    if (res == FAT12_OK) {
+        res = fat12_bitmap_build();
+    }
+    if (res == FAT12_OK) {
+        res = fat12_fsinfo_load();
+    }
+    if (res != FAT12_OK) {
+        return res;
+    }
+    g_bitmap_ready = 1;
     return FAT12_OK;
 }
 
+/* Reserve up to `want` contiguous clusters as a terminated chain. Next-fit
+ * from the allocation cursor takes the first run that is long enough;
+ * otherwise the longest free run is used and the caller asks again for the
+ * rest. Returns the number of clusters reserved (0 when the disk is full).
+ * The clusters' contents are left untouched. */
+static uint32_t fat12_allocate_extent(uint32_t want, uint32_t *out_first) {
+    if (fat12_bitmap_ensure() != FAT12_OK) {
+        return 0;
+    }
+    if (want == 0 || g_free_clusters == 0) {
+        return 0;
+    }
+    uint32_t end = g_fs.bitmap_end;
+    if (g_alloc_cursor < 2 || g_alloc_cursor >= end) {
+        g_alloc_cursor = 2;
+    }
+    uint32_t best_start = 0;
+    uint32_t best_len = 0;
+    if (!fat12_bitmap_find_run(g_alloc_cursor, end, want, &best_start, &best_len)) {
+        fat12_bitmap_find_run(2, g_alloc_cursor, want, &best_start, &best_len);
+    }
+    if (best_len == 0) {
+        return 0;
+    }
+
+    uint32_t length = (best_len < want) ? best_len : want;
+    for (uint32_t i = 0; i < length; i++) {
+        uint32_t cluster = best_start + i;
+        fat12_set_fat_entry(cluster, (i + 1 < length) ? cluster + 1 : FAT12_CLUSTER_EOC);
+    }
+    g_alloc_cursor = best_start + length;
+    g_stats.alloc_extents++;
+    g_stats.alloc_clusters += length;
+    *out_first = best_start;
+    return length;
+}
+
+/* Single zero-filled cluster, for directory growth where stale data would
+ * read back as directory entries */
+static uint32_t fat12_allocate_cluster(void) {
+    uint32_t cluster = 0;
+    if (fat12_allocate_extent(1, &cluster) == 0) {
+        return 0;
+    }
+    fat12_memset(g_cluster_buffer, 0, g_fs.cluster_size_bytes);
+    if (fat12_write_cluster(cluster, g_cluster_buffer) != 0) {
+        fat12_set_fat_entry(cluster, FAT12_CLUSTER_FREE);
+        return 0;
+    }
+    return cluster;
+}
+
+
 static int fat12_is_free_entry(const fat12_raw_dir_entry_t *entry) {
     return (entry->name[0] == 0x00 || entry->name[0] == 0xE5);
 }
@@ -363,7 +1015,21 @@ static int fat12_is_dot_entry(const fat12_raw_dir_entry_t *entry) {
 }
 
 
-static void fat12_fill_dir_entry(fat12_raw_dir_entry_t *dest, const uint8_t short_name[11], uint8_t attr, uint16_t first_cluster, uint32_t size) {
+/* FAT32 keeps the high half of the first cluster in the entry too */
+static uint32_t fat12_entry_cluster(const fat12_raw_dir_entry_t *entry) {
+    uint32_t cluster = entry->first_cluster_low;
+    if (g_fs.fat_type == 32) {
+        cluster |= (uint32_t)entry->first_cluster_high << 16;
+    }
+    return cluster;
+}
+
+static void fat12_set_entry_cluster(fat12_raw_dir_entry_t *entry, uint32_t cluster) {
+    entry->first_cluster_low = (uint16_t)(cluster & 0xFFFF);
+    entry->first_cluster_high = (g_fs.fat_type == 32) ? (uint16_t)(cluster >> 16) : 0;
+}
+
+static void fat12_fill_dir_entry(fat12_raw_dir_entry_t *dest, const uint8_t short_name[11], uint8_t attr, uint32_t first_cluster, uint32_t size) {
     fat12_memcpy(dest->name, short_name, 11);
     dest->attr = attr;
     dest->nt_reserved = 0;
@@ -371,10 +1037,9 @@ static void fat12_fill_dir_entry(fat12_raw_dir_entry_t *dest, const uint8_t shor
     dest->creation_time = 0;
     dest->creation_date = 0;
     dest->last_access_date = 0;
-    dest->first_cluster_high = 0;
     dest->write_time = 0;
     dest->write_date = 0;
-    dest->first_cluster_low = first_cluster;
+    fat12_set_entry_cluster(dest, first_cluster);
     dest->file_size = size;
 }
 
@@ -382,11 +1047,21 @@ static void fat12_copy_entry_info(const fat12_raw_dir_entry_t *entry, fat12_dir_
     fat12_dir_name_to_string(entry->name, info->name);
     info->attr = entry->attr;
     info->size = entry->file_size;
-    info->first_cluster = entry->first_cluster_low;
+    info->first_cluster = fat12_entry_cluster(entry);
 }
 
-static int fat12_iterate_directory_internal(uint16_t dir_cluster, fat12_dir_iter_cb cb, void *context) {
+/* Directory 0 is the root everywhere in this file. FAT12/FAT16 keep it in
+ * the fixed region (g_root_dir); FAT32 keeps it in a cluster chain. */
+static uint32_t fat12_dir_first_cluster(uint32_t dir_cluster) {
+    return (dir_cluster == 0) ? g_fs.root_cluster : dir_cluster;
+}
+
+static int fat12_iterate_directory_internal(uint32_t dir_cluster, fat12_dir_iter_cb cb, void *context) {
+    dir_cluster = fat12_dir_first_cluster(dir_cluster);
     if (dir_cluster == 0) {
+        if (fat12_root_ensure() != FAT12_OK) {
+            return FAT12_ERR_IO;
+        }
         /* Root directory */
         for (uint32_t i = 0; i < g_fs.root_entry_count; i++) {
             fat12_raw_dir_entry_t *entry = (fat12_raw_dir_entry_t *)(g_root_dir + i * FAT12_DIR_ENTRY_SIZE);
@@ -411,8 +1086,8 @@ static int fat12_iterate_directory_internal(uint16_t dir_cluster, fat12_dir_iter
         return FAT12_OK;
     }
 
-    uint16_t cluster = dir_cluster;
-    while (cluster >= 2 && cluster < FAT12_CLUSTER_EOC) {
+    uint32_t cluster = dir_cluster;
+    while (fat12_cluster_valid(cluster)) {
         if (fat12_read_cluster(cluster, g_cluster_buffer) != 0) {
             return FAT12_ERR_IO;
         }
@@ -442,8 +1117,12 @@ static int fat12_iterate_directory_internal(uint16_t dir_cluster, fat12_dir_iter
     return FAT12_OK;
 }
 
-static int fat12_find_entry(uint16_t dir_cluster, const uint8_t short_name[11], fat12_raw_dir_entry_t *out_entry, uint16_t *out_owner_cluster, uint16_t *out_entry_index) {
+static int fat12_scan_directory(uint32_t dir_cluster, const uint8_t short_name[11], fat12_raw_dir_entry_t *out_entry, uint32_t *out_owner_cluster, uint32_t *out_entry_index) {
+    dir_cluster = fat12_dir_first_cluster(dir_cluster);
     if (dir_cluster == 0) {
+        if (fat12_root_ensure() != FAT12_OK) {
+            return FAT12_ERR_IO;
+        }
         for (uint32_t i = 0; i < g_fs.root_entry_count; i++) {
             fat12_raw_dir_entry_t *entry = (fat12_raw_dir_entry_t *)(g_root_dir + i * FAT12_DIR_ENTRY_SIZE);
             if (entry->name[0] == 0x00) {
@@ -460,7 +1139,7 @@ static int fat12_find_entry(uint16_t dir_cluster, const uint8_t short_name[11],
                     *out_owner_cluster = 0;
                 }
                 if (out_entry_index) {
-                    *out_entry_index = (uint16_t)i;
+                    *out_entry_index = (uint32_t)i;
                 }
                 return FAT12_OK;
             }
@@ -468,8 +1147,8 @@ static int fat12_find_entry(uint16_t dir_cluster, const uint8_t short_name[11],
         return FAT12_ERR_NOT_FOUND;
     }
 
-    uint16_t cluster = dir_cluster;
-    while (cluster >= 2 && cluster < FAT12_CLUSTER_EOC) {
+    uint32_t cluster = dir_cluster;
+    while (fat12_cluster_valid(cluster)) {
         if (fat12_read_cluster(cluster, g_cluster_buffer) != 0) {
             return FAT12_ERR_IO;
         }
@@ -489,7 +1168,7 @@ static int fat12_find_entry(uint16_t dir_cluster, const uint8_t short_name[11],
                     *out_owner_cluster = cluster;
                 }
                 if (out_entry_index) {
-                    *out_entry_index = (uint16_t)idx;
+                    *out_entry_index = (uint32_t)idx;
                 }
                 return FAT12_OK;
             }
@@ -500,40 +1179,495 @@ static int fat12_find_entry(uint16_t dir_cluster, const uint8_t short_name[11],
     return FAT12_ERR_NOT_FOUND;
 }
 
-static int fat12_write_entry(uint16_t owner_cluster, uint16_t entry_index, const fat12_raw_dir_entry_t *entry) {
-    if (owner_cluster == 0) {
-        if (entry_index >= g_fs.root_entry_count) {
-            return FAT12_ERR_OUT_OF_RANGE;
+/* Directory index */
+
+static uint32_t fat12_name_hash(const uint8_t short_name[11]) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < 11; i++) {
+        hash = (hash ^ short_name[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static int fat12_dir_index_slot_used(const fat12_dir_index_t *index, uint32_t slot) {
+    return (index->used[slot >> 5] & (1u << (slot & 31))) != 0;
+}
+
+static void fat12_dir_index_unhash(fat12_dir_index_t *index, uint32_t slot) {
+    uint32_t bucket = index->hashes[slot] & (FAT12_DIR_INDEX_BUCKETS - 1);
+    for (uint32_t probe = 0; probe < FAT12_DIR_INDEX_BUCKETS; probe++) {
+        uint16_t value = index->buckets[bucket];
+        if (value == FAT12_DIR_INDEX_EMPTY) {
+            return;
         }
-        fat12_memcpy(g_root_dir + entry_index * FAT12_DIR_ENTRY_SIZE, entry, sizeof(fat12_raw_dir_entry_t));
-        g_root_dirty = 1;
-        return FAT12_OK;
+        if (value == slot + 1) {
+            index->buckets[bucket] = FAT12_DIR_INDEX_TOMBSTONE;
+            index->tombstones++;
+            return;
+        }
+        bucket = (bucket + 1) & (FAT12_DIR_INDEX_BUCKETS - 1);
     }
+}
 
-    if (fat12_read_cluster(owner_cluster, g_cluster_buffer) != 0) {
-        return FAT12_ERR_IO;
+static void fat12_dir_index_hash(fat12_dir_index_t *index, uint32_t slot, uint32_t hash) {
+    uint32_t bucket = hash & (FAT12_DIR_INDEX_BUCKETS - 1);
+    while (index->buckets[bucket] != FAT12_DIR_INDEX_EMPTY &&
+           index->buckets[bucket] != FAT12_DIR_INDEX_TOMBSTONE) {
+        bucket = (bucket + 1) & (FAT12_DIR_INDEX_BUCKETS - 1);
     }
-    uint32_t max_entries = g_fs.cluster_size_bytes / FAT12_DIR_ENTRY_SIZE;
-    if (entry_index >= max_entries) {
-        return FAT12_ERR_OUT_OF_RANGE;
+    if (index->buckets[bucket] == FAT12_DIR_INDEX_TOMBSTONE) {
+        index->tombstones--;
     }
-    fat12_memcpy(g_cluster_buffer + entry_index * FAT12_DIR_ENTRY_SIZE, entry, sizeof(fat12_raw_dir_entry_t));
-    if (fat12_write_cluster(owner_cluster, g_cluster_buffer) != 0) {
-        return FAT12_ERR_IO;
+    index->buckets[bucket] = (uint16_t)(slot + 1);
+    index->hashes[slot] = hash;
+}
+
+/* Where slot `slot` lives on disk; owner 0 is the fixed root region */
+static void fat12_dir_index_locate(const fat12_dir_index_t *index, uint32_t slot, uint32_t *out_owner_cluster, uint32_t *out_entry_index) {
+    if (index->cluster_count == 0) {
+        *out_owner_cluster = 0;
+        *out_entry_index = slot;
+        return;
     }
-    return FAT12_OK;
+    uint32_t per_cluster = g_fs.cluster_size_bytes / FAT12_DIR_ENTRY_SIZE;
+    *out_owner_cluster = index->clusters[slot / per_cluster];
+    *out_entry_index = slot % per_cluster;
 }
 
-static int fat12_find_free_entry(uint16_t dir_cluster, uint16_t *out_owner_cluster, uint16_t *out_entry_index) {
-    if (dir_cluster == 0) {
-        for (uint32_t i = 0; i < g_fs.root_entry_count; i++) {
-            fat12_raw_dir_entry_t *entry = (fat12_raw_dir_entry_t *)(g_root_dir + i * FAT12_DIR_ENTRY_SIZE);
-            if (fat12_is_free_entry(entry)) {
-                if (out_owner_cluster) {
-                    *out_owner_cluster = 0;
-                }
+/* Append a freshly zeroed cluster's slots; only called once the directory
+ * has no free slot left */
+static void fat12_dir_index_add_cluster(fat12_dir_index_t *index, uint32_t cluster) {
+    uint32_t per_cluster = g_fs.cluster_size_bytes / FAT12_DIR_ENTRY_SIZE;
+    if (index->cluster_count == FAT12_DIR_INDEX_MAX_CLUSTERS ||
+        index->slot_count + per_cluster > FAT12_DIR_INDEX_MAX_ENTRIES) {
+        index->overflow = 1;
+        return;
+    }
+    uint32_t first_slot = index->slot_count;
+    index->clusters[index->cluster_count++] = cluster;
+    index->slot_count += per_cluster;
+    for (uint32_t i = 0; i < per_cluster; i++) {
+        index->free_slots[i] = (uint16_t)(first_slot + per_cluster - 1 - i);
+    }
+    index->free_count = per_cluster;
+}
+
+static void fat12_dir_index_invalidate(uint32_t dir_cluster) {
+    for (int i = 0; i < FAT12_DIR_INDEX_SLOTS; i++) {
+        if (g_dir_index[i] && g_dir_index[i]->dir_cluster == dir_cluster) {
+            kfree(g_dir_index[i]);
+            g_dir_index[i] = 0;
+        }
+    }
+}
+
+static void fat12_dir_index_release_all(void) {
+    for (int i = 0; i < FAT12_DIR_INDEX_SLOTS; i++) {
+        kfree(g_dir_index[i]);
+        g_dir_index[i] = 0;
+    }
+}
+
+/* Index for `dir_cluster`, built with one pass over the directory on first
+ * use. Returns 0 when the directory cannot be indexed (too large, no memory
+ * for the index or an I/O error), in which case callers scan as before. */
+static fat12_dir_index_t *fat12_dir_index_get(uint32_t dir_cluster) {
+    fat12_dir_index_t *index = 0;
+    for (int i = 0; i < FAT12_DIR_INDEX_SLOTS; i++) {
+        if (g_dir_index[i] && g_dir_index[i]->valid && g_dir_index[i]->dir_cluster == dir_cluster) {
+            index = g_dir_index[i];
+            break;
+        }
+    }
+    if (index) {
+        /* Too many tombstones make probes long; start over */
+        if (!index->overflow && index->tombstones > FAT12_DIR_INDEX_BUCKETS / 4) {
+            index->valid = 0;
+        } else {
+            index->last_used = ++g_dir_index_tick;
+            return index->overflow ? 0 : index;
+        }
+    } else {
+        /* An empty slot, else the least recently used index, whose memory
+         * is reused for this directory */
+        int victim = 0;
+        for (int i = 0; i < FAT12_DIR_INDEX_SLOTS; i++) {
+            if (!g_dir_index[i] || !g_dir_index[i]->valid) {
+                victim = i;
+                break;
+            }
+            if (g_dir_index[i]->last_used < g_dir_index[victim]->last_used) {
+                victim = i;
+            }
+        }
+        if (!g_dir_index[victim]) {
+            g_dir_index[victim] = (fat12_dir_index_t *)kmalloc(sizeof(fat12_dir_index_t));
+            if (!g_dir_index[victim]) {
+                return 0;
+            }
+        }
+        index = g_dir_index[victim];
+    }
+
+    fat12_memset(index, 0, sizeof(*index));
+    index->dir_cluster = dir_cluster;
+    index->last_used = ++g_dir_index_tick;
+    g_stats.dir_index_builds++;
+
+    uint32_t first = fat12_dir_first_cluster(dir_cluster);
+    uint32_t per_cluster = g_fs.cluster_size_bytes / FAT12_DIR_ENTRY_SIZE;
+    int ended = 0;
+    if (first == 0) {
+        if (fat12_root_ensure() != FAT12_OK) {
+            return 0;
+        }
+        if (g_fs.root_entry_count > FAT12_DIR_INDEX_MAX_ENTRIES) {
+            index->valid = 1;
+            index->overflow = 1;
+            return 0;
+        }
+        index->slot_count = g_fs.root_entry_count;
+    }
+    uint32_t cluster = first;
+    for (;;) {
+        const uint8_t *base = g_root_dir;
+        uint32_t count = g_fs.root_entry_count;
+        uint32_t slot_base = 0;
+        if (first != 0) {
+            if (!fat12_cluster_valid(cluster)) {
+                break;
+            }
+            if (index->cluster_count == FAT12_DIR_INDEX_MAX_CLUSTERS ||
+                index->slot_count + per_cluster > FAT12_DIR_INDEX_MAX_ENTRIES) {
+                index->valid = 1;
+                index->overflow = 1;
+                return 0;
+            }
+            if (fat12_read_cluster(cluster, g_cluster_buffer) != 0) {
+                return 0;
+            }
+            base = g_cluster_buffer;
+            count = per_cluster;
+            slot_base = index->slot_count;
+            index->clusters[index->cluster_count++] = cluster;
+            index->slot_count += per_cluster;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            const fat12_raw_dir_entry_t *entry = (const fat12_raw_dir_entry_t *)(base + i * FAT12_DIR_ENTRY_SIZE);
+            if (entry->name[0] == 0x00) {
+                ended = 1;
+            }
+            if (ended || entry->name[0] == 0xE5) {
+                continue;
+            }
+            uint32_t slot = slot_base + i;
+            index->used[slot >> 5] |= 1u << (slot & 31);
+            fat12_dir_index_hash(index, slot, fat12_name_hash(entry->name));
+        }
+        if (first == 0) {
+            break;
+        }
+        cluster = fat12_get_fat_entry(cluster);
+    }
+
+    for (uint32_t slot = index->slot_count; slot > 0; slot--) {
+        if (!fat12_dir_index_slot_used(index, slot - 1)) {
+            index->free_slots[index->free_count++] = (uint16_t)(slot - 1);
+        }
+    }
+    index->valid = 1;
+    return index;
+}
+
+static int fat12_dir_index_find(fat12_dir_index_t *index, const uint8_t short_name[11], fat12_raw_dir_entry_t *out_entry, uint32_t *out_owner_cluster, uint32_t *out_entry_index) {
+    uint32_t hash = fat12_name_hash(short_name);
+    uint32_t bucket = hash & (FAT12_DIR_INDEX_BUCKETS - 1);
+    for (uint32_t probe = 0; probe < FAT12_DIR_INDEX_BUCKETS; probe++) {
+        uint16_t value = index->buckets[bucket];
+        if (value == FAT12_DIR_INDEX_EMPTY) {
+            break;
+        }
+        bucket = (bucket + 1) & (FAT12_DIR_INDEX_BUCKETS - 1);
+        if (value == FAT12_DIR_INDEX_TOMBSTONE || index->hashes[value - 1] != hash) {
+            continue;
+        }
+
+        /* Hash match: confirm against the entry itself */
+        uint32_t owner_cluster;
+        uint32_t entry_index;
+        fat12_dir_index_locate(index, value - 1, &owner_cluster, &entry_index);
+        const fat12_raw_dir_entry_t *entry;
+        uint8_t sector[SECTOR_SIZE];
+        if (owner_cluster == 0) {
+            entry = (const fat12_raw_dir_entry_t *)(g_root_dir + entry_index * FAT12_DIR_ENTRY_SIZE);
+        } else {
+            uint32_t byte_offset = entry_index * FAT12_DIR_ENTRY_SIZE;
+            uint32_t lba = g_fs.base_lba + fat12_cluster_to_lba(owner_cluster) + byte_offset / SECTOR_SIZE;
+            if (disk_read_sector(lba, sector) != 0) {
+                return FAT12_ERR_IO;
+            }
+            entry = (const fat12_raw_dir_entry_t *)(sector + byte_offset % SECTOR_SIZE);
+        }
+        if (fat12_memcmp(entry->name, short_name, 11) != 0) {
+            continue;
+        }
+        if (out_entry) {
+            fat12_memcpy(out_entry, entry, sizeof(fat12_raw_dir_entry_t));
+        }
+        if (out_owner_cluster) {
+            *out_owner_cluster = owner_cluster;
+        }
+        if (out_entry_index) {
+            *out_entry_index = entry_index;
+        }
+        return FAT12_OK;
+    }
+    return FAT12_ERR_NOT_FOUND;
+}
+
+/* Keep every index that covers `owner_cluster` in step with an entry that
+ * was just written there */
+static void fat12_dir_index_update(uint32_t owner_cluster, uint32_t entry_index, const fat12_raw_dir_entry_t *entry) {
+    uint32_t per_cluster = g_fs.cluster_size_bytes / FAT12_DIR_ENTRY_SIZE;
+    for (int i = 0; i < FAT12_DIR_INDEX_SLOTS; i++) {
+        fat12_dir_index_t *index = g_dir_index[i];
+        if (!index || !index->valid || index->overflow) {
+            continue;
+        }
+        uint32_t slot = FAT12_DIR_INDEX_MAX_ENTRIES;
+        if (owner_cluster == 0) {
+            if (index->cluster_count == 0) {
+                slot = entry_index;
+            }
+        } else {
+            for (uint32_t c = 0; c < index->cluster_count; c++) {
+                if (index->clusters[c] == owner_cluster) {
+                    slot = c * per_cluster + entry_index;
+                    break;
+                }
+            }
+        }
+        if (slot >= index->slot_count) {
+            continue;
+        }
+
+        if (fat12_dir_index_slot_used(index, slot)) {
+            fat12_dir_index_unhash(index, slot);
+            index->used[slot >> 5] &= ~(1u << (slot & 31));
+            index->free_slots[index->free_count++] = (uint16_t)slot;
+        }
+        if (fat12_is_free_entry(entry)) {
+            continue;
+        }
+        /* The slot is almost always the top of the free stack */
+        for (uint32_t f = index->free_count; f > 0; f--) {
+            if (index->free_slots[f - 1] == slot) {
+                for (uint32_t k = f - 1; k + 1 < index->free_count; k++) {
+                    index->free_slots[k] = index->free_slots[k + 1];
+                }
+                index->free_count--;
+                break;
+            }
+        }
+        index->used[slot >> 5] |= 1u << (slot & 31);
+        fat12_dir_index_hash(index, slot, fat12_name_hash(entry->name));
+    }
+}
+
+/* Dentry cache */
+
+static fat12_dentry_t *fat12_dentry_set(uint32_t dir_cluster, const uint8_t short_name[11]) {
+    uint32_t hash = 2166136261u;
+    hash = (hash ^ (dir_cluster & 0xFF)) * 16777619u;
+    hash = (hash ^ (dir_cluster >> 8)) * 16777619u;
+    for (int i = 0; i < 11; i++) {
+        hash = (hash ^ short_name[i]) * 16777619u;
+    }
+    return g_dentry_cache[hash % FAT12_DENTRY_CACHE_SETS];
+}
+
+static fat12_dentry_t *fat12_dentry_lookup(uint32_t dir_cluster, const uint8_t short_name[11]) {
+    fat12_dentry_t *set = fat12_dentry_set(dir_cluster, short_name);
+    for (int way = 0; way < FAT12_DENTRY_CACHE_WAYS; way++) {
+        fat12_dentry_t *dentry = &set[way];
+        if (dentry->valid && dentry->dir_cluster == dir_cluster &&
+            fat12_memcmp(dentry->short_name, short_name, 11) == 0) {
+            dentry->last_used = ++g_dentry_tick;
+            return dentry;
+        }
+    }
+    return 0;
+}
+
+/* Record a lookup result; `entry` is 0 for a name known to be absent */
+static void fat12_dentry_store(uint32_t dir_cluster, const uint8_t short_name[11], const fat12_raw_dir_entry_t *entry, uint32_t owner_cluster, uint32_t entry_index) {
+    fat12_dentry_t *dentry = fat12_dentry_lookup(dir_cluster, short_name);
+    if (!dentry) {
+        fat12_dentry_t *set = fat12_dentry_set(dir_cluster, short_name);
+        dentry = &set[0];
+        for (int way = 0; way < FAT12_DENTRY_CACHE_WAYS; way++) {
+            if (!set[way].valid) {
+                dentry = &set[way];
+                break;
+            }
+            if (set[way].last_used < dentry->last_used) {
+                dentry = &set[way];
+            }
+        }
+        dentry->valid = 1;
+        dentry->dir_cluster = dir_cluster;
+        fat12_memcpy(dentry->short_name, short_name, 11);
+        dentry->last_used = ++g_dentry_tick;
+    }
+    dentry->negative = entry ? 0 : 1;
+    if (entry) {
+        fat12_memcpy(&dentry->entry, entry, sizeof(fat12_raw_dir_entry_t));
+        dentry->owner_cluster = owner_cluster;
+        dentry->entry_index = entry_index;
+    }
+}
+
+/* Forget everything cached for a directory whose cluster is being reused */
+static void fat12_dentry_invalidate_dir(uint32_t dir_cluster) {
+    for (int set = 0; set < FAT12_DENTRY_CACHE_SETS; set++) {
+        for (int way = 0; way < FAT12_DENTRY_CACHE_WAYS; way++) {
+            if (g_dentry_cache[set][way].dir_cluster == dir_cluster) {
+                g_dentry_cache[set][way].valid = 0;
+            }
+        }
+    }
+}
+
+static int fat12_find_entry(uint32_t dir_cluster, const uint8_t short_name[11], fat12_raw_dir_entry_t *out_entry, uint32_t *out_owner_cluster, uint32_t *out_entry_index) {
+    fat12_dentry_t *dentry = fat12_dentry_lookup(dir_cluster, short_name);
+    if (dentry) {
+        g_stats.dentry_hits++;
+        if (dentry->negative) {
+            g_stats.dentry_negative_hits++;
+            return FAT12_ERR_NOT_FOUND;
+        }
+        if (out_entry) {
+            fat12_memcpy(out_entry, &dentry->entry, sizeof(fat12_raw_dir_entry_t));
+        }
+        if (out_owner_cluster) {
+            *out_owner_cluster = dentry->owner_cluster;
+        }
+        if (out_entry_index) {
+            *out_entry_index = dentry->entry_index;
+        }
+        return FAT12_OK;
+    }
+
+    g_stats.dentry_misses++;
+    fat12_raw_dir_entry_t entry;
+    uint32_t owner_cluster = 0;
+    uint32_t entry_index = 0;
+    int res;
+    fat12_dir_index_t *index = fat12_dir_index_get(dir_cluster);
+    if (index) {
+        res = fat12_dir_index_find(index, short_name, &entry, &owner_cluster, &entry_index);
+    } else {
+        res = fat12_scan_directory(dir_cluster, short_name, &entry, &owner_cluster, &entry_index);
+    }
+    if (res == FAT12_OK) {
+        fat12_dentry_store(dir_cluster, short_name, &entry, owner_cluster, entry_index);
+        if (out_entry) {
+            fat12_memcpy(out_entry, &entry, sizeof(fat12_raw_dir_entry_t));
+        }
+        if (out_owner_cluster) {
+            *out_owner_cluster = owner_cluster;
+        }
+        if (out_entry_index) {
+            *out_entry_index = entry_index;
+        }
+    } else if (res == FAT12_ERR_NOT_FOUND) {
+        fat12_dentry_store(dir_cluster, short_name, 0, 0, 0);
+    }
+    return res;
+}
+
+static int fat12_write_entry(uint32_t owner_cluster, uint32_t entry_index, const fat12_raw_dir_entry_t *entry) {
+    if (owner_cluster == 0) {
+        if (entry_index >= g_fs.root_entry_count) {
+            return FAT12_ERR_OUT_OF_RANGE;
+        }
+        if (fat12_root_ensure() != FAT12_OK) {
+            return FAT12_ERR_IO;
+        }
+        fat12_memcpy(g_root_dir + entry_index * FAT12_DIR_ENTRY_SIZE, entry, sizeof(fat12_raw_dir_entry_t));
+        uint32_t sector = (uint32_t)((entry_index * FAT12_DIR_ENTRY_SIZE) / SECTOR_SIZE);
+        g_root_dirty_sectors[sector >> 5] |= 1u << (sector & 31);
+        fat12_dir_index_update(0, entry_index, entry);
+        return FAT12_OK;
+    }
+
+    uint32_t max_entries = g_fs.cluster_size_bytes / FAT12_DIR_ENTRY_SIZE;
+    if (entry_index >= max_entries) {
+        return FAT12_ERR_OUT_OF_RANGE;
+    }
+    /* Only the sector holding the entry changes */
+    uint8_t sector[SECTOR_SIZE];
+    uint32_t byte_offset = entry_index * FAT12_DIR_ENTRY_SIZE;
+    uint32_t lba = g_fs.base_lba + fat12_cluster_to_lba(owner_cluster) + byte_offset / SECTOR_SIZE;
+    if (disk_read_sector(lba, sector) != 0) {
+        return FAT12_ERR_IO;
+    }
+    fat12_memcpy(sector + byte_offset % SECTOR_SIZE, entry, sizeof(fat12_raw_dir_entry_t));
+    if (disk_write_sector(lba, sector) != 0) {
+        return FAT12_ERR_IO;
+    }
+    fat12_dir_index_update(owner_cluster, entry_index, entry);
+    return FAT12_OK;
+}
+
+/* Link a zeroed cluster onto the end of a directory chain */
+static uint32_t fat12_grow_directory(uint32_t last_cluster) {
+    uint32_t new_cluster = fat12_allocate_cluster();
+    if (!new_cluster) {
+        return 0;
+    }
+    if (last_cluster) {
+        fat12_set_fat_entry(last_cluster, new_cluster);
+        fat12_set_fat_entry(new_cluster, FAT12_CLUSTER_EOC);
+    }
+    return new_cluster;
+}
+
+static int fat12_find_free_entry(uint32_t dir_cluster, uint32_t *out_owner_cluster, uint32_t *out_entry_index) {
+    fat12_dir_index_t *index = fat12_dir_index_get(dir_cluster);
+    if (index) {
+        if (index->free_count == 0) {
+            if (index->cluster_count == 0) {
+                return FAT12_ERR_DIR_FULL;
+            }
+            uint32_t new_cluster = fat12_grow_directory(index->clusters[index->cluster_count - 1]);
+            if (!new_cluster) {
+                return FAT12_ERR_NO_FREE_CLUSTER;
+            }
+            fat12_dir_index_add_cluster(index, new_cluster);
+            if (index->overflow) {
+                *out_owner_cluster = new_cluster;
+                *out_entry_index = 0;
+                return FAT12_OK;
+            }
+        }
+        fat12_dir_index_locate(index, index->free_slots[index->free_count - 1], out_owner_cluster, out_entry_index);
+        return FAT12_OK;
+    }
+
+    dir_cluster = fat12_dir_first_cluster(dir_cluster);
+    if (dir_cluster == 0) {
+        if (fat12_root_ensure() != FAT12_OK) {
+            return FAT12_ERR_IO;
+        }
+        for (uint32_t i = 0; i < g_fs.root_entry_count; i++) {
+            fat12_raw_dir_entry_t *entry = (fat12_raw_dir_entry_t *)(g_root_dir + i * FAT12_DIR_ENTRY_SIZE);
+            if (fat12_is_free_entry(entry)) {
+                if (out_owner_cluster) {
+                    *out_owner_cluster = 0;
+                }
                 if (out_entry_index) {
-                    *out_entry_index = (uint16_t)i;
+                    *out_entry_index = (uint32_t)i;
                 }
                 return FAT12_OK;
             }
@@ -541,9 +1675,9 @@ static int fat12_find_free_entry(uint16_t dir_cluster, uint16_t *out_owner_clust
         return FAT12_ERR_DIR_FULL;
     }
 
-    uint16_t cluster = dir_cluster;
-    uint16_t previous_cluster = 0;
-    while (cluster >= 2 && cluster < FAT12_CLUSTER_EOC) {
+    uint32_t cluster = dir_cluster;
+    uint32_t previous_cluster = 0;
+    while (fat12_cluster_valid(cluster)) {
         if (fat12_read_cluster(cluster, g_cluster_buffer) != 0) {
             return FAT12_ERR_IO;
         }
@@ -554,7 +1688,7 @@ static int fat12_find_free_entry(uint16_t dir_cluster, uint16_t *out_owner_clust
                     *out_owner_cluster = cluster;
                 }
                 if (out_entry_index) {
-                    *out_entry_index = (uint16_t)idx;
+                    *out_entry_index = (uint32_t)idx;
                 }
                 return FAT12_OK;
             }
@@ -563,14 +1697,10 @@ static int fat12_find_free_entry(uint16_t dir_cluster, uint16_t *out_owner_clust
         cluster = fat12_get_fat_entry(cluster);
     }
 
-    uint16_t new_cluster = fat12_allocate_cluster();
+    uint32_t new_cluster = fat12_grow_directory(previous_cluster);
     if (!new_cluster) {
         return FAT12_ERR_NO_FREE_CLUSTER;
     }
-    if (previous_cluster) {
-        fat12_set_fat_entry(previous_cluster, new_cluster);
-        fat12_set_fat_entry(new_cluster, FAT12_CLUSTER_EOC);
-    }
     if (out_owner_cluster) {
         *out_owner_cluster = new_cluster;
     }
@@ -604,7 +1734,23 @@ static int fat12_path_next(const char **path_ptr, char *component, int max_len)
 
 
 
-int fat12_init(uint32_t base_lba) {
+static void fat12_release_buffers(void) {
+    fat12_dir_index_release_all();
+    kfree(g_root_dir);
+    kfree(g_cluster_buffer);
+    kfree(g_cluster_bitmap);
+    g_root_dir = 0;
+    g_cluster_buffer = 0;
+    g_cluster_bitmap = 0;
+}
+
+/* With FAT12_MOUNT_LAZY only the boot sector is read here; the root
+ * directory and the free bitmap are loaded on first use */
+int fat12_mount(uint32_t base_lba, int flags) {
+    g_fs_ready = 0;
+    disk_stats_t mount_start;
+    disk_get_stats(&mount_start);
+
     uint8_t sector[SECTOR_SIZE];
     if (disk_read_sector(base_lba, sector) != 0) {
         return FAT12_ERR_IO;
@@ -615,24 +1761,25 @@ int fat12_init(uint32_t base_lba) {
         return FAT12_ERR_BAD_BPB;
     }
 
+    fat12_bpb32_t *bpb32 = (fat12_bpb32_t *)(sector + sizeof(fat12_bpb_t));
     g_fs.bytes_per_sector = bpb->bytes_per_sector;
     g_fs.sectors_per_cluster = bpb->sectors_per_cluster;
     g_fs.reserved_sectors = bpb->reserved_sectors;
     g_fs.num_fats = bpb->num_fats;
     g_fs.root_entry_count = bpb->root_entry_count;
-    g_fs.sectors_per_fat = bpb->sectors_per_fat_16;
+    g_fs.sectors_per_fat = (bpb->sectors_per_fat_16 != 0) ? bpb->sectors_per_fat_16 : bpb32->sectors_per_fat_32;
     g_fs.total_sectors = (bpb->total_sectors_16 != 0) ? bpb->total_sectors_16 : bpb->total_sectors_32;
     g_fs.base_lba = base_lba;
 
     if (g_fs.sectors_per_cluster == 0 || g_fs.sectors_per_cluster > FAT12_MAX_SECTORS_PER_CLUSTER) {
         return FAT12_ERR_NOT_FAT12;
     }
-    if (g_fs.sectors_per_fat == 0 || g_fs.sectors_per_fat > FAT12_MAX_FAT_SECTORS) {
+    if (g_fs.sectors_per_fat == 0 || g_fs.num_fats == 0) {
         return FAT12_ERR_NOT_FAT12;
     }
 
     g_fs.fat_size_bytes = g_fs.sectors_per_fat * SECTOR_SIZE;
-    g_fs.root_dir_sectors = (uint16_t)(((g_fs.root_entry_count * FAT12_DIR_ENTRY_SIZE) + (SECTOR_SIZE - 1)) / SECTOR_SIZE);
+    g_fs.root_dir_sectors = (uint32_t)(((g_fs.root_entry_count * FAT12_DIR_ENTRY_SIZE) + (SECTOR_SIZE - 1)) / SECTOR_SIZE);
     if (g_fs.root_dir_sectors > FAT12_MAX_ROOT_DIR_SECTORS) {
         return FAT12_ERR_NOT_FAT12;
     }
@@ -640,34 +1787,81 @@ int fat12_init(uint32_t base_lba) {
     g_fs.fat_start_lba = g_fs.reserved_sectors;
     g_fs.root_dir_start_lba = g_fs.fat_start_lba + (g_fs.num_fats * g_fs.sectors_per_fat);
     g_fs.data_start_lba = g_fs.root_dir_start_lba + g_fs.root_dir_sectors;
-    g_fs.total_data_sectors = g_fs.total_sectors - g_fs.reserved_sectors - (g_fs.num_fats * g_fs.sectors_per_fat) - g_fs.root_dir_sectors;
+    if (g_fs.data_start_lba >= g_fs.total_sectors) {
+        return FAT12_ERR_NOT_FAT12;
+    }
+    g_fs.total_data_sectors = g_fs.total_sectors - g_fs.data_start_lba;
     g_fs.total_clusters = g_fs.total_data_sectors / g_fs.sectors_per_cluster;
     g_fs.cluster_size_bytes = g_fs.sectors_per_cluster * SECTOR_SIZE;
 
-    if (g_fs.total_clusters < 1 || g_fs.total_clusters > 4084) {
+    if (g_fs.total_clusters < 1) {
         return FAT12_ERR_NOT_FAT12;
     }
 
-    for (uint16_t sector_index = 0; sector_index < g_fs.sectors_per_fat; sector_index++) {
-        uint32_t lba = base_lba + g_fs.fat_start_lba + sector_index;
-        if (disk_read_sector(lba, g_fat_primary + sector_index * SECTOR_SIZE) != 0) {
-            return FAT12_ERR_IO;
+    /* The FAT type follows from the cluster count alone */
+    g_fs.active_fat = 0;
+    g_fs.mirror_fats = 1;
+    g_fs.root_cluster = 0;
+    g_fs.fs_info_sector = 0;
+    if (g_fs.total_clusters <= FAT12_FAT12_MAX_CLUSTERS) {
+        g_fs.fat_type = 12;
+    } else if (g_fs.total_clusters <= FAT12_FAT16_MAX_CLUSTERS) {
+        g_fs.fat_type = 16;
+    } else {
+        g_fs.fat_type = 32;
+        if (g_fs.root_entry_count != 0 || bpb->sectors_per_fat_16 != 0) {
+            return FAT12_ERR_NOT_FAT12;
         }
-    }
-
-    if (g_fs.num_fats > 1) {
-        for (uint16_t sector_index = 0; sector_index < g_fs.sectors_per_fat; sector_index++) {
-            uint32_t lba = base_lba + g_fs.fat_start_lba + g_fs.sectors_per_fat + sector_index;
-            if (disk_read_sector(lba, g_fat_secondary + sector_index * SECTOR_SIZE) != 0) {
-                return FAT12_ERR_IO;
+        /* ext_flags bit 7 turns mirroring off; bits 0-3 pick the live FAT */
+        if (bpb32->ext_flags & 0x80) {
+            g_fs.mirror_fats = 0;
+            g_fs.active_fat = (uint8_t)(bpb32->ext_flags & 0x0F);
+            if (g_fs.active_fat >= g_fs.num_fats) {
+                return FAT12_ERR_NOT_FAT12;
             }
         }
+        g_fs.root_cluster = bpb32->root_cluster;
+        g_fs.fs_info_sector = bpb32->fs_info_sector;
     }
-
-    for (uint16_t sector_index = 0; sector_index < g_fs.root_dir_sectors; sector_index++) {
-        uint32_t lba = base_lba + g_fs.root_dir_start_lba + sector_index;
-        if (disk_read_sector(lba, g_root_dir + sector_index * SECTOR_SIZE) != 0) {
-            return FAT12_ERR_IO;
+    /* Each FAT must hold an entry for every cluster */
+    uint32_t fat_entries = (g_fs.fat_type == 12) ? (g_fs.fat_size_bytes / 3) * 2 : g_fs.fat_size_bytes / (g_fs.fat_type / 8);
+    if (g_fs.total_clusters + 2 > fat_entries) {
+        return FAT12_ERR_NOT_FAT12;
+    }
+    if (g_fs.fat_type == 32 && !fat12_cluster_valid(g_fs.root_cluster)) {
+        return FAT12_ERR_NOT_FAT12;
+    }
+    g_fs.bitmap_end = 2 + ((g_fs.total_clusters < FAT12_MAX_CLUSTERS) ? g_fs.total_clusters : FAT12_MAX_CLUSTERS);
+
+    /* Whatever the previous volume was using is dropped unflushed, as the
+     * rest of its state is below */
+    fat12_release_buffers();
+    g_cluster_buffer = (uint8_t *)kmalloc(g_fs.cluster_size_bytes);
+    g_cluster_bitmap = (uint32_t *)kmalloc(((g_fs.bitmap_end + 31) / 32) * sizeof(uint32_t));
+    if (g_fs.root_dir_sectors > 0) {
+        g_root_dir = (uint8_t *)kmalloc(g_fs.root_dir_sectors * SECTOR_SIZE);
+    }
+    if (!g_cluster_buffer || !g_cluster_bitmap || (g_fs.root_dir_sectors > 0 && !g_root_dir)) {
+        fat12_release_buffers();
+        return FAT12_ERR_NO_MEMORY;
+    }
+
+    /* FAT sectors are loaded on demand through the sector cache */
+    fat12_fat_cache_invalidate();
+    fat12_memset(g_open_files, 0, sizeof(g_open_files));
+    fat12_memset(g_dentry_cache, 0, sizeof(g_dentry_cache));
+    fat12_memset(g_root_dirty_sectors, 0, sizeof(g_root_dirty_sectors));
+    g_fsinfo_valid = 0;
+    g_bitmap_ready = 0;
+    g_root_loaded = 0;
+
+    if ((flags & FAT12_MOUNT_LAZY) == 0) {
+        int res = fat12_bitmap_ensure();
+        if (res == FAT12_OK) {
+            res = fat12_root_ensure();
+        }
+        if (res != FAT12_OK) {
+            return res;
         }
     }
 
@@ -676,12 +1870,18 @@ int fat12_init(uint32_t base_lba) {
     g_cwd[0] = '/';
     g_cwd[1] = '\0';
 
+    disk_stats_t mount_end;
+    disk_get_stats(&mount_end);
+    g_stats.mount_sector_reads = mount_end.read_sectors - mount_start.read_sectors;
+
     g_fs_ready = 1;
-    g_fat_dirty = 0;
-    g_root_dirty = 0;
     return FAT12_OK;
 }
 
+int fat12_init(uint32_t base_lba) {
+    return fat12_mount(base_lba, 0);
+}
+
 int fat12_iterate_current_directory(fat12_dir_iter_cb cb, void *context) {
     if (!g_fs_ready) {
         return FAT12_ERR_NOT_INITIALIZED;
@@ -689,7 +1889,7 @@ int fat12_iterate_current_directory(fat12_dir_iter_cb cb, void *context) {
     return fat12_iterate_directory_internal(g_current_dir_cluster, cb, context);
 }
 
-static int fat12_locate_directory(const char *path, uint16_t *out_cluster) {
+static int fat12_locate_directory(const char *path, uint32_t *out_cluster) {
     if (!path || !*path) {
         if (out_cluster) {
             *out_cluster = g_current_dir_cluster;
@@ -697,8 +1897,8 @@ static int fat12_locate_directory(const char *path, uint16_t *out_cluster) {
         return FAT12_OK;
     }
 
-    uint16_t cluster;
-    uint16_t temp_stack[FAT12_MAX_PATH_DEPTH];
+    uint32_t cluster;
+    uint32_t temp_stack[FAT12_MAX_PATH_DEPTH];
     int temp_depth;
 
     if (path[0] == '/' || path[0] == '\\') {
@@ -743,7 +1943,7 @@ static int fat12_locate_directory(const char *path, uint16_t *out_cluster) {
         if ((entry.attr & FAT12_ATTR_DIRECTORY) == 0) {
             return FAT12_ERR_NOT_DIRECTORY;
         }
-        cluster = entry.first_cluster_low;
+        cluster = fat12_entry_cluster(&entry);
         if (temp_depth < FAT12_MAX_PATH_DEPTH) {
             temp_stack[temp_depth++] = cluster;
         }
@@ -763,7 +1963,7 @@ int fat12_iterate_path(const char *path, fat12_dir_iter_cb cb, void *context) {
         return fat12_iterate_current_directory(cb, context);
     }
 
-    uint16_t cluster;
+    uint32_t cluster;
     int res = fat12_locate_directory(path, &cluster);
     if (res != FAT12_OK) {
         return res;
@@ -779,8 +1979,8 @@ int fat12_change_directory(const char *path) {
         return FAT12_OK;
     }
 
-    uint16_t new_cluster = (path[0] == '/' || path[0] == '\\') ? 0 : g_current_dir_cluster;
-    uint16_t temp_stack[FAT12_MAX_PATH_DEPTH];
+    uint32_t new_cluster = (path[0] == '/' || path[0] == '\\') ? 0 : g_current_dir_cluster;
+    uint32_t temp_stack[FAT12_MAX_PATH_DEPTH];
     char temp_names[FAT12_MAX_PATH_DEPTH][FAT12_MAX_DISPLAY_NAME];
     int temp_depth = (path[0] == '/' || path[0] == '\\') ? 0 : g_path_depth;
     for (int i = 0; i < temp_depth; i++) {
@@ -821,7 +2021,7 @@ int fat12_change_directory(const char *path) {
         if ((entry.attr & FAT12_ATTR_DIRECTORY) == 0) {
             return FAT12_ERR_NOT_DIRECTORY;
         }
-        new_cluster = entry.first_cluster_low;
+        new_cluster = fat12_entry_cluster(&entry);
         if (temp_depth < FAT12_MAX_PATH_DEPTH) {
             temp_stack[temp_depth] = new_cluster;
             fat12_dir_name_to_string(entry.name, temp_names[temp_depth]);
@@ -843,13 +2043,13 @@ const char *fat12_get_cwd(void) {
     return g_cwd;
 }
 
-static int fat12_resolve_parent_and_name(const char *path, uint16_t *out_dir_cluster, uint8_t short_name[11]) {
+static int fat12_resolve_parent_and_name(const char *path, uint32_t *out_dir_cluster, uint8_t short_name[11]) {
     if (!path || !*path) {
         return FAT12_ERR_INVALID_NAME;
     }
 
-    uint16_t cluster;
-    uint16_t temp_stack[FAT12_MAX_PATH_DEPTH];
+    uint32_t cluster;
+    uint32_t temp_stack[FAT12_MAX_PATH_DEPTH];
     int temp_depth;
 
     if (path[0] == '/' || path[0] == '\\') {
@@ -903,7 +2103,7 @@ static int fat12_resolve_parent_and_name(const char *path, uint16_t *out_dir_clu
         if ((entry.attr & FAT12_ATTR_DIRECTORY) == 0) {
             return FAT12_ERR_NOT_DIRECTORY;
         }
-        cluster = entry.first_cluster_low;
+        cluster = fat12_entry_cluster(&entry);
         if (temp_depth < FAT12_MAX_PATH_DEPTH) {
             temp_stack[temp_depth++] = cluster;
         }
@@ -927,6 +2127,41 @@ static int fat12_resolve_parent_and_name(const char *path, uint16_t *out_dir_clu
     return FAT12_OK;
 }
 
+int fat12_stat(const char *path, fat12_dir_entry_info_t *info) {
+    if (!g_fs_ready) {
+        return FAT12_ERR_NOT_INITIALIZED;
+    }
+    if (!path || !info) {
+        return FAT12_ERR_INVALID_NAME;
+    }
+    const char *cursor = path;
+    while (*cursor == '/' || *cursor == '\\') {
+        cursor++;
+    }
+    if (*cursor == '\0' && cursor != path) {
+        /* The root has no directory entry of its own */
+        info->name[0] = '/';
+        info->name[1] = '\0';
+        info->attr = FAT12_ATTR_DIRECTORY;
+        info->size = 0;
+        info->first_cluster = 0;
+        return FAT12_OK;
+    }
+    uint32_t dir_cluster;
+    uint8_t short_name[11];
+    int res = fat12_resolve_parent_and_name(path, &dir_cluster, short_name);
+    if (res != FAT12_OK) {
+        return res;
+    }
+    fat12_raw_dir_entry_t entry;
+    res = fat12_find_entry(dir_cluster, short_name, &entry, 0, 0);
+    if (res != FAT12_OK) {
+        return res;
+    }
+    fat12_copy_entry_info(&entry, info);
+    return FAT12_OK;
+}
+
 int fat12_read_file(const char *path, uint8_t *buffer, uint32_t max_size, uint32_t *out_size) {
     if (!g_fs_ready) {
         return FAT12_ERR_NOT_INITIALIZED;
@@ -935,7 +2170,7 @@ int fat12_read_file(const char *path, uint8_t *buffer, uint32_t max_size, uint32
         return FAT12_ERR_INVALID_NAME;
     }
 
-    uint16_t dir_cluster;
+    uint32_t dir_cluster;
     uint8_t short_name[11];
     int res = fat12_resolve_parent_and_name(path, &dir_cluster, short_name);
     if (res != FAT12_OK) {
@@ -955,22 +2190,33 @@ int fat12_read_file(const char *path, uint8_t *buffer, uint32_t max_size, uint32
         return FAT12_ERR_BUFFER_SMALL;
     }
 
-    uint32_t bytes_remaining = entry.file_size;
+    /* Whole clusters go straight into the caller's buffer, one device
+     * request per contiguous run; only the partial tail is bounced. */
+    uint32_t full_clusters = entry.file_size / g_fs.cluster_size_bytes;
+    uint32_t tail_bytes = entry.file_size % g_fs.cluster_size_bytes;
     uint32_t cursor = 0;
-    uint16_t cluster = entry.first_cluster_low;
+    uint32_t cluster = fat12_entry_cluster(&entry);
 
-    while (bytes_remaining > 0 && cluster >= 2 && cluster < FAT12_CLUSTER_EOC) {
-        if (fat12_read_cluster(cluster, g_cluster_buffer) != 0) {
+    while (full_clusters > 0 && fat12_cluster_valid(cluster)) {
+        uint32_t run_start = cluster;
+        uint32_t run_length = 0;
+        do {
+            run_length++;
+            cluster = fat12_get_fat_entry(cluster);
+        } while (run_length < full_clusters && cluster == (uint32_t)(run_start + run_length));
+
+        if (fat12_read_cluster_run(run_start, run_length, buffer + cursor) != FAT12_OK) {
             return FAT12_ERR_IO;
         }
-        uint32_t to_copy = g_fs.cluster_size_bytes;
-        if (to_copy > bytes_remaining) {
-            to_copy = bytes_remaining;
+        cursor += run_length * g_fs.cluster_size_bytes;
+        full_clusters -= run_length;
+    }
+
+    if (tail_bytes > 0 && fat12_cluster_valid(cluster)) {
+        if (fat12_read_cluster(cluster, g_cluster_buffer) != 0) {
+            return FAT12_ERR_IO;
         }
-        fat12_memcpy(buffer + cursor, g_cluster_buffer, to_copy);
-        cursor += to_copy;
-        bytes_remaining -= to_copy;
-        cluster = fat12_get_fat_entry(cluster);
+        fat12_memcpy(buffer + cursor, g_cluster_buffer, tail_bytes);
     }
 
     if (out_size) {
@@ -979,47 +2225,48 @@ int fat12_read_file(const char *path, uint8_t *buffer, uint32_t max_size, uint32
     return FAT12_OK;
 }
 
-static int fat12_write_directory_entry(uint16_t dir_cluster, const uint8_t short_name[11], const fat12_raw_dir_entry_t *entry_template) {
+static int fat12_write_directory_entry(uint32_t dir_cluster, const uint8_t short_name[11], const fat12_raw_dir_entry_t *entry_template) {
     fat12_raw_dir_entry_t entry;
-    uint16_t owner_cluster;
-    uint16_t entry_index;
+    uint32_t owner_cluster;
+    uint32_t entry_index;
     int res = fat12_find_entry(dir_cluster, short_name, &entry, &owner_cluster, &entry_index);
-    if (res == FAT12_OK) {
-        return fat12_write_entry(owner_cluster, entry_index, entry_template);
-    }
-    if (res != FAT12_ERR_NOT_FOUND) {
-        return res;
+    if (res == FAT12_ERR_NOT_FOUND) {
+        res = fat12_find_free_entry(dir_cluster, &owner_cluster, &entry_index);
     }
-    res = fat12_find_free_entry(dir_cluster, &owner_cluster, &entry_index);
     if (res != FAT12_OK) {
         return res;
     }
-    return fat12_write_entry(owner_cluster, entry_index, entry_template);
+    res = fat12_write_entry(owner_cluster, entry_index, entry_template);
+    if (res == FAT12_OK) {
+        fat12_dentry_store(dir_cluster, short_name, entry_template, owner_cluster, entry_index);
+    }
+    return res;
 }
 
-static int fat12_mark_entry_deleted(uint16_t dir_cluster, const uint8_t short_name[11]) {
+static int fat12_mark_entry_deleted(uint32_t dir_cluster, const uint8_t short_name[11]) {
     fat12_raw_dir_entry_t entry;
-    uint16_t owner_cluster;
-    uint16_t entry_index;
+    uint32_t owner_cluster;
+    uint32_t entry_index;
     int res = fat12_find_entry(dir_cluster, short_name, &entry, &owner_cluster, &entry_index);
     if (res != FAT12_OK) {
         return res;
     }
     entry.name[0] = 0xE5;
     entry.file_size = 0;
-    entry.first_cluster_low = 0;
-    return fat12_write_entry(owner_cluster, entry_index, &entry);
+    fat12_set_entry_cluster(&entry, 0);
+    res = fat12_write_entry(owner_cluster, entry_index, &entry);
+    if (res == FAT12_OK) {
+        fat12_dentry_store(dir_cluster, short_name, 0, 0, 0);
+    }
+    return res;
 }
 
-int fat12_write_file(const char *name, const uint8_t *data, uint32_t size) {
+int fat12_create_directory(const char *name) {
     if (!g_fs_ready) {
         return FAT12_ERR_NOT_INITIALIZED;
     }
-    if (!data && size > 0) {
-        return FAT12_ERR_INVALID_NAME;
-    }
 
-    uint16_t dir_cluster;
+    uint32_t dir_cluster;
     uint8_t short_name[11];
     int res = fat12_resolve_parent_and_name(name, &dir_cluster, short_name);
     if (res != FAT12_OK) {
@@ -1027,163 +2274,894 @@ int fat12_write_file(const char *name, const uint8_t *data, uint32_t size) {
     }
 
     fat12_raw_dir_entry_t existing;
-    uint16_t old_cluster = 0;
-    int has_existing = 0;
     res = fat12_find_entry(dir_cluster, short_name, &existing, 0, 0);
     if (res == FAT12_OK) {
-        if (existing.attr & FAT12_ATTR_DIRECTORY) {
-            return FAT12_ERR_ALREADY_EXISTS;
-        }
-        has_existing = 1;
-        old_cluster = existing.first_cluster_low;
-    } else if (res != FAT12_ERR_NOT_FOUND) {
-        return res;
+        return FAT12_ERR_ALREADY_EXISTS;
     }
 
-    uint16_t first_cluster = 0;
-    uint16_t prev_cluster = 0;
-    uint32_t bytes_written = 0;
+    /* The cluster is written once, already holding . and .. */
+    uint32_t new_cluster = 0;
+    if (fat12_allocate_extent(1, &new_cluster) == 0) {
+        return FAT12_ERR_NO_FREE_CLUSTER;
+    }
+    fat12_dentry_invalidate_dir(new_cluster);
+    fat12_dir_index_invalidate(new_cluster);
 
-    if (size > 0) {
-        while (bytes_written < size) {
-            uint16_t new_cluster = fat12_allocate_cluster();
-            if (!new_cluster) {
-                if (first_cluster >= 2) {
-                    fat12_free_chain(first_cluster);
-                }
-                return FAT12_ERR_NO_FREE_CLUSTER;
-            }
-            if (first_cluster == 0) {
-                first_cluster = new_cluster;
-            }
-            if (prev_cluster >= 2) {
-                fat12_set_fat_entry(prev_cluster, new_cluster);
-            }
-            fat12_set_fat_entry(new_cluster, FAT12_CLUSTER_EOC);
+    fat12_memset(g_cluster_buffer, 0, g_fs.cluster_size_bytes);
+    fat12_raw_dir_entry_t *dot = (fat12_raw_dir_entry_t *)g_cluster_buffer;
+    fat12_raw_dir_entry_t *dotdot = (fat12_raw_dir_entry_t *)(g_cluster_buffer + FAT12_DIR_ENTRY_SIZE);
 
-            uint32_t to_copy = g_fs.cluster_size_bytes;
-            if (to_copy > (size - bytes_written)) {
-                to_copy = size - bytes_written;
-            }
-            fat12_memset(g_cluster_buffer, 0, g_fs.cluster_size_bytes);
-            fat12_memcpy(g_cluster_buffer, data + bytes_written, to_copy);
-            if (fat12_write_cluster(new_cluster, g_cluster_buffer) != 0) {
-                fat12_free_chain(first_cluster);
-                return FAT12_ERR_IO;
-            }
-            bytes_written += to_copy;
-            prev_cluster = new_cluster;
-        }
+    uint8_t dot_name[11] = {' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' '};
+    dot_name[0] = '.';
+    fat12_fill_dir_entry(dot, dot_name, FAT12_ATTR_DIRECTORY, new_cluster, 0);
+
+    uint8_t dotdot_name[11] = {' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' '};
+    dotdot_name[0] = '.';
+    dotdot_name[1] = '.';
+    uint32_t parent_cluster = (dir_cluster == 0) ? 0 : dir_cluster;
+    fat12_fill_dir_entry(dotdot, dotdot_name, FAT12_ATTR_DIRECTORY, parent_cluster, 0);
+
+    if (fat12_write_cluster(new_cluster, g_cluster_buffer) != 0) {
+        fat12_free_chain(new_cluster);
+        return FAT12_ERR_IO;
     }
 
     fat12_raw_dir_entry_t new_entry;
-    fat12_fill_dir_entry(&new_entry, short_name, FAT12_ATTR_ARCHIVE, first_cluster, size);
+    fat12_fill_dir_entry(&new_entry, short_name, FAT12_ATTR_DIRECTORY, new_cluster, 0);
     res = fat12_write_directory_entry(dir_cluster, short_name, &new_entry);
     if (res != FAT12_OK) {
-        if (first_cluster >= 2) {
-            fat12_free_chain(first_cluster);
+        fat12_free_chain(new_cluster);
+        return res;
+    }
+
+    fat12_flush_root();
+    fat12_flush_fats();
+    return FAT12_OK;
+}
+
+/* Whether a handle is open on the entry; with `write_only`, only handles
+ * opened for writing count */
+static int fat12_entry_is_open(uint32_t dir_cluster, const uint8_t short_name[11], int write_only) {
+    for (int i = 0; i < FAT12_MAX_OPEN_FILES; i++) {
+        const fat12_open_file_t *file = &g_open_files[i];
+        if (!file->in_use || file->dir_cluster != dir_cluster) {
+            continue;
+        }
+        if (write_only && (file->flags & FAT12_OPEN_WRITE) == 0) {
+            continue;
+        }
+        if (fat12_memcmp(file->short_name, short_name, 11) == 0) {
+            return 1;
         }
+    }
+    return 0;
+}
+
+int fat12_delete_file(const char *name) {
+    if (!g_fs_ready) {
+        return FAT12_ERR_NOT_INITIALIZED;
+    }
+
+    uint32_t dir_cluster;
+    uint8_t short_name[11];
+    int res = fat12_resolve_parent_and_name(name, &dir_cluster, short_name);
+    if (res != FAT12_OK) {
         return res;
     }
 
-    if (has_existing && old_cluster >= 2 && old_cluster != first_cluster) {
-        fat12_free_chain(old_cluster);
+    fat12_raw_dir_entry_t entry;
+    res = fat12_find_entry(dir_cluster, short_name, &entry, 0, 0);
+    if (res != FAT12_OK) {
+        return res;
+    }
+    if (entry.attr & FAT12_ATTR_DIRECTORY) {
+        return FAT12_ERR_NOT_FILE;
+    }
+    /* Open handles would keep following the freed chain */
+    if (fat12_entry_is_open(dir_cluster, short_name, 0)) {
+        return FAT12_ERR_BUSY;
     }
 
+    if (fat12_entry_cluster(&entry) >= 2) {
+        fat12_free_chain(fat12_entry_cluster(&entry));
+    }
+
+    res = fat12_mark_entry_deleted(dir_cluster, short_name);
+    if (res != FAT12_OK) {
+        return res;
+    }
     fat12_flush_root();
     fat12_flush_fats();
     return FAT12_OK;
 }
 
-int fat12_create_directory(const char *name) {
+static fat12_open_file_t *fat12_get_handle(int handle) {
+    if (!g_fs_ready || handle < 0 || handle >= FAT12_MAX_OPEN_FILES) {
+        return 0;
+    }
+    if (!g_open_files[handle].in_use) {
+        return 0;
+    }
+    return &g_open_files[handle];
+}
+
+/* Cluster `index` of the file's chain (0 past the end). Walks forward from
+ * the cached position when possible. */
+static uint32_t fat12_file_cluster_at(fat12_open_file_t *file, uint32_t index) {
+    uint32_t cluster = file->first_cluster;
+    uint32_t current = 0;
+    if (file->cluster >= 2 && index >= file->cluster_index) {
+        cluster = file->cluster;
+        current = file->cluster_index;
+    }
+    while (current < index && fat12_cluster_valid(cluster)) {
+        cluster = fat12_get_fat_entry(cluster);
+        current++;
+        g_stats.chain_walk_steps++;
+    }
+    if (!fat12_cluster_valid(cluster)) {
+        return 0;
+    }
+    file->cluster = cluster;
+    file->cluster_index = index;
+    return cluster;
+}
+
+/* Number of clusters (at most `limit`) physically following `cluster` in
+ * its chain, including `cluster` itself */
+static uint32_t fat12_contiguous_run(uint32_t cluster, uint32_t limit) {
+    uint32_t run = 1;
+    uint32_t next = cluster;
+    while (run < limit) {
+        next = fat12_get_fat_entry(next);
+        g_stats.chain_walk_steps++;
+        if (next != (uint32_t)(cluster + run)) {
+            break;
+        }
+        run++;
+    }
+    return run;
+}
+
+/* Walk the chain once and record it as runs of contiguous clusters */
+static void fat12_file_build_map(fat12_open_file_t *file) {
+    uint32_t cluster = file->first_cluster;
+    uint32_t index = 0;
+    file->extent_count = 0;
+    while (index < file->cluster_count && fat12_cluster_valid(cluster)) {
+        fat12_extent_t *last = file->extent_count ? &file->extents[file->extent_count - 1] : 0;
+        if (last && cluster == (uint32_t)(last->disk_cluster + last->length)) {
+            last->length++;
+        } else {
+            if (file->extent_count == FAT12_MAX_FILE_EXTENTS) {
+                break;
+            }
+            fat12_extent_t *extent = &file->extents[file->extent_count++];
+            extent->file_cluster = index;
+            extent->disk_cluster = cluster;
+            extent->length = 1;
+        }
+        file->cluster = cluster;
+        file->cluster_index = index;
+        index++;
+        cluster = fat12_get_fat_entry(cluster);
+        g_stats.chain_walk_steps++;
+    }
+    file->mapped_clusters = index;
+    file->map_valid = 1;
+    g_stats.extent_map_builds++;
+}
+
+/* Record a freshly allocated extent at the end of the chain */
+static void fat12_file_map_append(fat12_open_file_t *file, uint32_t disk_cluster, uint32_t length) {
+    if (!file->map_valid || file->mapped_clusters != file->cluster_count) {
+        return;
+    }
+    fat12_extent_t *last = file->extent_count ? &file->extents[file->extent_count - 1] : 0;
+    if (last && disk_cluster == (uint32_t)(last->disk_cluster + last->length)) {
+        last->length = (uint32_t)(last->length + length);
+    } else {
+        if (file->extent_count == FAT12_MAX_FILE_EXTENTS) {
+            return;
+        }
+        fat12_extent_t *extent = &file->extents[file->extent_count++];
+        extent->file_cluster = file->cluster_count;
+        extent->disk_cluster = disk_cluster;
+        extent->length = (uint32_t)length;
+    }
+    file->mapped_clusters += length;
+}
+
+/* Disk cluster holding chain position `index` (0 past the end), plus how
+ * many clusters from there on are contiguous on disk, capped at `limit`.
+ * Mapped positions cost a binary search and no FAT reads. */
+static uint32_t fat12_file_lookup(fat12_open_file_t *file, uint32_t index, uint32_t limit, uint32_t *out_run) {
+    if (!file->map_valid) {
+        fat12_file_build_map(file);
+    }
+    if (index < file->mapped_clusters) {
+        uint32_t low = 0;
+        uint32_t high = file->extent_count - 1;
+        while (low < high) {
+            uint32_t mid = (low + high + 1) / 2;
+            if (file->extents[mid].file_cluster <= index) {
+                low = mid;
+            } else {
+                high = mid - 1;
+            }
+        }
+        const fat12_extent_t *extent = &file->extents[low];
+        uint32_t delta = index - extent->file_cluster;
+        if (out_run) {
+            uint32_t run = extent->length - delta;
+            *out_run = (run < limit) ? run : limit;
+        }
+        return (uint32_t)(extent->disk_cluster + delta);
+    }
+
+    /* Resume the walk from the end of the mapped prefix rather than the
+     * start of the chain */
+    if (file->mapped_clusters > 0 && (file->cluster < 2 || file->cluster_index > index)) {
+        const fat12_extent_t *last = &file->extents[file->extent_count - 1];
+        file->cluster = (uint32_t)(last->disk_cluster + last->length - 1);
+        file->cluster_index = file->mapped_clusters - 1;
+    }
+    uint32_t cluster = fat12_file_cluster_at(file, index);
+    if (cluster && out_run) {
+        *out_run = fat12_contiguous_run(cluster, limit);
+    }
+    return cluster;
+}
+
+/* Grow the file's chain to `count` clusters, in as few extents as possible */
+static int fat12_file_extend(fat12_open_file_t *file, uint32_t count) {
+    if (count <= file->cluster_count) {
+        return FAT12_OK;
+    }
+    int res = fat12_bitmap_ensure();
+    if (res != FAT12_OK) {
+        return res;
+    }
+    if (count - file->cluster_count > g_free_clusters) {
+        return FAT12_ERR_NO_FREE_CLUSTER;
+    }
+    uint32_t tail = 0;
+    if (file->cluster_count > 0) {
+        tail = fat12_file_lookup(file, file->cluster_count - 1, 1, 0);
+        if (!tail) {
+            return FAT12_ERR_IO;
+        }
+    }
+    while (file->cluster_count < count) {
+        uint32_t extent_start = 0;
+        uint32_t extent_length = fat12_allocate_extent(count - file->cluster_count, &extent_start);
+        if (extent_length == 0) {
+            return FAT12_ERR_NO_FREE_CLUSTER;
+        }
+        if (tail >= 2) {
+            fat12_set_fat_entry(tail, extent_start);
+        } else {
+            file->first_cluster = extent_start;
+            file->entry_dirty = 1;
+        }
+        fat12_file_map_append(file, extent_start, extent_length);
+        tail = (uint32_t)(extent_start + extent_length - 1);
+        file->cluster_count += extent_length;
+    }
+    return FAT12_OK;
+}
+
+/* Shrink the file's chain to `count` clusters, freeing the tail */
+static int fat12_file_trim(fat12_open_file_t *file, uint32_t count) {
+    if (count >= file->cluster_count) {
+        return FAT12_OK;
+    }
+    uint32_t first = file->first_cluster;
+    if (count == 0) {
+        fat12_free_chain(first);
+        file->first_cluster = 0;
+        file->entry_dirty = 1;
+    } else {
+        uint32_t tail = fat12_file_lookup(file, count - 1, 1, 0);
+        if (!tail) {
+            return FAT12_ERR_IO;
+        }
+        uint32_t rest = fat12_get_fat_entry(tail);
+        fat12_set_fat_entry(tail, FAT12_CLUSTER_EOC);
+        fat12_free_chain(rest);
+    }
+    file->cluster_count = count;
+    /* The map is rebuilt on demand; no other handle is open on the file */
+    file->map_valid = 0;
+    file->cluster = 0;
+    return FAT12_OK;
+}
+
+int fat12_open(const char *path, int flags) {
     if (!g_fs_ready) {
         return FAT12_ERR_NOT_INITIALIZED;
     }
+    if (flags & (FAT12_OPEN_CREATE | FAT12_OPEN_TRUNCATE | FAT12_OPEN_APPEND)) {
+        flags |= FAT12_OPEN_WRITE;
+    }
+    if ((flags & (FAT12_OPEN_READ | FAT12_OPEN_WRITE)) == 0) {
+        flags |= FAT12_OPEN_READ;
+    }
 
-    uint16_t dir_cluster;
+    int handle = -1;
+    for (int i = 0; i < FAT12_MAX_OPEN_FILES; i++) {
+        if (!g_open_files[i].in_use) {
+            handle = i;
+            break;
+        }
+    }
+    if (handle < 0) {
+        return FAT12_ERR_TOO_MANY_OPEN;
+    }
+
+    uint32_t dir_cluster;
     uint8_t short_name[11];
-    int res = fat12_resolve_parent_and_name(name, &dir_cluster, short_name);
+    int res = fat12_resolve_parent_and_name(path, &dir_cluster, short_name);
     if (res != FAT12_OK) {
         return res;
     }
+    /* Handles cache the chain and its length, so only one may change it,
+     * and a rewrite from the start needs the file to itself */
+    if ((flags & (FAT12_OPEN_TRUNCATE | FAT12_OPEN_EXCLUSIVE)) &&
+        fat12_entry_is_open(dir_cluster, short_name, 0)) {
+        return FAT12_ERR_BUSY;
+    }
+    if ((flags & FAT12_OPEN_WRITE) && fat12_entry_is_open(dir_cluster, short_name, 1)) {
+        return FAT12_ERR_BUSY;
+    }
 
-    fat12_raw_dir_entry_t existing;
-    res = fat12_find_entry(dir_cluster, short_name, &existing, 0, 0);
-    if (res == FAT12_OK) {
-        return FAT12_ERR_ALREADY_EXISTS;
+    fat12_raw_dir_entry_t entry;
+    res = fat12_find_entry(dir_cluster, short_name, &entry, 0, 0);
+    if (res == FAT12_ERR_NOT_FOUND && (flags & FAT12_OPEN_CREATE)) {
+        fat12_fill_dir_entry(&entry, short_name, FAT12_ATTR_ARCHIVE, 0, 0);
+        res = fat12_write_directory_entry(dir_cluster, short_name, &entry);
+    }
+    if (res != FAT12_OK) {
+        return res;
+    }
+    if (entry.attr & FAT12_ATTR_DIRECTORY) {
+        return FAT12_ERR_NOT_FILE;
     }
 
-    uint16_t new_cluster = fat12_allocate_cluster();
-    if (!new_cluster) {
-        return FAT12_ERR_NO_FREE_CLUSTER;
+    fat12_open_file_t *file = &g_open_files[handle];
+    fat12_memset(file, 0, sizeof(*file));
+    file->flags = (uint8_t)flags;
+    file->dir_cluster = dir_cluster;
+    fat12_memcpy(file->short_name, short_name, 11);
+    file->first_cluster = fat12_entry_cluster(&entry);
+    file->size = entry.file_size;
+    file->cluster_count = (entry.file_size + g_fs.cluster_size_bytes - 1) / g_fs.cluster_size_bytes;
+
+    if ((flags & FAT12_OPEN_TRUNCATE) && file->first_cluster >= 2) {
+        fat12_free_chain(file->first_cluster);
+        file->first_cluster = 0;
+        file->cluster_count = 0;
+        file->size = 0;
+        file->entry_dirty = 1;
     }
 
-    fat12_memset(g_cluster_buffer, 0, g_fs.cluster_size_bytes);
-    fat12_raw_dir_entry_t *dot = (fat12_raw_dir_entry_t *)g_cluster_buffer;
-    fat12_raw_dir_entry_t *dotdot = (fat12_raw_dir_entry_t *)(g_cluster_buffer + FAT12_DIR_ENTRY_SIZE);
+    file->in_use = 1;
+    return handle;
+}
 
-    uint8_t dot_name[11] = {' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' '};
-    dot_name[0] = '.';
-    fat12_fill_dir_entry(dot, dot_name, FAT12_ATTR_DIRECTORY, new_cluster, 0);
+int fat12_read(int handle, uint8_t *buffer, uint32_t length, uint32_t *out_read) {
+    fat12_open_file_t *file = fat12_get_handle(handle);
+    if (!file || (file->flags & FAT12_OPEN_READ) == 0) {
+        return FAT12_ERR_BAD_HANDLE;
+    }
+    if (out_read) {
+        *out_read = 0;
+    }
+    if (!buffer) {
+        return FAT12_ERR_INVALID_NAME;
+    }
+    if (length > file->size - file->position) {
+        length = file->size - file->position;
+    }
 
-    uint8_t dotdot_name[11] = {' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' '};
-    dotdot_name[0] = '.';
-    dotdot_name[1] = '.';
-    uint16_t parent_cluster = (dir_cluster == 0) ? 0 : dir_cluster;
-    fat12_fill_dir_entry(dotdot, dotdot_name, FAT12_ATTR_DIRECTORY, parent_cluster, 0);
+    uint32_t done = 0;
+    while (done < length) {
+        uint32_t index = file->position / g_fs.cluster_size_bytes;
+        uint32_t offset = file->position % g_fs.cluster_size_bytes;
+        uint32_t chunk;
+        uint32_t remaining = length - done;
+        uint32_t whole = (offset == 0) ? remaining / g_fs.cluster_size_bytes : 0;
+        uint32_t run = 0;
+        uint32_t cluster = fat12_file_lookup(file, index, whole ? whole : 1, &run);
+        if (!cluster) {
+            return FAT12_ERR_IO;
+        }
 
-    if (fat12_write_cluster(new_cluster, g_cluster_buffer) != 0) {
-        fat12_free_chain(new_cluster);
-        return FAT12_ERR_IO;
+        if (whole > 0) {
+            /* Whole clusters go straight into the caller's buffer */
+            if (fat12_read_cluster_run(cluster, run, buffer + done) != FAT12_OK) {
+                return FAT12_ERR_IO;
+            }
+            chunk = run * g_fs.cluster_size_bytes;
+        } else {
+            chunk = g_fs.cluster_size_bytes - offset;
+            if (chunk > remaining) {
+                chunk = remaining;
+            }
+            if (fat12_read_cluster(cluster, g_cluster_buffer) != 0) {
+                return FAT12_ERR_IO;
+            }
+            fat12_memcpy(buffer + done, g_cluster_buffer + offset, chunk);
+        }
+
+        done += chunk;
+        file->position += chunk;
+        if (out_read) {
+            *out_read = done;
+        }
     }
+    return FAT12_OK;
+}
 
-    fat12_raw_dir_entry_t new_entry;
-    fat12_fill_dir_entry(&new_entry, short_name, FAT12_ATTR_DIRECTORY, new_cluster, 0);
-    res = fat12_write_directory_entry(dir_cluster, short_name, &new_entry);
+int fat12_write(int handle, const uint8_t *data, uint32_t length, uint32_t *out_written) {
+    fat12_open_file_t *file = fat12_get_handle(handle);
+    if (!file || (file->flags & FAT12_OPEN_WRITE) == 0) {
+        return FAT12_ERR_BAD_HANDLE;
+    }
+    if (out_written) {
+        *out_written = 0;
+    }
+    if (!data && length > 0) {
+        return FAT12_ERR_INVALID_NAME;
+    }
+    if (file->flags & FAT12_OPEN_APPEND) {
+        file->position = file->size;
+    }
+    if (file->position + length < file->position) {
+        return FAT12_ERR_OUT_OF_RANGE;
+    }
+
+    uint32_t end = file->position + length;
+    int res = fat12_file_extend(file, (end + g_fs.cluster_size_bytes - 1) / g_fs.cluster_size_bytes);
     if (res != FAT12_OK) {
-        fat12_free_chain(new_cluster);
         return res;
     }
 
-    fat12_flush_root();
-    fat12_flush_fats();
+    uint32_t done = 0;
+    while (done < length) {
+        uint32_t index = file->position / g_fs.cluster_size_bytes;
+        uint32_t offset = file->position % g_fs.cluster_size_bytes;
+        uint32_t chunk;
+        uint32_t remaining = length - done;
+        uint32_t whole = (offset == 0) ? remaining / g_fs.cluster_size_bytes : 0;
+        uint32_t run = 0;
+        uint32_t cluster = fat12_file_lookup(file, index, whole ? whole : 1, &run);
+        if (!cluster) {
+            return FAT12_ERR_IO;
+        }
+
+        if (whole > 0) {
+            if (fat12_write_cluster_run(cluster, run, data + done) != FAT12_OK) {
+                return FAT12_ERR_IO;
+            }
+            chunk = run * g_fs.cluster_size_bytes;
+        } else {
+            chunk = g_fs.cluster_size_bytes - offset;
+            if (chunk > remaining) {
+                chunk = remaining;
+            }
+            /* Only read back the cluster when it holds bytes we keep */
+            if (offset > 0 || file->position + chunk < file->size) {
+                if (fat12_read_cluster(cluster, g_cluster_buffer) != 0) {
+                    return FAT12_ERR_IO;
+                }
+            } else {
+                fat12_memset(g_cluster_buffer + chunk, 0, g_fs.cluster_size_bytes - chunk);
+            }
+            fat12_memcpy(g_cluster_buffer + offset, data + done, chunk);
+            if (fat12_write_cluster(cluster, g_cluster_buffer) != 0) {
+                return FAT12_ERR_IO;
+            }
+        }
+
+        done += chunk;
+        file->position += chunk;
+        if (file->position > file->size) {
+            file->size = file->position;
+            file->entry_dirty = 1;
+        }
+        if (out_written) {
+            *out_written = done;
+        }
+    }
     return FAT12_OK;
 }
 
-int fat12_delete_file(const char *name) {
+int fat12_seek(int handle, int offset, int whence, uint32_t *out_position) {
+    fat12_open_file_t *file = fat12_get_handle(handle);
+    if (!file) {
+        return FAT12_ERR_BAD_HANDLE;
+    }
+
+    uint32_t base;
+    switch (whence) {
+        case FAT12_SEEK_SET: base = 0; break;
+        case FAT12_SEEK_CUR: base = file->position; break;
+        case FAT12_SEEK_END: base = file->size; break;
+        default: return FAT12_ERR_OUT_OF_RANGE;
+    }
+
+    uint32_t target;
+    if (offset < 0) {
+        uint32_t back = (uint32_t)0 - (uint32_t)offset;
+        if (back > base) {
+            return FAT12_ERR_OUT_OF_RANGE;
+        }
+        target = base - back;
+    } else {
+        target = base + (uint32_t)offset;
+        if (target < base || target > file->size) {
+            return FAT12_ERR_OUT_OF_RANGE;
+        }
+    }
+
+    file->position = target;
+    if (out_position) {
+        *out_position = target;
+    }
+    return FAT12_OK;
+}
+
+int fat12_close(int handle) {
+    fat12_open_file_t *file = fat12_get_handle(handle);
+    if (!file) {
+        return FAT12_ERR_BAD_HANDLE;
+    }
+
+    int res = FAT12_OK;
+    if (file->entry_dirty) {
+        fat12_raw_dir_entry_t entry;
+        uint32_t owner_cluster;
+        uint32_t entry_index;
+        res = fat12_find_entry(file->dir_cluster, file->short_name, &entry, &owner_cluster, &entry_index);
+        if (res == FAT12_OK) {
+            fat12_set_entry_cluster(&entry, file->first_cluster);
+            entry.file_size = file->size;
+            res = fat12_write_entry(owner_cluster, entry_index, &entry);
+            if (res == FAT12_OK) {
+                fat12_dentry_store(file->dir_cluster, file->short_name, &entry, owner_cluster, entry_index);
+            }
+        }
+    }
+    if (file->flags & FAT12_OPEN_WRITE) {
+        fat12_flush_root();
+        fat12_flush_fats();
+    }
+
+    file->in_use = 0;
+    return res;
+}
+
+/* Rewrites the file in place: the existing chain is overwritten from the
+ * start, grown at the tail or trimmed, and the entry is written once */
+int fat12_write_file(const char *name, const uint8_t *data, uint32_t size) {
     if (!g_fs_ready) {
         return FAT12_ERR_NOT_INITIALIZED;
     }
+    if (!data && size > 0) {
+        return FAT12_ERR_INVALID_NAME;
+    }
+
+    int handle = fat12_open(name, FAT12_OPEN_WRITE | FAT12_OPEN_CREATE | FAT12_OPEN_EXCLUSIVE);
+    if (handle == FAT12_ERR_NOT_FILE) {
+        return FAT12_ERR_ALREADY_EXISTS;
+    }
+    if (handle < 0) {
+        return handle;
+    }
+    fat12_open_file_t *file = &g_open_files[handle];
+
+    /* Old contents are dead, so partial clusters need no read-back */
+    uint32_t needed = (size + g_fs.cluster_size_bytes - 1) / g_fs.cluster_size_bytes;
+    if (needed > file->cluster_count && fat12_bitmap_ensure() != FAT12_OK) {
+        fat12_close(handle);
+        return FAT12_ERR_IO;
+    }
+    if (needed > file->cluster_count && needed - file->cluster_count > g_free_clusters) {
+        fat12_close(handle);
+        return FAT12_ERR_NO_FREE_CLUSTER;
+    }
+    if (file->size != size) {
+        file->entry_dirty = 1;
+    }
+    file->size = 0;
 
-    uint16_t dir_cluster;
+    int res = fat12_write(handle, data, size, 0);
+    if (res == FAT12_OK) {
+        res = fat12_file_trim(file, needed);
+    }
+    int close_res = fat12_close(handle);
+    return (res != FAT12_OK) ? res : close_res;
+}
+
+/* Defragmentation */
+
+static int fat12_chain_layout(uint32_t first_cluster, fat12_frag_info_t *info) {
+    fat12_memset(info, 0, sizeof(*info));
+    uint32_t cluster = first_cluster;
+    uint32_t previous = 0;
+    uint32_t run = 0;
+    while (fat12_cluster_valid(cluster)) {
+        if (run > 0 && cluster == previous + 1) {
+            run++;
+        } else {
+            info->extents++;
+            run = 1;
+        }
+        if (run > info->largest_run) {
+            info->largest_run = run;
+        }
+        /* A chain longer than the volume has a loop in it */
+        if (++info->clusters > g_fs.total_clusters) {
+            return FAT12_ERR_IO;
+        }
+        previous = cluster;
+        cluster = fat12_get_fat_entry(cluster);
+    }
+    return FAT12_OK;
+}
+
+int fat12_get_fragmentation(const char *path, fat12_frag_info_t *info) {
+    if (!g_fs_ready) {
+        return FAT12_ERR_NOT_INITIALIZED;
+    }
+    if (!info) {
+        return FAT12_ERR_INVALID_NAME;
+    }
+    uint32_t dir_cluster;
     uint8_t short_name[11];
-    int res = fat12_resolve_parent_and_name(name, &dir_cluster, short_name);
+    int res = fat12_resolve_parent_and_name(path, &dir_cluster, short_name);
     if (res != FAT12_OK) {
         return res;
     }
-
     fat12_raw_dir_entry_t entry;
     res = fat12_find_entry(dir_cluster, short_name, &entry, 0, 0);
     if (res != FAT12_OK) {
         return res;
     }
+    return fat12_chain_layout(fat12_entry_cluster(&entry), info);
+}
+
+/* Move one file's chain into a single free run. The order keeps the file
+ * readable at every step: the new chain is written and its FAT entries
+ * flushed before the directory entry points at it, and the old chain is
+ * released only after the entry is on disk. A crash leaves at worst lost
+ * clusters, never a damaged file. */
+static int fat12_defrag_entry(uint32_t dir_cluster, const uint8_t short_name[11], fat12_defrag_stats_t *stats) {
+    fat12_raw_dir_entry_t entry;
+    uint32_t owner_cluster;
+    uint32_t entry_index;
+    int res = fat12_find_entry(dir_cluster, short_name, &entry, &owner_cluster, &entry_index);
+    if (res != FAT12_OK) {
+        return res;
+    }
     if (entry.attr & FAT12_ATTR_DIRECTORY) {
         return FAT12_ERR_NOT_FILE;
     }
+    stats->files_checked++;
 
-    if (entry.first_cluster_low >= 2) {
-        fat12_free_chain(entry.first_cluster_low);
+    uint32_t old_first = fat12_entry_cluster(&entry);
+    fat12_frag_info_t layout;
+    res = fat12_chain_layout(old_first, &layout);
+    if (res != FAT12_OK) {
+        return res;
+    }
+    if (layout.extents <= 1) {
+        return FAT12_OK;
+    }
+    if (fat12_entry_is_open(dir_cluster, short_name, 0)) {
+        stats->files_skipped++;
+        return FAT12_OK;
+    }
+    res = fat12_bitmap_ensure();
+    if (res != FAT12_OK) {
+        return res;
+    }
+    uint32_t count = layout.clusters;
+    uint32_t new_first = 0;
+    uint32_t run_length = 0;
+    if (!fat12_bitmap_find_run(2, g_fs.bitmap_end, count, &new_first, &run_length)) {
+        stats->files_skipped++;
+        return FAT12_OK;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t cluster = new_first + i;
+        fat12_set_fat_entry(cluster, (i + 1 < count) ? cluster + 1 : FAT12_CLUSTER_EOC);
+    }
+
+    /* Copy run by run, as many clusters per request as the buffer holds; if
+     * the heap cannot spare a transfer buffer, go one cluster at a time */
+    uint8_t *transfer = (uint8_t *)kmalloc(FAT12_MAX_SECTORS_PER_CLUSTER * SECTOR_SIZE);
+    uint32_t per_transfer = FAT12_MAX_SECTORS_PER_CLUSTER / g_fs.sectors_per_cluster;
+    if (!transfer) {
+        transfer = g_cluster_buffer;
+        per_transfer = 1;
+    }
+    uint32_t source = old_first;
+    uint32_t copied = 0;
+    while (copied < count) {
+        uint32_t limit = count - copied;
+        if (limit > per_transfer) {
+            limit = per_transfer;
+        }
+        uint32_t run = fat12_contiguous_run(source, limit);
+        if (fat12_read_cluster_run(source, run, transfer) != FAT12_OK ||
+            fat12_write_cluster_run(new_first + copied, run, transfer) != FAT12_OK) {
+            if (transfer != g_cluster_buffer) {
+                kfree(transfer);
+            }
+            fat12_free_chain(new_first);
+            return FAT12_ERR_IO;
+        }
+        copied += run;
+        source = fat12_get_fat_entry(source + run - 1);
+    }
+    if (transfer != g_cluster_buffer) {
+        kfree(transfer);
     }
 
-    res = fat12_mark_entry_deleted(dir_cluster, short_name);
+    res = fat12_flush_fats();
     if (res != FAT12_OK) {
         return res;
     }
-    fat12_flush_root();
-    fat12_flush_fats();
+    fat12_set_entry_cluster(&entry, new_first);
+    res = fat12_write_entry(owner_cluster, entry_index, &entry);
+    if (res == FAT12_OK) {
+        res = fat12_flush_root();
+    }
+    if (res != FAT12_OK) {
+        return res;
+    }
+    fat12_dentry_store(dir_cluster, short_name, &entry, owner_cluster, entry_index);
+
+    fat12_free_chain(old_first);
+    res = fat12_flush_fats();
+    if (res != FAT12_OK) {
+        return res;
+    }
+    stats->files_moved++;
+    stats->clusters_moved += count;
+    return FAT12_OK;
+}
+
+/* Names are gathered a batch at a time because moving a file reuses the
+ * cluster buffer the directory walk reads into */
+typedef struct {
+    uint32_t skip;
+    uint32_t consumed;
+    uint32_t count;
+    uint8_t full;
+    uint8_t names[FAT12_DEFRAG_BATCH][11];
+    uint8_t is_dir[FAT12_DEFRAG_BATCH];
+    uint32_t clusters[FAT12_DEFRAG_BATCH];
+} fat12_defrag_batch_t;
+
+static int fat12_defrag_collect(const fat12_dir_entry_info_t *info, void *context) {
+    fat12_defrag_batch_t *batch = (fat12_defrag_batch_t *)context;
+    if (batch->skip > 0) {
+        batch->skip--;
+        return 0;
+    }
+    if (batch->count == FAT12_DEFRAG_BATCH) {
+        batch->full = 1;
+        return 1;
+    }
+    batch->consumed++;
+    if (fat12_make_short_name(info->name, batch->names[batch->count]) != FAT12_OK) {
+        return 0;
+    }
+    batch->is_dir[batch->count] = (info->attr & FAT12_ATTR_DIRECTORY) ? 1 : 0;
+    batch->clusters[batch->count] = info->first_cluster;
+    batch->count++;
+    return 0;
+}
+
+static int fat12_defrag_directory(uint32_t dir_cluster, uint32_t depth, fat12_defrag_stats_t *stats) {
+    fat12_defrag_batch_t batch;
+    uint32_t position = 0;
+    for (;;) {
+        batch.skip = position;
+        batch.consumed = 0;
+        batch.count = 0;
+        batch.full = 0;
+        int res = fat12_iterate_directory_internal(dir_cluster, fat12_defrag_collect, &batch);
+        if (res != FAT12_OK) {
+            return res;
+        }
+        for (uint32_t i = 0; i < batch.count; i++) {
+            if (batch.is_dir[i]) {
+                if (depth + 1 < FAT12_MAX_PATH_DEPTH && fat12_cluster_valid(batch.clusters[i])) {
+                    res = fat12_defrag_directory(batch.clusters[i], depth + 1, stats);
+                }
+            } else {
+                res = fat12_defrag_entry(dir_cluster, batch.names[i], stats);
+            }
+            if (res != FAT12_OK) {
+                return res;
+            }
+        }
+        if (!batch.full) {
+            return FAT12_OK;
+        }
+        position += batch.consumed;
+    }
+}
+
+int fat12_defragment(const char *path, fat12_defrag_stats_t *stats) {
+    if (!g_fs_ready) {
+        return FAT12_ERR_NOT_INITIALIZED;
+    }
+    fat12_defrag_stats_t local;
+    if (!stats) {
+        stats = &local;
+    }
+    fat12_memset(stats, 0, sizeof(*stats));
+    if (!path || !*path) {
+        return fat12_defrag_directory(0, 0, stats);
+    }
+    uint32_t dir_cluster;
+    uint8_t short_name[11];
+    int res = fat12_resolve_parent_and_name(path, &dir_cluster, short_name);
+    if (res != FAT12_OK) {
+        return res;
+    }
+    return fat12_defrag_entry(dir_cluster, short_name, stats);
+}
+
+int fat12_get_space(fat12_space_info_t *info) {
+    if (!g_fs_ready) {
+        return FAT12_ERR_NOT_INITIALIZED;
+    }
+    int res = fat12_bitmap_ensure();
+    if (res != FAT12_OK) {
+        return res;
+    }
+    if (info) {
+        info->total_clusters = g_fs.total_clusters;
+        info->free_clusters = g_free_clusters;
+        info->cluster_size = g_fs.cluster_size_bytes;
+        info->fat_type = g_fs.fat_type;
+    }
     return FAT12_OK;
 }
 
+void fat12_get_stats(fat12_stats_t *stats) {
+    if (stats) {
+        *stats = g_stats;
+    }
+}
+
+void fat12_get_footprint(uint32_t *static_bytes, uint32_t *heap_bytes) {
+    *static_bytes = sizeof(g_fs) + sizeof(g_fat_cache) + sizeof(g_fat_flush_buffer) + sizeof(g_stats) +
+                    sizeof(g_fsinfo) + sizeof(g_open_files) + sizeof(g_dentry_cache) + sizeof(g_dir_index) +
+                    sizeof(g_root_dirty_sectors) + sizeof(g_path_stack) + sizeof(g_path_names) + sizeof(g_cwd);
+    *heap_bytes = 0;
+    if (g_root_dir) {
+        *heap_bytes += g_fs.root_dir_sectors * SECTOR_SIZE;
+    }
+    if (g_cluster_buffer) {
+        *heap_bytes += g_fs.cluster_size_bytes;
+    }
+    if (g_cluster_bitmap) {
+        *heap_bytes += ((g_fs.bitmap_end + 31) / 32) * sizeof(uint32_t);
+    }
+    for (int i = 0; i < FAT12_DIR_INDEX_SLOTS; i++) {
+        if (g_dir_index[i]) {
+            *heap_bytes += sizeof(fat12_dir_index_t);
+        }
+    }
+}
+
 int fat12_flush(void) {
     if (!g_fs_ready) {
         return FAT12_ERR_NOT_INITIALIZED;
@@ -24,28 +24,102 @@
 #define FAT12_ERR_BUFFER_SMALL      -11
 #define FAT12_ERR_NOT_FILE          -12
 #define FAT12_ERR_NOT_INITIALIZED   -13
+#define FAT12_ERR_BAD_HANDLE        -14
+#define FAT12_ERR_TOO_MANY_OPEN     -15
+/* -16 and -18 are VFS-only codes (see fs/vfs.h) */
+#define FAT12_ERR_BUSY              -17 /* file is open, or open for writing */
+#define FAT12_ERR_NO_MEMORY         -19
 
 #define FAT12_MAX_DISPLAY_NAME 13
 #define FAT12_PATH_MAX        128
 
+/* Open-file table size and fat12_open() flags */
+#define FAT12_MAX_OPEN_FILES  4
+#define FAT12_OPEN_READ       0x01
+#define FAT12_OPEN_WRITE      0x02
+#define FAT12_OPEN_CREATE     0x04
+#define FAT12_OPEN_TRUNCATE   0x08
+#define FAT12_OPEN_APPEND     0x10  /* every write lands at the end of file */
+#define FAT12_OPEN_EXCLUSIVE  0x20  /* fail with FAT12_ERR_BUSY if the file is open at all */
+
+#define FAT12_SEEK_SET 0
+#define FAT12_SEEK_CUR 1
+#define FAT12_SEEK_END 2
+
 typedef struct {
     char name[FAT12_MAX_DISPLAY_NAME];
     uint8_t attr;
     uint32_t size;
-    uint16_t first_cluster;
+    uint32_t first_cluster;
 } fat12_dir_entry_info_t;
 
+typedef struct {
+    uint32_t fat_cache_hits;
+    uint32_t fat_cache_misses;
+    uint32_t fat_sector_writes;
+    uint32_t root_sector_writes;
+    uint32_t mount_sector_reads;
+    uint32_t alloc_extents;
+    uint32_t alloc_clusters;
+    uint32_t extent_map_builds;
+    uint32_t chain_walk_steps;
+    uint32_t dentry_hits;
+    uint32_t dentry_negative_hits;
+    uint32_t dentry_misses;
+    uint32_t dir_index_builds;
+} fat12_stats_t;
+
+typedef struct {
+    uint32_t total_clusters;
+    uint32_t free_clusters;
+    uint32_t cluster_size;
+    uint8_t fat_type;           /* 12, 16 or 32 */
+} fat12_space_info_t;
+
+typedef struct {
+    uint32_t clusters;
+    uint32_t extents;           /* runs of physically contiguous clusters */
+    uint32_t largest_run;       /* in clusters */
+} fat12_frag_info_t;
+
+typedef struct {
+    uint32_t files_checked;
+    uint32_t files_moved;
+    uint32_t clusters_moved;
+    uint32_t files_skipped;     /* open, or no free run large enough */
+} fat12_defrag_stats_t;
+
 typedef int (*fat12_dir_iter_cb)(const fat12_dir_entry_info_t *entry, void *context);
 
+/* fat12_mount() flags */
+#define FAT12_MOUNT_LAZY      0x01  /* defer root directory and free bitmap loads */
+
 int fat12_init(uint32_t base_lba);
+int fat12_mount(uint32_t base_lba, int flags);
 int fat12_iterate_current_directory(fat12_dir_iter_cb cb, void *context);
 int fat12_iterate_path(const char *path, fat12_dir_iter_cb cb, void *context);
 int fat12_change_directory(const char *path);
 const char *fat12_get_cwd(void);
+int fat12_stat(const char *path, fat12_dir_entry_info_t *info);
 int fat12_read_file(const char *path, uint8_t *buffer, uint32_t max_size, uint32_t *out_size);
 int fat12_write_file(const char *name, const uint8_t *data, uint32_t size);
 int fat12_create_directory(const char *name);
 int fat12_delete_file(const char *name);
 int fat12_flush(void);
 
+/* Streaming access: fat12_open() returns a handle (>= 0) or an error code.
+ * Reads and writes move the position; seeking is limited to [0, size]. */
+int fat12_open(const char *path, int flags);
+int fat12_read(int handle, uint8_t *buffer, uint32_t length, uint32_t *out_read);
+int fat12_write(int handle, const uint8_t *data, uint32_t length, uint32_t *out_written);
+int fat12_seek(int handle, int offset, int whence, uint32_t *out_position);
+int fat12_close(int handle);
+void fat12_get_stats(fat12_stats_t *stats);
+/* Bytes in the kernel image and bytes taken from the heap for the mount */
+void fat12_get_footprint(uint32_t *static_bytes, uint32_t *heap_bytes);
+int fat12_get_space(fat12_space_info_t *info);
+int fat12_get_fragmentation(const char *path, fat12_frag_info_t *info);
+/* Defragment one file, or the whole volume when path is 0 or empty */
+int fat12_defragment(const char *path, fat12_defrag_stats_t *stats);
+
 #endif /* FAT12_H */
@@ -0,0 +1,60 @@
+#include "../include/fs/fatfs.h"
+#include "../fat12.h"
+
+/* The driver already takes absolute paths, handles and FAT12_* codes that
+ * match the VFS ones, so most operations are bound directly; only entry
+ * records need converting */
+
+static void fatfs_fill_entry(const fat12_dir_entry_info_t *info, vfs_dir_entry_t *out) {
+    strcpy_impl(out->name, info->name);
+    out->type = (info->attr & FAT12_ATTR_DIRECTORY) ? VFS_TYPE_DIR : VFS_TYPE_FILE;
+    out->size = info->size;
+}
+
+static int fatfs_stat(const char *path, vfs_dir_entry_t *out) {
+    fat12_dir_entry_info_t info;
+    int res = fat12_stat(path, &info);
+    if (res == FAT12_OK) {
+        fatfs_fill_entry(&info, out);
+    }
+    return res;
+}
+
+typedef struct {
+    vfs_dir_iter_cb cb;
+    void *context;
+} fatfs_iter_context_t;
+
+static int fatfs_iter_callback(const fat12_dir_entry_info_t *info, void *context) {
+    fatfs_iter_context_t *ctx = (fatfs_iter_context_t *)context;
+    vfs_dir_entry_t entry;
+    fatfs_fill_entry(info, &entry);
+    return ctx->cb(&entry, ctx->context);
+}
+
+static int fatfs_iterate(const char *path, vfs_dir_iter_cb cb, void *context) {
+    fatfs_iter_context_t ctx;
+    ctx.cb = cb;
+    ctx.context = context;
+    return fat12_iterate_path(path, fatfs_iter_callback, &ctx);
+}
+
+static const vfs_ops_t g_fatfs_ops = {
+    "fat",
+    fatfs_stat,
+    fatfs_iterate,
+    fat12_open,
+    fat12_read,
+    fat12_write,
+    fat12_seek,
+    fat12_close,
+    fat12_create_directory,
+    fat12_delete_file,
+    fat12_read_file,
+    fat12_write_file,
+    fat12_flush
+};
+
+const vfs_ops_t *fatfs_get_ops(void) {
+    return &g_fatfs_ops;
+}
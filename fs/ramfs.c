@@ -0,0 +1,499 @@
+#include "../include/fs/ramfs.h"
+#include "../include/kernel/heap.h"
+
+#define RAMFS_NO_NODE 0xFFFF
+#define RAMFS_ROOT    0
+
+typedef struct {
+    char name[VFS_NAME_MAX];
+    uint8_t in_use;
+    uint8_t type;
+    uint16_t parent;
+    uint16_t first_child;
+    uint16_t next_sibling;
+    uint16_t open_count;
+    uint16_t block_count;
+    uint32_t size;
+    uint16_t blocks[RAMFS_FILE_BLOCKS];
+} ramfs_node_t;
+
+typedef struct {
+    uint16_t node;
+    uint8_t flags;
+    uint8_t in_use;
+    uint32_t position;
+} ramfs_open_file_t;
+
+static ramfs_node_t g_nodes[RAMFS_MAX_NODES];
+/* Block storage comes from the heap in one piece; if that fails the
+ * filesystem still works but every write runs out of space */
+static uint8_t (*g_blocks)[RAMFS_BLOCK_SIZE] = 0;
+static uint16_t g_block_total = 0;
+/* Free nodes and blocks are kept on stacks so allocation is O(1) */
+static uint16_t g_free_nodes[RAMFS_MAX_NODES];
+static uint16_t g_free_node_count = 0;
+static uint16_t g_free_blocks[RAMFS_MAX_BLOCKS];
+static uint16_t g_free_block_count = 0;
+static ramfs_open_file_t g_open_files[RAMFS_MAX_OPEN_FILES];
+
+static void ramfs_memcpy(uint8_t *dest, const uint8_t *src, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        dest[i] = src[i];
+    }
+}
+
+static int ramfs_name_equals(const char *name, const char *component, uint32_t length) {
+    for (uint32_t i = 0; i < length; i++) {
+        if (name[i] != component[i]) {
+            return 0;
+        }
+    }
+    return name[length] == '\0';
+}
+
+static uint16_t ramfs_find_child(uint16_t dir, const char *component, uint32_t length) {
+    uint16_t child = g_nodes[dir].first_child;
+    while (child != RAMFS_NO_NODE) {
+        if (ramfs_name_equals(g_nodes[child].name, component, length)) {
+            return child;
+        }
+        child = g_nodes[child].next_sibling;
+    }
+    return RAMFS_NO_NODE;
+}
+
+/* Splits off the next component of a normalized path */
+static uint32_t ramfs_next_component(const char **cursor) {
+    const char *ptr = *cursor;
+    while (*ptr == '/') {
+        ptr++;
+    }
+    *cursor = ptr;
+    uint32_t length = 0;
+    while (ptr[length] && ptr[length] != '/') {
+        length++;
+    }
+    return length;
+}
+
+/* Walks every component but the last. *out_name and *out_length describe
+ * the last one, which is empty for the root. */
+static int ramfs_walk_parent(const char *path, uint16_t *out_parent, const char **out_name, uint32_t *out_length) {
+    uint16_t dir = RAMFS_ROOT;
+    const char *cursor = path;
+    uint32_t length = ramfs_next_component(&cursor);
+    for (;;) {
+        const char *next = cursor + length;
+        uint32_t next_length = ramfs_next_component(&next);
+        if (next_length == 0) {
+            break;
+        }
+        uint16_t child = ramfs_find_child(dir, cursor, length);
+        if (child == RAMFS_NO_NODE) {
+            return VFS_ERR_NOT_FOUND;
+        }
+        if (g_nodes[child].type != VFS_TYPE_DIR) {
+            return VFS_ERR_NOT_DIRECTORY;
+        }
+        dir = child;
+        cursor = next;
+        length = next_length;
+    }
+    *out_parent = dir;
+    *out_name = cursor;
+    *out_length = length;
+    return VFS_OK;
+}
+
+static int ramfs_walk(const char *path, uint16_t *out_node) {
+    uint16_t parent;
+    const char *name;
+    uint32_t length;
+    int res = ramfs_walk_parent(path, &parent, &name, &length);
+    if (res != VFS_OK) {
+        return res;
+    }
+    if (length == 0) {
+        *out_node = RAMFS_ROOT;
+        return VFS_OK;
+    }
+    uint16_t node = ramfs_find_child(parent, name, length);
+    if (node == RAMFS_NO_NODE) {
+        return VFS_ERR_NOT_FOUND;
+    }
+    *out_node = node;
+    return VFS_OK;
+}
+
+static int ramfs_create(uint16_t parent, const char *name, uint32_t length, uint8_t type, uint16_t *out_node) {
+    if (length == 0 || length >= VFS_NAME_MAX) {
+        return VFS_ERR_INVALID_NAME;
+    }
+    if (g_free_node_count == 0) {
+        return VFS_ERR_DIR_FULL;
+    }
+    uint16_t index = g_free_nodes[--g_free_node_count];
+    ramfs_node_t *node = &g_nodes[index];
+    for (uint32_t i = 0; i < length; i++) {
+        node->name[i] = name[i];
+    }
+    node->name[length] = '\0';
+    node->in_use = 1;
+    node->type = type;
+    node->parent = parent;
+    node->first_child = RAMFS_NO_NODE;
+    node->next_sibling = g_nodes[parent].first_child;
+    node->open_count = 0;
+    node->block_count = 0;
+    node->size = 0;
+    g_nodes[parent].first_child = index;
+    *out_node = index;
+    return VFS_OK;
+}
+
+static void ramfs_truncate(ramfs_node_t *node) {
+    while (node->block_count > 0) {
+        g_free_blocks[g_free_block_count++] = node->blocks[--node->block_count];
+    }
+    node->size = 0;
+}
+
+void ramfs_init(void) {
+    for (uint32_t i = 0; i < RAMFS_MAX_NODES; i++) {
+        g_nodes[i].in_use = 0;
+    }
+    /* Pushed in reverse so low indices are handed out first */
+    g_free_node_count = 0;
+    for (uint32_t i = RAMFS_MAX_NODES; i > 1; i--) {
+        g_free_nodes[g_free_node_count++] = (uint16_t)(i - 1);
+    }
+    if (!g_blocks) {
+        g_blocks = (uint8_t (*)[RAMFS_BLOCK_SIZE])kmalloc(RAMFS_MAX_BLOCKS * RAMFS_BLOCK_SIZE);
+    }
+    g_block_total = g_blocks ? RAMFS_MAX_BLOCKS : 0;
+    g_free_block_count = 0;
+    for (uint32_t i = g_block_total; i > 0; i--) {
+        g_free_blocks[g_free_block_count++] = (uint16_t)(i - 1);
+    }
+    for (uint32_t i = 0; i < RAMFS_MAX_OPEN_FILES; i++) {
+        g_open_files[i].in_use = 0;
+    }
+
+    ramfs_node_t *root = &g_nodes[RAMFS_ROOT];
+    root->name[0] = '/';
+    root->name[1] = '\0';
+    root->in_use = 1;
+    root->type = VFS_TYPE_DIR;
+    root->parent = RAMFS_ROOT;
+    root->first_child = RAMFS_NO_NODE;
+    root->next_sibling = RAMFS_NO_NODE;
+    root->open_count = 0;
+    root->block_count = 0;
+    root->size = 0;
+}
+
+static void ramfs_fill_entry(const ramfs_node_t *node, vfs_dir_entry_t *out) {
+    uint32_t i = 0;
+    while (node->name[i]) {
+        out->name[i] = node->name[i];
+        i++;
+    }
+    out->name[i] = '\0';
+    out->type = node->type;
+    out->size = node->size;
+}
+
+static int ramfs_stat(const char *path, vfs_dir_entry_t *out) {
+    uint16_t node;
+    int res = ramfs_walk(path, &node);
+    if (res != VFS_OK) {
+        return res;
+    }
+    ramfs_fill_entry(&g_nodes[node], out);
+    return VFS_OK;
+}
+
+static int ramfs_iterate(const char *path, vfs_dir_iter_cb cb, void *context) {
+    uint16_t dir;
+    int res = ramfs_walk(path, &dir);
+    if (res != VFS_OK) {
+        return res;
+    }
+    if (g_nodes[dir].type != VFS_TYPE_DIR) {
+        return VFS_ERR_NOT_DIRECTORY;
+    }
+    uint16_t child = g_nodes[dir].first_child;
+    while (child != RAMFS_NO_NODE) {
+        vfs_dir_entry_t entry;
+        ramfs_fill_entry(&g_nodes[child], &entry);
+        if (cb(&entry, context)) {
+            break;
+        }
+        child = g_nodes[child].next_sibling;
+    }
+    return VFS_OK;
+}
+
+static int ramfs_open(const char *path, int flags) {
+    if (flags & (VFS_OPEN_CREATE | VFS_OPEN_TRUNCATE | VFS_OPEN_APPEND)) {
+        flags |= VFS_OPEN_WRITE;
+    }
+    if ((flags & (VFS_OPEN_READ | VFS_OPEN_WRITE)) == 0) {
+        flags |= VFS_OPEN_READ;
+    }
+
+    int handle = -1;
+    for (int i = 0; i < RAMFS_MAX_OPEN_FILES; i++) {
+        if (!g_open_files[i].in_use) {
+            handle = i;
+            break;
+        }
+    }
+    if (handle < 0) {
+        return VFS_ERR_TOO_MANY_OPEN;
+    }
+
+    uint16_t parent;
+    const char *name;
+    uint32_t length;
+    int res = ramfs_walk_parent(path, &parent, &name, &length);
+    if (res != VFS_OK) {
+        return res;
+    }
+    if (length == 0) {
+        return VFS_ERR_NOT_FILE;
+    }
+    uint16_t index = ramfs_find_child(parent, name, length);
+    if (index == RAMFS_NO_NODE) {
+        if ((flags & VFS_OPEN_CREATE) == 0) {
+            return VFS_ERR_NOT_FOUND;
+        }
+        res = ramfs_create(parent, name, length, VFS_TYPE_FILE, &index);
+        if (res != VFS_OK) {
+            return res;
+        }
+    }
+    ramfs_node_t *node = &g_nodes[index];
+    if (node->type != VFS_TYPE_FILE) {
+        return VFS_ERR_NOT_FILE;
+    }
+    if (flags & VFS_OPEN_TRUNCATE) {
+        ramfs_truncate(node);
+    }
+
+    node->open_count++;
+    g_open_files[handle].node = index;
+    g_open_files[handle].flags = (uint8_t)flags;
+    g_open_files[handle].position = 0;
+    g_open_files[handle].in_use = 1;
+    return handle;
+}
+
+static ramfs_open_file_t *ramfs_get_handle(int handle) {
+    if (handle < 0 || handle >= RAMFS_MAX_OPEN_FILES || !g_open_files[handle].in_use) {
+        return 0;
+    }
+    return &g_open_files[handle];
+}
+
+static int ramfs_read(int handle, uint8_t *buffer, uint32_t length, uint32_t *out_read) {
+    ramfs_open_file_t *file = ramfs_get_handle(handle);
+    if (!file || (file->flags & VFS_OPEN_READ) == 0) {
+        return VFS_ERR_BAD_HANDLE;
+    }
+    ramfs_node_t *node = &g_nodes[file->node];
+    /* Another handle may have truncated the file under this one */
+    if (file->position > node->size) {
+        file->position = node->size;
+    }
+    uint32_t available = node->size - file->position;
+    if (length > available) {
+        length = available;
+    }
+    uint32_t done = 0;
+    while (done < length) {
+        uint32_t offset = file->position % RAMFS_BLOCK_SIZE;
+        uint32_t chunk = RAMFS_BLOCK_SIZE - offset;
+        if (chunk > length - done) {
+            chunk = length - done;
+        }
+        const uint8_t *block = g_blocks[node->blocks[file->position / RAMFS_BLOCK_SIZE]];
+        ramfs_memcpy(buffer + done, block + offset, chunk);
+        done += chunk;
+        file->position += chunk;
+    }
+    if (out_read) {
+        *out_read = done;
+    }
+    return VFS_OK;
+}
+
+/* Writes as much as fits; a short write reports VFS_ERR_NO_SPACE */
+static int ramfs_write(int handle, const uint8_t *data, uint32_t length, uint32_t *out_written) {
+    ramfs_open_file_t *file = ramfs_get_handle(handle);
+    if (!file || (file->flags & VFS_OPEN_WRITE) == 0) {
+        return VFS_ERR_BAD_HANDLE;
+    }
+    if (out_written) {
+        *out_written = 0;
+    }
+    if (!data && length > 0) {
+        return VFS_ERR_INVALID_NAME;
+    }
+    ramfs_node_t *node = &g_nodes[file->node];
+    if ((file->flags & VFS_OPEN_APPEND) || file->position > node->size) {
+        file->position = node->size;
+    }
+
+    int res = VFS_OK;
+    uint32_t done = 0;
+    while (done < length) {
+        uint32_t index = file->position / RAMFS_BLOCK_SIZE;
+        if (index >= node->block_count) {
+            if (index >= RAMFS_FILE_BLOCKS || g_free_block_count == 0) {
+                res = VFS_ERR_NO_SPACE;
+                break;
+            }
+            node->blocks[node->block_count++] = g_free_blocks[--g_free_block_count];
+        }
+        uint32_t offset = file->position % RAMFS_BLOCK_SIZE;
+        uint32_t chunk = RAMFS_BLOCK_SIZE - offset;
+        if (chunk > length - done) {
+            chunk = length - done;
+        }
+        ramfs_memcpy(g_blocks[node->blocks[index]] + offset, data + done, chunk);
+        done += chunk;
+        file->position += chunk;
+        if (file->position > node->size) {
+            node->size = file->position;
+        }
+    }
+    if (out_written) {
+        *out_written = done;
+    }
+    return res;
+}
+
+static int ramfs_seek(int handle, int offset, int whence, uint32_t *out_position) {
+    ramfs_open_file_t *file = ramfs_get_handle(handle);
+    if (!file) {
+        return VFS_ERR_BAD_HANDLE;
+    }
+    uint32_t size = g_nodes[file->node].size;
+    uint32_t base;
+    switch (whence) {
+        case VFS_SEEK_SET: base = 0; break;
+        case VFS_SEEK_CUR: base = file->position; break;
+        case VFS_SEEK_END: base = size; break;
+        default: return VFS_ERR_OUT_OF_RANGE;
+    }
+
+    uint32_t target;
+    if (offset < 0) {
+        uint32_t back = (uint32_t)0 - (uint32_t)offset;
+        if (back > base) {
+            return VFS_ERR_OUT_OF_RANGE;
+        }
+        target = base - back;
+    } else {
+        target = base + (uint32_t)offset;
+        if (target < base || target > size) {
+            return VFS_ERR_OUT_OF_RANGE;
+        }
+    }
+
+    file->position = target;
+    if (out_position) {
+        *out_position = target;
+    }
+    return VFS_OK;
+}
+
+static int ramfs_close(int handle) {
+    ramfs_open_file_t *file = ramfs_get_handle(handle);
+    if (!file) {
+        return VFS_ERR_BAD_HANDLE;
+    }
+    g_nodes[file->node].open_count--;
+    file->in_use = 0;
+    return VFS_OK;
+}
+
+static int ramfs_mkdir(const char *path) {
+    uint16_t parent;
+    const char *name;
+    uint32_t length;
+    int res = ramfs_walk_parent(path, &parent, &name, &length);
+    if (res != VFS_OK) {
+        return res;
+    }
+    if (length == 0 || ramfs_find_child(parent, name, length) != RAMFS_NO_NODE) {
+        return VFS_ERR_ALREADY_EXISTS;
+    }
+    uint16_t index;
+    return ramfs_create(parent, name, length, VFS_TYPE_DIR, &index);
+}
+
+/* Removes a file or an empty directory */
+static int ramfs_unlink(const char *path) {
+    uint16_t index;
+    int res = ramfs_walk(path, &index);
+    if (res != VFS_OK) {
+        return res;
+    }
+    if (index == RAMFS_ROOT) {
+        return VFS_ERR_BUSY;
+    }
+    ramfs_node_t *node = &g_nodes[index];
+    if (node->type == VFS_TYPE_DIR && node->first_child != RAMFS_NO_NODE) {
+        return VFS_ERR_NOT_EMPTY;
+    }
+    if (node->open_count > 0) {
+        return VFS_ERR_BUSY;
+    }
+
+    uint16_t *link = &g_nodes[node->parent].first_child;
+    while (*link != index) {
+        link = &g_nodes[*link].next_sibling;
+    }
+    *link = node->next_sibling;
+    ramfs_truncate(node);
+    node->in_use = 0;
+    g_free_nodes[g_free_node_count++] = index;
+    return VFS_OK;
+}
+
+static const vfs_ops_t g_ramfs_ops = {
+    "ramfs",
+    ramfs_stat,
+    ramfs_iterate,
+    ramfs_open,
+    ramfs_read,
+    ramfs_write,
+    ramfs_seek,
+    ramfs_close,
+    ramfs_mkdir,
+    ramfs_unlink,
+    0,
+    0,
+    0
+};
+
+const vfs_ops_t *ramfs_get_ops(void) {
+    return &g_ramfs_ops;
+}
+
+void ramfs_get_usage(ramfs_usage_t *usage) {
+    if (!usage) {
+        return;
+    }
+    usage->nodes_used = RAMFS_MAX_NODES - g_free_node_count;
+    usage->blocks_used = g_block_total - g_free_block_count;
+    usage->block_size = RAMFS_BLOCK_SIZE;
+    usage->total_blocks = g_block_total;
+}
+
+void ramfs_get_footprint(uint32_t *static_bytes, uint32_t *heap_bytes) {
+    *static_bytes = sizeof(g_nodes) + sizeof(g_free_nodes) + sizeof(g_free_blocks) + sizeof(g_open_files);
+    *heap_bytes = (uint32_t)g_block_total * RAMFS_BLOCK_SIZE;
+}
@@ -0,0 +1,540 @@
+#include "../include/fs/vfs.h"
+
+typedef struct {
+    char path[VFS_PATH_MAX];
+    uint32_t length;
+    const vfs_ops_t *ops;
+} vfs_mount_t;
+
+typedef struct {
+    const vfs_ops_t *ops;
+    int handle;
+    uint8_t in_use;
+} vfs_file_t;
+
+static vfs_mount_t g_mounts[VFS_MAX_MOUNTS];
+static int g_mount_count = 0;
+static vfs_file_t g_files[VFS_MAX_OPEN_FILES];
+static char g_cwd[VFS_PATH_MAX] = "/";
+
+static char vfs_lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+/* Mount points match case-insensitively so "/TMP" on the FAT root cannot
+ * shadow or be shadowed by a "/tmp" mount */
+static int vfs_prefix_equals(const char *a, const char *b, uint32_t length) {
+    for (uint32_t i = 0; i < length; i++) {
+        if (vfs_lower(a[i]) != vfs_lower(b[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void vfs_copy(char *dest, const char *src, uint32_t max_len) {
+    uint32_t i = 0;
+    while (src[i] && i < max_len - 1) {
+        dest[i] = src[i];
+        i++;
+    }
+    dest[i] = '\0';
+}
+
+/* Builds an absolute path without ".", ".." or empty components. Relative
+ * paths start from the cwd; ".." at the root stays at the root. */
+static int vfs_normalize(const char *path, char *out) {
+    uint32_t len = 0;
+    if (!path) {
+        return VFS_ERR_INVALID_NAME;
+    }
+    if (path[0] != '/' && path[0] != '\\' && g_cwd[1] != '\0') {
+        len = (uint32_t)strlen_impl(g_cwd);
+        for (uint32_t i = 0; i < len; i++) {
+            out[i] = g_cwd[i];
+        }
+    }
+
+    const char *cursor = path;
+    for (;;) {
+        while (*cursor == '/' || *cursor == '\\') {
+            cursor++;
+        }
+        if (*cursor == '\0') {
+            break;
+        }
+        const char *start = cursor;
+        uint32_t n = 0;
+        while (*cursor && *cursor != '/' && *cursor != '\\') {
+            cursor++;
+            n++;
+        }
+        if (n == 1 && start[0] == '.') {
+            continue;
+        }
+        if (n == 2 && start[0] == '.' && start[1] == '.') {
+            while (len > 0 && out[len - 1] != '/') {
+                len--;
+            }
+            if (len > 0) {
+                len--;
+            }
+            continue;
+        }
+        if (n >= VFS_NAME_MAX || len + 1 + n >= VFS_PATH_MAX) {
+            return VFS_ERR_INVALID_NAME;
+        }
+        out[len++] = '/';
+        for (uint32_t i = 0; i < n; i++) {
+            out[len++] = start[i];
+        }
+    }
+    if (len == 0) {
+        out[len++] = '/';
+    }
+    out[len] = '\0';
+    return VFS_OK;
+}
+
+/* Longest mount point that is a whole-component prefix of an absolute,
+ * normalized path. *out_rel is the remainder, "/" at the mount root. */
+static const vfs_mount_t *vfs_find_mount(const char *abs, const char **out_rel) {
+    const vfs_mount_t *best = 0;
+    for (int i = 0; i < g_mount_count; i++) {
+        const vfs_mount_t *mount = &g_mounts[i];
+        if (best && mount->length <= best->length) {
+            continue;
+        }
+        if (mount->length == 1) {
+            best = mount;
+            continue;
+        }
+        if (vfs_prefix_equals(abs, mount->path, mount->length) &&
+            (abs[mount->length] == '\0' || abs[mount->length] == '/')) {
+            best = mount;
+        }
+    }
+    if (best && out_rel) {
+        const char *rel = (best->length == 1) ? abs : abs + best->length;
+        *out_rel = (*rel == '\0') ? "/" : rel;
+    }
+    return best;
+}
+
+static int vfs_lookup(const char *path, char *abs, const vfs_mount_t **out_mount, const char **out_rel) {
+    if (g_mount_count == 0) {
+        return VFS_ERR_NOT_INITIALIZED;
+    }
+    int res = vfs_normalize(path, abs);
+    if (res != VFS_OK) {
+        return res;
+    }
+    *out_mount = vfs_find_mount(abs, out_rel);
+    return *out_mount ? VFS_OK : VFS_ERR_NOT_INITIALIZED;
+}
+
+static int vfs_is_mount_root(const char *rel) {
+    return rel[0] == '/' && rel[1] == '\0';
+}
+
+/* Offset of the last component of an absolute path ("/a/b" -> 3) */
+static uint32_t vfs_last_component(const char *abs, uint32_t length) {
+    uint32_t i = length;
+    while (i > 0 && abs[i - 1] != '/') {
+        i--;
+    }
+    return i;
+}
+
+void vfs_init(void) {
+    g_mount_count = 0;
+    g_cwd[0] = '/';
+    g_cwd[1] = '\0';
+    for (int i = 0; i < VFS_MAX_OPEN_FILES; i++) {
+        g_files[i].in_use = 0;
+    }
+}
+
+int vfs_mount(const char *path, const vfs_ops_t *ops) {
+    if (!ops) {
+        return VFS_ERR_INVALID_NAME;
+    }
+    if (g_mount_count >= VFS_MAX_MOUNTS) {
+        return VFS_ERR_TOO_MANY_OPEN;
+    }
+    char abs[VFS_PATH_MAX];
+    int res = vfs_normalize(path, abs);
+    if (res != VFS_OK) {
+        return res;
+    }
+    uint32_t length = (uint32_t)strlen_impl(abs);
+    for (int i = 0; i < g_mount_count; i++) {
+        if (g_mounts[i].length == length && vfs_prefix_equals(g_mounts[i].path, abs, length)) {
+            return VFS_ERR_BUSY;
+        }
+    }
+    if (length > 1) {
+        /* Listings show a mount point inside its parent, so the parent
+         * directory has to exist */
+        if (g_mount_count == 0) {
+            return VFS_ERR_NOT_INITIALIZED;
+        }
+        char parent[VFS_PATH_MAX];
+        uint32_t cut = vfs_last_component(abs, length);
+        vfs_copy(parent, abs, cut > 1 ? cut : 2);
+        vfs_dir_entry_t info;
+        res = vfs_stat(parent, &info);
+        if (res != VFS_OK) {
+            return res;
+        }
+        if (info.type != VFS_TYPE_DIR) {
+            return VFS_ERR_NOT_DIRECTORY;
+        }
+    }
+
+    vfs_mount_t *mount = &g_mounts[g_mount_count++];
+    vfs_copy(mount->path, abs, sizeof(mount->path));
+    mount->length = length;
+    mount->ops = ops;
+    return VFS_OK;
+}
+
+int vfs_is_ready(void) {
+    return g_mount_count > 0;
+}
+
+int vfs_mount_count(void) {
+    return g_mount_count;
+}
+
+int vfs_get_mount(int index, const char **out_path, const vfs_ops_t **out_ops) {
+    if (index < 0 || index >= g_mount_count) {
+        return VFS_ERR_OUT_OF_RANGE;
+    }
+    if (out_path) {
+        *out_path = g_mounts[index].path;
+    }
+    if (out_ops) {
+        *out_ops = g_mounts[index].ops;
+    }
+    return VFS_OK;
+}
+
+int vfs_resolve(const char *path, const vfs_ops_t **out_ops, char *out_path, uint32_t out_size) {
+    char abs[VFS_PATH_MAX];
+    const vfs_mount_t *mount;
+    const char *rel;
+    int res = vfs_lookup(path, abs, &mount, &rel);
+    if (res != VFS_OK) {
+        return res;
+    }
+    if (out_ops) {
+        *out_ops = mount->ops;
+    }
+    if (out_path && out_size > 0) {
+        vfs_copy(out_path, rel, out_size);
+    }
+    return VFS_OK;
+}
+
+int vfs_stat(const char *path, vfs_dir_entry_t *out) {
+    char abs[VFS_PATH_MAX];
+    const vfs_mount_t *mount;
+    const char *rel;
+    int res = vfs_lookup(path, abs, &mount, &rel);
+    if (res != VFS_OK) {
+        return res;
+    }
+    res = mount->ops->stat(rel, out);
+    if (res == VFS_OK && vfs_is_mount_root(rel) && mount->length > 1) {
+        vfs_copy(out->name, abs + vfs_last_component(abs, mount->length), sizeof(out->name));
+    }
+    return res;
+}
+
+int vfs_chdir(const char *path) {
+    char abs[VFS_PATH_MAX];
+    const vfs_mount_t *mount;
+    const char *rel;
+    int res = vfs_lookup(path, abs, &mount, &rel);
+    if (res != VFS_OK) {
+        return res;
+    }
+    vfs_dir_entry_t info;
+    res = mount->ops->stat(rel, &info);
+    if (res != VFS_OK) {
+        return res;
+    }
+    if (info.type != VFS_TYPE_DIR) {
+        return VFS_ERR_NOT_DIRECTORY;
+    }
+    vfs_copy(g_cwd, abs, sizeof(g_cwd));
+    return VFS_OK;
+}
+
+const char *vfs_getcwd(void) {
+    return g_cwd;
+}
+
+typedef struct {
+    const char *dir;
+    uint32_t dir_length;
+    vfs_dir_iter_cb cb;
+    void *context;
+    int stopped;
+} vfs_iter_context_t;
+
+/* Mounts whose parent is the directory being listed */
+static int vfs_is_child_mount(const vfs_mount_t *mount, const char *dir, uint32_t dir_length) {
+    if (mount->length <= 1) {
+        return 0;
+    }
+    uint32_t cut = vfs_last_component(mount->path, mount->length);
+    uint32_t parent_length = cut > 1 ? cut - 1 : 1;
+    return parent_length == dir_length && vfs_prefix_equals(mount->path, dir, dir_length);
+}
+
+/* Entries hidden by a mount point are not listed; the mount is */
+static int vfs_iter_filter(const vfs_dir_entry_t *entry, void *context) {
+    vfs_iter_context_t *ctx = (vfs_iter_context_t *)context;
+    uint32_t name_length = (uint32_t)strlen_impl(entry->name);
+    for (int i = 0; i < g_mount_count; i++) {
+        const vfs_mount_t *mount = &g_mounts[i];
+        if (!vfs_is_child_mount(mount, ctx->dir, ctx->dir_length)) {
+            continue;
+        }
+        uint32_t cut = vfs_last_component(mount->path, mount->length);
+        if (mount->length - cut == name_length && vfs_prefix_equals(mount->path + cut, entry->name, name_length)) {
+            return 0;
+        }
+    }
+    if (ctx->cb(entry, ctx->context)) {
+        ctx->stopped = 1;
+        return 1;
+    }
+    return 0;
+}
+
+int vfs_iterate(const char *path, vfs_dir_iter_cb cb, void *context) {
+    char abs[VFS_PATH_MAX];
+    const vfs_mount_t *mount;
+    const char *rel;
+    int res = vfs_lookup(path ? path : "", abs, &mount, &rel);
+    if (res != VFS_OK) {
+        return res;
+    }
+    if (!cb) {
+        return VFS_ERR_INVALID_NAME;
+    }
+    vfs_iter_context_t ctx;
+    ctx.dir = abs;
+    ctx.dir_length = (uint32_t)strlen_impl(abs);
+    ctx.cb = cb;
+    ctx.context = context;
+    ctx.stopped = 0;
+    res = mount->ops->iterate(rel, vfs_iter_filter, &ctx);
+    if (res != VFS_OK || ctx.stopped) {
+        return res;
+    }
+    for (int i = 0; i < g_mount_count; i++) {
+        const vfs_mount_t *child = &g_mounts[i];
+        if (!vfs_is_child_mount(child, abs, ctx.dir_length)) {
+            continue;
+        }
+        vfs_dir_entry_t entry;
+        vfs_copy(entry.name, child->path + vfs_last_component(child->path, child->length), sizeof(entry.name));
+        entry.type = VFS_TYPE_DIR;
+        entry.size = 0;
+        if (cb(&entry, context)) {
+            break;
+        }
+    }
+    return VFS_OK;
+}
+
+static vfs_file_t *vfs_get_file(int handle) {
+    if (handle < 0 || handle >= VFS_MAX_OPEN_FILES || !g_files[handle].in_use) {
+        return 0;
+    }
+    return &g_files[handle];
+}
+
+int vfs_open(const char *path, int flags) {
+    char abs[VFS_PATH_MAX];
+    const vfs_mount_t *mount;
+    const char *rel;
+    int res = vfs_lookup(path, abs, &mount, &rel);
+    if (res != VFS_OK) {
+        return res;
+    }
+    if (vfs_is_mount_root(rel)) {
+        return VFS_ERR_NOT_FILE;
+    }
+    int handle = -1;
+    for (int i = 0; i < VFS_MAX_OPEN_FILES; i++) {
+        if (!g_files[i].in_use) {
+            handle = i;
+            break;
+        }
+    }
+    if (handle < 0) {
+        return VFS_ERR_TOO_MANY_OPEN;
+    }
+    int fs_handle = mount->ops->open(rel, flags);
+    if (fs_handle < 0) {
+        return fs_handle;
+    }
+    g_files[handle].ops = mount->ops;
+    g_files[handle].handle = fs_handle;
+    g_files[handle].in_use = 1;
+    return handle;
+}
+
+int vfs_read(int handle, uint8_t *buffer, uint32_t length, uint32_t *out_read) {
+    vfs_file_t *file = vfs_get_file(handle);
+    if (!file) {
+        return VFS_ERR_BAD_HANDLE;
+    }
+    return file->ops->read(file->handle, buffer, length, out_read);
+}
+
+int vfs_write(int handle, const uint8_t *data, uint32_t length, uint32_t *out_written) {
+    vfs_file_t *file = vfs_get_file(handle);
+    if (!file) {
+        return VFS_ERR_BAD_HANDLE;
+    }
+    return file->ops->write(file->handle, data, length, out_written);
+}
+
+int vfs_seek(int handle, int offset, int whence, uint32_t *out_position) {
+    vfs_file_t *file = vfs_get_file(handle);
+    if (!file) {
+        return VFS_ERR_BAD_HANDLE;
+    }
+    return file->ops->seek(file->handle, offset, whence, out_position);
+}
+
+int vfs_close(int handle) {
+    vfs_file_t *file = vfs_get_file(handle);
+    if (!file) {
+        return VFS_ERR_BAD_HANDLE;
+    }
+    file->in_use = 0;
+    return file->ops->close(file->handle);
+}
+
+int vfs_mkdir(const char *path) {
+    char abs[VFS_PATH_MAX];
+    const vfs_mount_t *mount;
+    const char *rel;
+    int res = vfs_lookup(path, abs, &mount, &rel);
+    if (res != VFS_OK) {
+        return res;
+    }
+    if (vfs_is_mount_root(rel)) {
+        return VFS_ERR_ALREADY_EXISTS;
+    }
+    return mount->ops->mkdir(rel);
+}
+
+int vfs_unlink(const char *path) {
+    char abs[VFS_PATH_MAX];
+    const vfs_mount_t *mount;
+    const char *rel;
+    int res = vfs_lookup(path, abs, &mount, &rel);
+    if (res != VFS_OK) {
+        return res;
+    }
+    if (vfs_is_mount_root(rel)) {
+        return VFS_ERR_BUSY;
+    }
+    return mount->ops->unlink(rel);
+}
+
+int vfs_read_file(const char *path, uint8_t *buffer, uint32_t max_size, uint32_t *out_size) {
+    char abs[VFS_PATH_MAX];
+    const vfs_mount_t *mount;
+    const char *rel;
+    int res = vfs_lookup(path, abs, &mount, &rel);
+    if (res != VFS_OK) {
+        return res;
+    }
+    if (mount->ops->read_file) {
+        return mount->ops->read_file(rel, buffer, max_size, out_size);
+    }
+
+    vfs_dir_entry_t info;
+    res = mount->ops->stat(rel, &info);
+    if (res != VFS_OK) {
+        return res;
+    }
+    if (info.type != VFS_TYPE_FILE) {
+        return VFS_ERR_NOT_FILE;
+    }
+    if (info.size > max_size) {
+        return VFS_ERR_BUFFER_SMALL;
+    }
+    int handle = mount->ops->open(rel, VFS_OPEN_READ);
+    if (handle < 0) {
+        return handle;
+    }
+    uint32_t total = 0;
+    while (total < info.size) {
+        uint32_t chunk = 0;
+        res = mount->ops->read(handle, buffer + total, info.size - total, &chunk);
+        if (res != VFS_OK || chunk == 0) {
+            break;
+        }
+        total += chunk;
+    }
+    int close_res = mount->ops->close(handle);
+    if (res == VFS_OK) {
+        res = close_res;
+    }
+    if (res == VFS_OK && out_size) {
+        *out_size = total;
+    }
+    return res;
+}
+
+int vfs_write_file(const char *path, const uint8_t *data, uint32_t size) {
+    char abs[VFS_PATH_MAX];
+    const vfs_mount_t *mount;
+    const char *rel;
+    int res = vfs_lookup(path, abs, &mount, &rel);
+    if (res != VFS_OK) {
+        return res;
+    }
+    if (vfs_is_mount_root(rel)) {
+        return VFS_ERR_NOT_FILE;
+    }
+    if (mount->ops->write_file) {
+        return mount->ops->write_file(rel, data, size);
+    }
+
+    int handle = mount->ops->open(rel, VFS_OPEN_WRITE | VFS_OPEN_CREATE | VFS_OPEN_TRUNCATE);
+    if (handle < 0) {
+        return handle;
+    }
+    res = mount->ops->write(handle, data, size, 0);
+    int close_res = mount->ops->close(handle);
+    return (res == VFS_OK) ? close_res : res;
+}
+
+int vfs_sync(void) {
+    int result = VFS_OK;
+    for (int i = 0; i < g_mount_count; i++) {
+        if (g_mounts[i].ops->sync) {
+            int res = g_mounts[i].ops->sync();
+            if (res != VFS_OK && result == VFS_OK) {
+                result = res;
+            }
+        }
+    }
+    return result;
+}
+
+void vfs_get_footprint(uint32_t *static_bytes, uint32_t *heap_bytes) {
+    *static_bytes = sizeof(g_mounts) + sizeof(g_files) + sizeof(g_cwd);
+    *heap_bytes = 0;
+}
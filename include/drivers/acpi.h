@@ -0,0 +1,74 @@
+#ifndef DRIVERS_ACPI_H
+#define DRIVERS_ACPI_H
+
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long long uint64_t;
+
+#define ACPI_RSDP_SIGNATURE "RSD PTR "
+#define ACPI_EBDA_SEGMENT_PTR 0x40E
+#define ACPI_BIOS_AREA_START  0xE0000
+#define ACPI_BIOS_AREA_END    0x100000
+
+/* Root System Description Pointer (ACPI 2.0 layout, 1.0 stops at rsdt_address) */
+typedef struct __attribute__((packed)) {
+    char signature[8];
+    uint8_t checksum;
+    char oem_id[6];
+    uint8_t revision;
+    uint32_t rsdt_address;
+    uint32_t length;
+    uint64_t xsdt_address;
+    uint8_t extended_checksum;
+    uint8_t reserved[3];
+} acpi_rsdp_t;
+
+/* Common header of every System Description Table */
+typedef struct __attribute__((packed)) {
+    char signature[4];
+    uint32_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} acpi_sdt_header_t;
+
+/* PCI Express memory-mapped configuration table */
+typedef struct __attribute__((packed)) {
+    uint64_t base_address;
+    uint16_t segment_group;
+    uint8_t start_bus;
+    uint8_t end_bus;
+    uint32_t reserved;
+} acpi_mcfg_entry_t;
+
+typedef struct __attribute__((packed)) {
+    acpi_sdt_header_t header;
+    uint8_t reserved[8];
+} acpi_mcfg_t;
+
+/* High Precision Event Timer description; base_address is a GAS whose
+ * address space must be system memory (0) */
+typedef struct __attribute__((packed)) {
+    acpi_sdt_header_t header;
+    uint32_t event_timer_block_id;
+    uint8_t address_space_id;
+    uint8_t register_bit_width;
+    uint8_t register_bit_offset;
+    uint8_t reserved;
+    uint64_t base_address;
+    uint8_t hpet_number;
+    uint16_t minimum_tick;
+    uint8_t page_protection;
+} acpi_hpet_t;
+
+int acpi_init(void);
+int acpi_is_available(void);
+const acpi_rsdp_t *acpi_get_rsdp(void);
+const acpi_sdt_header_t *acpi_find_table(const char *signature);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef DRIVERS_HPET_H
+#define DRIVERS_HPET_H
+
+#include "../lib/string.h"
+
+/* High Precision Event Timer, found through the ACPI "HPET" table. Only
+ * the main counter is used; the comparators stay disabled. */
+#define HPET_REG_CAPABILITIES  0x000
+#define HPET_REG_CONFIG        0x010
+#define HPET_REG_COUNTER       0x0F0
+#define HPET_MMIO_SIZE         0x400
+
+#define HPET_CONFIG_ENABLE     0x01
+#define HPET_CAP_COUNTER_64    (1u << 13)
+/* The specification caps the tick period at 100 ns */
+#define HPET_MAX_PERIOD_FS     100000000u
+
+/* Returns 0 with the main counter running, -1 without a usable HPET */
+int hpet_init(void);
+int hpet_is_available(void);
+/* Counter ticks since hpet_init(); a 32-bit counter is extended in
+ * software, which needs a read at least once per wrap (~5 min at 14 MHz) */
+uint64_t hpet_read_counter(void);
+/* Only a 64-bit counter is safe to leave unread for long stretches */
+int hpet_counter_is_64bit(void);
+uint32_t hpet_period_fs(void);
+uint32_t hpet_timer_count(void);
+
+#endif
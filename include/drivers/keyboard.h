@@ -3,6 +3,9 @@
 
 #include "../lib/string.h"
 
+/* Scancodes queued by the IRQ 1 handler; must be a power of two */
+#define KEYBOARD_BUFFER_SIZE 128
+
 typedef struct {
     int ctrl_pressed;
     int extended_scancode_pending;
@@ -10,8 +13,12 @@ typedef struct {
 
 void keyboard_init(keyboard_state_t *state);
 keyboard_state_t *keyboard_get_state(void);
+/* Switches from polling port 0x64 to the IRQ 1 ring buffer; needs
+ * interrupts_init() */
+void keyboard_enable_irq(void);
 int keyboard_ready(void);
 uint8_t read_keyboard(void);
+uint32_t keyboard_dropped_scancodes(void);
 char scancode_to_ascii(uint16_t scancode);
 void handle_keyboard_input(void);
 void handle_console_scancode(uint16_t scancode);
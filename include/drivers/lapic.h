@@ -0,0 +1,43 @@
+#ifndef DRIVERS_LAPIC_H
+#define DRIVERS_LAPIC_H
+
+#include "../lib/string.h"
+
+/* Local APIC register offsets from its MMIO base */
+#define LAPIC_REG_ID             0x020
+#define LAPIC_REG_EOI            0x0B0
+#define LAPIC_REG_SPURIOUS       0x0F0
+#define LAPIC_REG_LVT_TIMER      0x320
+#define LAPIC_REG_TIMER_INITIAL  0x380
+#define LAPIC_REG_TIMER_CURRENT  0x390
+#define LAPIC_REG_TIMER_DIVIDE   0x3E0
+#define LAPIC_MMIO_SIZE          0x1000
+
+#define LAPIC_SPURIOUS_ENABLE    0x100
+#define LAPIC_LVT_MASKED         0x10000
+#define LAPIC_LVT_ONESHOT        0x00000
+#define LAPIC_LVT_TSC_DEADLINE   0x40000
+#define LAPIC_DIVIDE_BY_16       0x3
+
+/* How the timer is programmed */
+#define LAPIC_TIMER_NONE          0
+#define LAPIC_TIMER_ONESHOT       1   /* count down at the bus clock / 16 */
+#define LAPIC_TIMER_TSC_DEADLINE  2   /* fire when the TSC passes a value */
+
+/* Longest single arm; later deadlines are reached in several steps */
+#define LAPIC_MAX_ARM_NS         1000000000000ULL
+
+/* Enables the local APIC and sets up its timer on LAPIC_TIMER_VECTOR with
+ * nothing armed. Needs interrupts_init() and clock_init(); returns -1 if
+ * the CPU has no APIC or the timer could not be calibrated. */
+int lapic_init(void);
+int lapic_timer_mode(void);
+/* Count-down rate in one-shot mode, 0 in TSC-deadline mode */
+uint32_t lapic_timer_khz(void);
+/* Fires LAPIC_TIMER_VECTOR once, delta_ns from now; replaces any earlier
+ * arm. The interrupt may come early for deltas above LAPIC_MAX_ARM_NS. */
+void lapic_timer_arm(uint64_t delta_ns);
+void lapic_timer_cancel(void);
+void lapic_eoi(void);
+
+#endif
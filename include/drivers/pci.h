@@ -4,6 +4,7 @@
 typedef unsigned char uint8_t;
 typedef unsigned short uint16_t;
 typedef unsigned int uint32_t;
+typedef unsigned long long uint64_t;
 
 #define PCI_MAX_DEVICES 256
 
@@ -13,9 +14,9 @@ typedef unsigned int uint32_t;
 #define PCI_COMMAND             0x04
 #define PCI_STATUS              0x06
 #define PCI_REVISION_ID         0x08
-#define PCI_CLASS_CODE          0x09
-#define PCI_SUBCLASS_CODE       0x0A
 #define PCI_PROG_IF             0x09
+#define PCI_SUBCLASS_CODE       0x0A
+#define PCI_CLASS_CODE          0x0B
 #define PCI_CACHE_LINE_SIZE     0x0C
 #define PCI_LATENCY_TIMER       0x0D
 #define PCI_HEADER_TYPE         0x0E
@@ -26,12 +27,47 @@ typedef unsigned int uint32_t;
 #define PCI_BAR3                0x1C
 #define PCI_BAR4                0x20
 #define PCI_BAR5                0x24
+#define PCI_PRIMARY_BUS         0x18
+#define PCI_SECONDARY_BUS       0x19
+#define PCI_SUBORDINATE_BUS     0x1A
+#define PCI_CAPABILITY_LIST     0x34
+
+/* Extended (PCIe) configuration space, reachable only through ECAM */
+#define PCI_CONFIG_SPACE_SIZE       0x100
+#define PCI_EXT_CONFIG_SPACE_SIZE   0x1000
+#define PCI_EXT_CAP_START           0x100
+
+/* PCI Status Register Bits */
+#define PCI_STATUS_CAP_LIST     0x0010
+
+/* Header Type Register */
+#define PCI_HEADER_TYPE_MASK         0x7F
+#define PCI_HEADER_TYPE_MULTIFUNC    0x80
+#define PCI_HEADER_TYPE_DEVICE       0x00
+#define PCI_HEADER_TYPE_BRIDGE       0x01
+
+/* BAR Register Bits */
+#define PCI_BAR_SPACE_IO        0x00000001
+#define PCI_BAR_MEM_TYPE_MASK   0x00000006
+#define PCI_BAR_MEM_TYPE_64     0x00000004
+#define PCI_BAR_MEM_PREFETCH    0x00000008
+#define PCI_BAR_IO_ADDR_MASK    0xFFFFFFFC
+#define PCI_BAR_MEM_ADDR_MASK   0xFFFFFFF0
+
+/* Decoded BAR types */
+#define PCI_BAR_TYPE_NONE       0
+#define PCI_BAR_TYPE_IO         1
+#define PCI_BAR_TYPE_MEM32      2
+#define PCI_BAR_TYPE_MEM64      3
+#define PCI_BAR_TYPE_UPPER      4   /* High dword of the preceding 64-bit BAR */
 
 /* PCI Device Classes */
 #define PCI_CLASS_STORAGE       0x01
 #define PCI_SUBCLASS_SATA       0x06
 #define PCI_SUBCLASS_NVME       0x08
 #define PCI_SUBCLASS_ATA        0x01
+#define PCI_CLASS_BRIDGE        0x06
+#define PCI_SUBCLASS_PCI_BRIDGE 0x04
 
 /* PCI Command Register Bits */
 #define PCI_CMD_IO_SPACE        0x0001
@@ -48,17 +84,35 @@ typedef struct {
     uint8_t class_code;
     uint8_t subclass_code;
     uint8_t prog_if;
-    uint32_t bar[6];
-    uint32_t bar_size[6];
+    uint8_t header_type;
+    uint64_t bar[6];
+    uint64_t bar_size[6];
+    uint8_t bar_type[6];
+    uint8_t bar_prefetchable[6];
 } pci_device_t;
 
+/* Cost of the last enumeration pass */
+typedef struct {
+    uint32_t config_reads;
+    uint32_t buses_scanned;
+    uint32_t functions_found;
+    uint32_t ecam_regions;
+} pci_scan_stats_t;
+
 /* PCI enumeration functions */
 int pci_enumerate(void);
 int pci_get_device_count(void);
 pci_device_t *pci_get_device(int index);
-uint32_t pci_read_config(uint8_t bus, uint8_t dev, uint8_t fn, uint8_t offset);
-void pci_write_config(uint8_t bus, uint8_t dev, uint8_t fn, uint8_t offset, uint32_t value);
-uint32_t pci_get_bar(pci_device_t *dev, int bar_index);
+uint32_t pci_read_config(uint8_t bus, uint8_t dev, uint8_t fn, uint16_t offset);
+void pci_write_config(uint8_t bus, uint8_t dev, uint8_t fn, uint16_t offset, uint32_t value);
+int pci_ecam_available(void);
+uint8_t pci_find_capability(pci_device_t *dev, uint8_t cap_id);
+uint16_t pci_find_ext_capability(pci_device_t *dev, uint16_t cap_id);
+uint64_t pci_get_bar(pci_device_t *dev, int bar_index);
+uint64_t pci_get_bar_size(pci_device_t *dev, int bar_index);
+volatile void *pci_map_bar(pci_device_t *dev, int bar_index);
 int pci_enable_memory_space(pci_device_t *dev);
+void pci_get_scan_stats(pci_scan_stats_t *stats);
+void pci_get_footprint(uint32_t *static_bytes, uint32_t *heap_bytes);
 
 #endif /* PCI_H */
@@ -0,0 +1,21 @@
+#ifndef DRIVERS_PIT_H
+#define DRIVERS_PIT_H
+
+#include "../lib/string.h"
+
+/* 8253/8254 programmable interval timer. Channel 2 is gated through port
+ * 0x61 and its output can be read back there, which makes it usable as a
+ * polled one-shot without taking IRQ 0. */
+#define PIT_FREQUENCY_HZ   1193182
+#define PIT_CHANNEL0_PORT  0x40
+#define PIT_CHANNEL2_PORT  0x42
+#define PIT_COMMAND_PORT   0x43
+#define PIT_GATE_PORT      0x61
+
+/* Starts channel 2 counting down from count (mode 0, speaker off) */
+void pit_oneshot_start(uint16_t count);
+int pit_oneshot_expired(void);
+/* Leaves the speaker gate as it was before pit_oneshot_start() */
+void pit_oneshot_stop(void);
+
+#endif
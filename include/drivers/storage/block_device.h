@@ -38,5 +38,6 @@ int storage_manager_init(void);
 block_device_t *storage_get_device(int index);
 int storage_get_device_count(void);
 block_device_t *storage_get_primary_device(void);
+void storage_get_footprint(uint32_t *static_bytes, uint32_t *heap_bytes);
 
 #endif /* BLOCK_DEVICE_H */
@@ -0,0 +1,9 @@
+#ifndef FS_FATFS_H
+#define FS_FATFS_H
+
+#include "vfs.h"
+
+/* VFS binding for the FAT12/16/32 driver in fat12.c */
+const vfs_ops_t *fatfs_get_ops(void);
+
+#endif /* FS_FATFS_H */
@@ -0,0 +1,27 @@
+#ifndef FS_RAMFS_H
+#define FS_RAMFS_H
+
+#include "vfs.h"
+
+/* Memory-backed filesystem for scratch files. Storage is a fixed pool of
+ * nodes and a heap-allocated pool of data blocks; nothing survives a
+ * reboot. */
+#define RAMFS_MAX_NODES       64
+#define RAMFS_BLOCK_SIZE    1024
+#define RAMFS_MAX_BLOCKS     256
+#define RAMFS_FILE_BLOCKS     64    /* largest file: 64 KiB */
+#define RAMFS_MAX_OPEN_FILES   8
+
+typedef struct {
+    uint32_t nodes_used;
+    uint32_t blocks_used;
+    uint32_t block_size;
+    uint32_t total_blocks;
+} ramfs_usage_t;
+
+void ramfs_init(void);
+const vfs_ops_t *ramfs_get_ops(void);
+void ramfs_get_usage(ramfs_usage_t *usage);
+void ramfs_get_footprint(uint32_t *static_bytes, uint32_t *heap_bytes);
+
+#endif /* FS_RAMFS_H */
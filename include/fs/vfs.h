@@ -0,0 +1,104 @@
+#ifndef FS_VFS_H
+#define FS_VFS_H
+
+#include "../lib/string.h"
+
+/* Result codes. The values shared with fat12.h are identical so the FAT
+ * driver's results pass through the VFS unchanged; -16 and -18 are
+ * produced by the VFS layer or ramfs only. */
+#define VFS_OK                     0
+#define VFS_ERR_IO                -1
+#define VFS_ERR_OUT_OF_RANGE      -4
+#define VFS_ERR_NO_SPACE          -5
+#define VFS_ERR_INVALID_NAME      -6
+#define VFS_ERR_NOT_FOUND         -7
+#define VFS_ERR_NOT_DIRECTORY     -8
+#define VFS_ERR_ALREADY_EXISTS    -9
+#define VFS_ERR_DIR_FULL         -10
+#define VFS_ERR_BUFFER_SMALL     -11
+#define VFS_ERR_NOT_FILE         -12
+#define VFS_ERR_NOT_INITIALIZED  -13
+#define VFS_ERR_BAD_HANDLE       -14
+#define VFS_ERR_TOO_MANY_OPEN    -15
+#define VFS_ERR_NOT_EMPTY        -16
+#define VFS_ERR_BUSY             -17
+#define VFS_ERR_NOT_SUPPORTED    -18
+#define VFS_ERR_NO_MEMORY        -19
+
+#define VFS_PATH_MAX         128
+#define VFS_NAME_MAX          32
+#define VFS_MAX_MOUNTS         4
+#define VFS_MAX_OPEN_FILES     8
+
+/* vfs_open() flags and seek origins, numerically equal to the FAT12_OPEN_*
+ * and FAT12_SEEK_* values */
+#define VFS_OPEN_READ       0x01
+#define VFS_OPEN_WRITE      0x02
+#define VFS_OPEN_CREATE     0x04
+#define VFS_OPEN_TRUNCATE   0x08
+#define VFS_OPEN_APPEND     0x10
+
+#define VFS_SEEK_SET 0
+#define VFS_SEEK_CUR 1
+#define VFS_SEEK_END 2
+
+#define VFS_TYPE_FILE 1
+#define VFS_TYPE_DIR  2
+
+typedef struct {
+    char name[VFS_NAME_MAX];
+    uint8_t type;
+    uint32_t size;
+} vfs_dir_entry_t;
+
+typedef int (*vfs_dir_iter_cb)(const vfs_dir_entry_t *entry, void *context);
+
+/* Operations a filesystem provides. Paths handed to a filesystem are
+ * absolute within that filesystem ("/" is its root) and already normalized:
+ * no ".", "..", empty or trailing components. Handles are the filesystem's
+ * own; the VFS maps them to its table. read_file and write_file are
+ * optional whole-file fast paths; when 0 the VFS falls back to
+ * open/read/write/close. */
+typedef struct {
+    const char *name;
+    int (*stat)(const char *path, vfs_dir_entry_t *out);
+    int (*iterate)(const char *path, vfs_dir_iter_cb cb, void *context);
+    int (*open)(const char *path, int flags);
+    int (*read)(int handle, uint8_t *buffer, uint32_t length, uint32_t *out_read);
+    int (*write)(int handle, const uint8_t *data, uint32_t length, uint32_t *out_written);
+    int (*seek)(int handle, int offset, int whence, uint32_t *out_position);
+    int (*close)(int handle);
+    int (*mkdir)(const char *path);
+    int (*unlink)(const char *path);
+    int (*read_file)(const char *path, uint8_t *buffer, uint32_t max_size, uint32_t *out_size);
+    int (*write_file)(const char *path, const uint8_t *data, uint32_t size);
+    int (*sync)(void);
+} vfs_ops_t;
+
+void vfs_init(void);
+/* Attach ops at an absolute path. "/" must be mounted first; other mount
+ * points need not exist in the parent filesystem. */
+int vfs_mount(const char *path, const vfs_ops_t *ops);
+int vfs_is_ready(void);
+int vfs_mount_count(void);
+int vfs_get_mount(int index, const char **out_path, const vfs_ops_t **out_ops);
+/* Resolve a path (relative to the cwd) to its mount and mount-relative path */
+int vfs_resolve(const char *path, const vfs_ops_t **out_ops, char *out_path, uint32_t out_size);
+
+int vfs_chdir(const char *path);
+const char *vfs_getcwd(void);
+int vfs_stat(const char *path, vfs_dir_entry_t *out);
+int vfs_iterate(const char *path, vfs_dir_iter_cb cb, void *context);
+int vfs_open(const char *path, int flags);
+int vfs_read(int handle, uint8_t *buffer, uint32_t length, uint32_t *out_read);
+int vfs_write(int handle, const uint8_t *data, uint32_t length, uint32_t *out_written);
+int vfs_seek(int handle, int offset, int whence, uint32_t *out_position);
+int vfs_close(int handle);
+int vfs_mkdir(const char *path);
+int vfs_unlink(const char *path);
+int vfs_read_file(const char *path, uint8_t *buffer, uint32_t max_size, uint32_t *out_size);
+int vfs_write_file(const char *path, const uint8_t *data, uint32_t size);
+int vfs_sync(void);
+void vfs_get_footprint(uint32_t *static_bytes, uint32_t *heap_bytes);
+
+#endif /* FS_VFS_H */
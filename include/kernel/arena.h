@@ -0,0 +1,42 @@
+#ifndef KERNEL_ARENA_H
+#define KERNEL_ARENA_H
+
+#include "../lib/string.h"
+
+/* Bump allocator over heap chunks. Allocations are never freed one by one;
+ * arena_reset() drops them all at once and keeps the first chunk for the
+ * next round. */
+#define ARENA_ALIGN 8
+
+typedef struct arena_chunk {
+    struct arena_chunk *next;
+    uint32_t size;              /* usable bytes after this header */
+    uint32_t used;
+} arena_chunk_t;
+
+typedef struct {
+    arena_chunk_t *head;        /* chunk being bumped; older ones follow */
+    uint32_t chunk_size;
+    uint32_t used;              /* bytes handed out since the last reset */
+    uint32_t high_water;
+    uint32_t chunks;
+    uint32_t backing_bytes;
+    uint32_t resets;
+    uint32_t failed_allocs;
+} arena_t;
+
+typedef struct {
+    uint32_t used;
+    uint32_t high_water;
+    uint32_t chunks;
+    uint32_t backing_bytes;
+    uint32_t resets;
+    uint32_t failed_allocs;
+} arena_stats_t;
+
+void arena_init(arena_t *arena, uint32_t chunk_size);
+void *arena_alloc(arena_t *arena, size_t size);
+void arena_reset(arena_t *arena);
+void arena_get_stats(const arena_t *arena, arena_stats_t *stats);
+
+#endif
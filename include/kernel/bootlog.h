@@ -28,9 +28,24 @@ typedef struct {
     /* Status string (up to 64 chars, NUL-terminated) */
     char status_string[64];
     
-    uint8_t reserved[56];  /* Padding for future use */
+    /* Number of E820 entries stage2 stored at BOOTLOG_E820_ADDR */
+    uint32_t e820_count;
+    
+    uint8_t reserved[52];  /* Padding for future use */
 } bootlog_data_t;
 
+/* Raw INT 15h E820 entries, 24 bytes apart */
+#define BOOTLOG_E820_ADDR 0x620
+#define BOOTLOG_E820_MAX  32
+#define E820_TYPE_USABLE  1
+
+typedef struct __attribute__((packed)) {
+    uint64_t base;
+    uint64_t length;
+    uint32_t type;
+    uint32_t acpi_attributes;
+} bootlog_e820_entry_t;
+
 /* Global bootlog data for kernel access */
 extern bootlog_data_t *bootlog_data;
 
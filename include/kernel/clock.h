@@ -0,0 +1,57 @@
+#ifndef KERNEL_CLOCK_H
+#define KERNEL_CLOCK_H
+
+#include "../lib/string.h"
+
+#define NSEC_PER_SEC   1000000000u
+#define NSEC_PER_MSEC  1000000u
+#define NSEC_PER_USEC  1000u
+
+/* Length of one TSC calibration window */
+#define CLOCK_CALIBRATION_MS 10
+
+/* What the TSC frequency was measured against */
+#define CLOCK_REF_NONE  0
+#define CLOCK_REF_PIT   1
+#define CLOCK_REF_HPET  2
+
+/* A free-running counter; ns = (delta * mult) >> shift. Of the counters
+ * that work, the one with the highest rating backs ktime_ns(). */
+typedef struct {
+    const char *name;
+    uint64_t (*read)(void);
+    uint32_t mult;
+    uint32_t shift;
+    int rating;
+} clocksource_t;
+
+typedef struct {
+    const char *source;         /* clocksource behind ktime_ns(), 0 if none */
+    uint32_t tsc_khz;           /* 0 if calibration failed */
+    int tsc_reference;          /* CLOCK_REF_* */
+    int tsc_invariant;          /* constant rate across P- and C-states */
+    int hpet_available;
+    uint32_t hpet_period_fs;
+    uint32_t hpet_timers;
+} clock_info_t;
+
+static inline uint64_t read_tsc(void) {
+    uint32_t lo;
+    uint32_t hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/* Starts the HPET, calibrates the TSC and picks a clocksource. Needs
+ * acpi_init() for the HPET; returns -1 if no usable counter was found. */
+int clock_init(void);
+/* Monotonic nanoseconds since clock_init(); 0 without a clocksource */
+uint64_t ktime_ns(void);
+/* TSC cycles to nanoseconds; 0 if the TSC was not calibrated */
+uint64_t clock_cycles_to_ns(uint64_t cycles);
+void clock_get_info(clock_info_t *info);
+
+/* 64-by-32 division without libgcc; remainder may be 0 */
+uint64_t div_u64_rem(uint64_t dividend, uint32_t divisor, uint32_t *remainder);
+
+#endif
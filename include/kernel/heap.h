@@ -0,0 +1,41 @@
+#ifndef KERNEL_HEAP_H
+#define KERNEL_HEAP_H
+
+#include "../lib/string.h"
+
+/* Kernel heap on top of the frame allocator. Requests up to
+ * HEAP_MAX_SLAB_SIZE come from per-size-class slabs (one 4 KiB frame
+ * each); larger ones get their own run of contiguous frames. */
+#define HEAP_MIN_CLASS_SHIFT  4         /* 16-byte smallest class */
+#define HEAP_CLASS_COUNT      7         /* 16, 32, ... 1024 */
+#define HEAP_MAX_SLAB_SIZE    1024
+#define HEAP_MAX_LARGE        64        /* live page-backed allocations */
+
+typedef struct {
+    uint32_t object_size;
+    uint32_t slabs;
+    uint32_t objects_in_use;
+    uint32_t objects_total;
+} heap_class_stats_t;
+
+typedef struct {
+    heap_class_stats_t classes[HEAP_CLASS_COUNT];
+    uint32_t slab_pages;
+    uint32_t large_allocations;
+    uint32_t large_pages;
+    uint32_t large_bytes_requested;
+    uint32_t bytes_in_use;      /* slab objects in use + large requests */
+    uint32_t bytes_backed;      /* frames held by the heap */
+    uint32_t alloc_calls;
+    uint32_t free_calls;
+    uint32_t failed_allocs;
+} heap_stats_t;
+
+void *kmalloc(size_t size);
+void *kzalloc(size_t size);
+void kfree(void *ptr);
+void heap_get_stats(heap_stats_t *stats);
+/* The allocator's own bookkeeping, not what it hands out */
+void heap_get_footprint(uint32_t *static_bytes, uint32_t *heap_bytes);
+
+#endif
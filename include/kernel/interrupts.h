@@ -0,0 +1,77 @@
+#ifndef KERNEL_INTERRUPTS_H
+#define KERNEL_INTERRUPTS_H
+
+#include "../lib/string.h"
+
+/* Vectors 0-31 are CPU exceptions; the two 8259 PICs are remapped right
+ * after them so IRQ n arrives on vector IRQ_BASE_VECTOR + n */
+#define IDT_ENTRIES          256
+#define EXCEPTION_COUNT      32
+#define IRQ_BASE_VECTOR      32
+#define IRQ_COUNT            16
+
+#define IRQ_TIMER            0
+#define IRQ_KEYBOARD         1
+#define IRQ_CASCADE          2
+
+/* Delivered by the local APIC, not the PICs */
+#define LAPIC_TIMER_VECTOR    0x40
+#define LAPIC_SPURIOUS_VECTOR 0xFF
+
+#define GDT_KERNEL_CODE      0x08
+#define GDT_KERNEL_DATA      0x10
+
+/* Register state pushed by the stubs in kernel/isr.asm, lowest address first */
+typedef struct {
+    uint32_t gs, fs, es, ds;
+    uint32_t edi, esi, ebp, esp_unused, ebx, edx, ecx, eax;
+    uint32_t vector;
+    uint32_t error_code;        /* 0 for vectors without one */
+    uint32_t eip, cs, eflags;
+} interrupt_frame_t;
+
+typedef void (*irq_handler_t)(interrupt_frame_t *frame);
+
+#define IDLE_METHOD_HLT    0
+#define IDLE_METHOD_MWAIT  1
+
+typedef struct {
+    uint32_t irq_counts[IRQ_COUNT];
+    uint32_t lapic_timer;
+    uint32_t spurious;
+    uint32_t idle_entries;      /* times cpu_idle() halted, i.e. wakeups */
+    uint64_t idle_ns;           /* time spent halted */
+    int idle_method;            /* IDLE_METHOD_* */
+} interrupt_stats_t;
+
+/* Loads a flat GDT and the IDT and remaps the PICs with every line masked.
+ * Interrupts stay disabled until interrupts_enable(). */
+void interrupts_init(void);
+int interrupts_are_ready(void);
+void interrupts_enable(void);
+void interrupts_disable(void);
+/* Disables interrupts and returns the previous EFLAGS for
+ * interrupts_restore(), so callers may nest */
+uint32_t interrupts_save(void);
+void interrupts_restore(uint32_t flags);
+
+/* The handler runs with interrupts disabled; the EOI is sent afterwards */
+void irq_set_handler(int irq, irq_handler_t handler);
+void irq_unmask(int irq);
+void irq_mask(int irq);
+/* Handler for LAPIC_TIMER_VECTOR; it acknowledges the local APIC itself.
+ * With no handler installed the dispatcher sends the EOI. */
+void interrupts_set_timer_handler(irq_handler_t handler);
+
+/* Call with interrupts disabled after finding nothing to do: sti;hlt (or
+ * sti;mwait) cannot be split by an interrupt, so a wakeup between the check
+ * and the halt is not lost. Returns with interrupts disabled again. */
+void cpu_idle(void);
+
+void interrupts_get_stats(interrupt_stats_t *stats);
+const char *exception_name(uint32_t vector);
+
+/* Called from kernel/isr.asm */
+void isr_dispatch(interrupt_frame_t *frame);
+
+#endif
@@ -29,6 +29,20 @@ typedef struct {
     uint16_t vbe_interface_len;
 } multiboot_info_t;
 
+/* Multiboot flags bits for the fields above */
+#define MULTIBOOT_INFO_MEMORY   (1u << 0)
+#define MULTIBOOT_INFO_MEM_MAP  (1u << 6)
+
+/* mmap_addr points at these; size excludes the size field itself */
+typedef struct __attribute__((packed)) {
+    uint32_t size;
+    uint64_t base_addr;
+    uint64_t length;
+    uint32_t type;
+} multiboot_mmap_entry_t;
+
+#define MULTIBOOT_MEMORY_AVAILABLE 1
+
 enum {
     BOOT_MODE_UNKNOWN = 0,
     BOOT_MODE_BIOS = 1,
@@ -38,5 +52,21 @@ enum {
 void kernel_main(void);
 void detect_boot_mode(void);
 const char *get_boot_mode_name(void);
+/* The unused part of the boot stack is filled with a pattern at entry so
+ * the deepest point reached since boot can be read back */
+void kernel_stack_paint(void);
+uint32_t kernel_stack_high_water(void);
+
+/* Section bounds from linker.ld */
+extern uint8_t _kernel_start[];
+extern uint8_t _text_start[];
+extern uint8_t _text_end[];
+extern uint8_t _rodata_start[];
+extern uint8_t _rodata_end[];
+extern uint8_t _data_start[];
+extern uint8_t _data_end[];
+extern uint8_t _bss_start[];
+extern uint8_t _bss_end[];
+extern uint8_t _kernel_end[];
 
 #endif
@@ -0,0 +1,45 @@
+#ifndef KERNEL_PAGING_H
+#define KERNEL_PAGING_H
+
+#include "../lib/string.h"
+
+/* Identity paging. Usable RAM is mapped with global 4 MiB pages; the first
+ * 4 MiB goes through one page table so the legacy VGA/ROM hole can be
+ * uncached. Everything else stays unmapped until a driver asks for it. */
+#define PAGING_LARGE_PAGE_SIZE   0x400000
+#define PAGING_LARGE_PAGE_SHIFT  22
+#define PAGING_PAGE_SIZE         4096
+#define PAGING_DIRECTORY_ENTRIES 1024
+
+/* Cache types for paging_map_identity(); a 4 MiB slot asked for twice keeps
+ * the more restrictive type */
+#define PAGING_CACHE_WB  0
+#define PAGING_CACHE_WC  1   /* needs PAT, otherwise mapped UC */
+#define PAGING_CACHE_UC  2
+
+/* CPU features found by paging_init() */
+#define PAGING_FEATURE_PSE  0x01
+#define PAGING_FEATURE_PGE  0x02
+#define PAGING_FEATURE_PAT  0x04
+
+typedef struct {
+    int enabled;
+    uint32_t features;          /* PAGING_FEATURE_* */
+    uint32_t wb_large_pages;    /* 4 MiB slots by cache type */
+    uint32_t wc_large_pages;
+    uint32_t uc_large_pages;
+    uint32_t low_uc_pages;      /* uncached 4 KiB pages in the first 4 MiB */
+} paging_stats_t;
+
+/* Maps every usable PMM region and turns paging on. Needs pmm_init() and a
+ * CPU with PSE; returns -1 and leaves paging off otherwise. */
+int paging_init(void);
+int paging_is_enabled(void);
+/* May be called before paging_init(): the entries are recorded and take
+ * effect when paging is switched on */
+int paging_map_identity(uint32_t phys, uint32_t size, int cache);
+volatile void *paging_map_mmio(uint32_t phys, uint32_t size);
+void paging_get_stats(paging_stats_t *stats);
+void paging_get_footprint(uint32_t *static_bytes, uint32_t *heap_bytes);
+
+#endif
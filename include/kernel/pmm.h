@@ -0,0 +1,50 @@
+#ifndef KERNEL_PMM_H
+#define KERNEL_PMM_H
+
+#include "main.h"
+
+/* Physical frame allocator. One bit per 4 KiB frame below 4 GiB; the
+ * bitmap itself is carved out of the first usable region that fits. */
+#define PMM_FRAME_SIZE     4096
+#define PMM_FRAME_SHIFT    12
+#define PMM_NO_FRAME       0        /* frame 0 is always reserved */
+#define PMM_MAX_REGIONS    32
+
+/* Stack set up by kernel_entry.asm; it grows down from here */
+#define PMM_STACK_TOP      0x800000
+#define PMM_STACK_RESERVE  0x10000
+
+enum {
+    PMM_SOURCE_NONE = 0,
+    PMM_SOURCE_MULTIBOOT_MMAP,
+    PMM_SOURCE_E820,
+    PMM_SOURCE_MULTIBOOT_MEM,
+    PMM_SOURCE_BOOTLOG_SIZE
+};
+
+typedef struct {
+    uint32_t total_frames;      /* usable frames reported by firmware */
+    uint32_t free_frames;
+    uint32_t reserved_frames;   /* usable but taken by kernel, stack, bitmap */
+    uint32_t region_count;
+    uint32_t highest_address;   /* end of the highest usable region */
+    uint32_t bitmap_bytes;
+    int source;                 /* PMM_SOURCE_* */
+} pmm_stats_t;
+
+/* mbi may be 0 when the kernel was not started by a multiboot loader */
+int pmm_init(const multiboot_info_t *mbi);
+int pmm_is_ready(void);
+uint32_t pmm_alloc_frame(void);
+/* Physically contiguous, returns the first frame's address */
+uint32_t pmm_alloc_frames(uint32_t count);
+void pmm_free_frame(uint32_t address);
+void pmm_free_frames(uint32_t address, uint32_t count);
+void pmm_get_stats(pmm_stats_t *stats);
+/* Usable region [base, end) by index; returns -1 past the last one */
+int pmm_get_region(uint32_t index, uint32_t *base, uint32_t *end);
+const char *pmm_source_name(int source);
+/* The bitmap is carved from free RAM, so it counts as dynamic */
+void pmm_get_footprint(uint32_t *static_bytes, uint32_t *dynamic_bytes);
+
+#endif
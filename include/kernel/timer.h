@@ -0,0 +1,39 @@
+#ifndef KERNEL_TIMER_H
+#define KERNEL_TIMER_H
+
+#include "../lib/string.h"
+
+/* One-shot kernel timers. There is no periodic tick: pending timers are
+ * kept sorted by deadline and the local APIC is armed for the earliest
+ * one only, so an idle CPU is woken by nothing but real events. */
+typedef void (*ktimer_fn_t)(void *arg);
+
+typedef struct ktimer {
+    uint64_t deadline_ns;       /* ktime_ns() value to fire at */
+    ktimer_fn_t fn;             /* runs in interrupt context */
+    void *arg;
+    struct ktimer *next;
+    int pending;
+} ktimer_t;
+
+typedef struct {
+    uint32_t started;
+    uint32_t cancelled;
+    uint32_t fired;
+    uint32_t interrupts;        /* timer interrupts taken */
+    uint32_t early_interrupts;  /* interrupts that found nothing due */
+    uint32_t reprograms;        /* times the hardware deadline changed */
+} timer_stats_t;
+
+/* Needs clock_init() and interrupts_init(); returns -1 without a usable
+ * local APIC timer, in which case timer_sleep_ns() busy-waits */
+int timer_init(void);
+int timer_is_available(void);
+/* Arms t, replacing an earlier arm of the same timer */
+void ktimer_start(ktimer_t *t, uint64_t deadline_ns, ktimer_fn_t fn, void *arg);
+void ktimer_cancel(ktimer_t *t);
+/* Sleeps in cpu_idle() until ns have passed */
+void timer_sleep_ns(uint64_t ns);
+void timer_get_stats(timer_stats_t *stats);
+
+#endif
@@ -4,6 +4,7 @@
 typedef unsigned char uint8_t;
 typedef unsigned short uint16_t;
 typedef unsigned int uint32_t;
+typedef unsigned long long uint64_t;
 typedef signed int int32_t;
 typedef unsigned long size_t;
 typedef unsigned long uintptr_t;
@@ -2,8 +2,11 @@
 #define SHELL_COMMANDS_H
 
 #include "../lib/string.h"
+#include "../kernel/arena.h"
 
 #define FS_IO_BUFFER_SIZE 16384
+/* Scratch memory for one command, released when it returns */
+#define SHELL_SCRATCH_CHUNK_SIZE 32768
 
 void commands_init(void);
 int commands_is_fat_ready(void);
@@ -22,15 +25,28 @@ void handle_cd(const char *args);
 void handle_cat(const char *args);
 void handle_touch(const char *args);
 void handle_write_command(const char *args);
+void handle_append_command(const char *args);
+void handle_frag_command(const char *args);
+void handle_defrag_command(const char *args);
 void handle_mkdir_command(const char *args);
 void handle_rm_command(const char *args);
 void handle_nano_command(const char *args);
+void handle_mount_command(void);
 void handle_theme_command(const char *args);
 void handle_fsstat_command(void);
+void handle_df_command(void);
+void handle_meminfo_command(void);
+void handle_uptime_command(void);
+void handle_time_command(const char *args);
+void handle_sleep_command(const char *args);
+void handle_idlestat_command(void);
 void handle_bootlog_command(void);
 
 const char *fat12_error_string(int code);
+const char *vfs_error_string(int code);
 void print_fs_error(int code);
 uint8_t *commands_get_io_buffer(void);
+void *commands_scratch_alloc(size_t size);
+void commands_get_scratch_stats(arena_stats_t *stats);
 
 #endif
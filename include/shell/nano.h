@@ -2,7 +2,7 @@
 #define SHELL_NANO_H
 
 #include "../lib/string.h"
-#include "../../fat12.h"
+#include "../fs/vfs.h"
 
 #define NANO_MAX_LINES 1000
 #define NANO_MAX_LINE_LENGTH 200
@@ -16,9 +16,10 @@
 
 typedef struct {
     int editor_active;
-    char filename[FAT12_PATH_MAX];
-    char lines[NANO_MAX_LINES][NANO_MAX_LINE_LENGTH];
-    int line_lengths[NANO_MAX_LINES];
+    char filename[VFS_PATH_MAX];
+    /* NANO_MAX_LINES entries each, allocated only while the editor is open */
+    char (*lines)[NANO_MAX_LINE_LENGTH];
+    int *line_lengths;
     int total_lines;
     int cursor_x;
     int cursor_y;
@@ -31,7 +32,8 @@ typedef struct {
 
 void nano_init_state(void);
 int nano_is_active(void);
-void nano_init_editor(const char *filename);
+/* Returns 0, or -1 when the text buffers cannot be allocated */
+int nano_init_editor(const char *filename);
 void nano_render_editor(void);
 void nano_handle_scancode(uint16_t scancode, int is_release);
 int nano_save_file(void);
@@ -50,5 +52,6 @@ void nano_show_help_overlay(void);
 void nano_render_help_overlay(void);
 void nano_set_status_message(const char *msg);
 void nano_reset_status_message(void);
+void nano_get_footprint(uint32_t *static_bytes, uint32_t *heap_bytes);
 
 #endif
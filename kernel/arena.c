@@ -0,0 +1,93 @@
+#include "../include/kernel/arena.h"
+#include "../include/kernel/heap.h"
+
+#define ARENA_HEADER ((sizeof(arena_chunk_t) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+void arena_init(arena_t *arena, uint32_t chunk_size) {
+    arena->head = 0;
+    arena->chunk_size = chunk_size;
+    arena->used = 0;
+    arena->high_water = 0;
+    arena->chunks = 0;
+    arena->backing_bytes = 0;
+    arena->resets = 0;
+    arena->failed_allocs = 0;
+}
+
+/* Requests larger than a chunk get a chunk of their own */
+static arena_chunk_t *arena_grow(arena_t *arena, uint32_t size) {
+    uint32_t usable = arena->chunk_size - (uint32_t)ARENA_HEADER;
+    if (size > usable) {
+        usable = size;
+    }
+    arena_chunk_t *chunk = (arena_chunk_t *)kmalloc(ARENA_HEADER + usable);
+    if (!chunk) {
+        return 0;
+    }
+    chunk->next = arena->head;
+    chunk->size = usable;
+    chunk->used = 0;
+    arena->head = chunk;
+    arena->chunks++;
+    arena->backing_bytes += (uint32_t)ARENA_HEADER + usable;
+    return chunk;
+}
+
+void *arena_alloc(arena_t *arena, size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+    uint32_t rounded = (uint32_t)((size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1));
+    arena_chunk_t *chunk = arena->head;
+    if (!chunk || chunk->size - chunk->used < rounded) {
+        chunk = arena_grow(arena, rounded);
+        if (!chunk) {
+            arena->failed_allocs++;
+            return 0;
+        }
+    }
+    void *ptr = (uint8_t *)chunk + ARENA_HEADER + chunk->used;
+    chunk->used += rounded;
+    arena->used += rounded;
+    if (arena->used > arena->high_water) {
+        arena->high_water = arena->used;
+    }
+    return ptr;
+}
+
+/* Only the oldest chunk is kept, and only if it is a regular one, so a
+ * command that needed an unusually large buffer does not pin it */
+void arena_reset(arena_t *arena) {
+    arena_chunk_t *chunk = arena->head;
+    while (chunk && chunk->next) {
+        arena_chunk_t *next = chunk->next;
+        arena->backing_bytes -= (uint32_t)ARENA_HEADER + chunk->size;
+        arena->chunks--;
+        kfree(chunk);
+        chunk = next;
+    }
+    if (chunk && chunk->size > arena->chunk_size - (uint32_t)ARENA_HEADER) {
+        arena->backing_bytes -= (uint32_t)ARENA_HEADER + chunk->size;
+        arena->chunks--;
+        kfree(chunk);
+        chunk = 0;
+    }
+    if (chunk) {
+        chunk->used = 0;
+    }
+    arena->head = chunk;
+    arena->used = 0;
+    arena->resets++;
+}
+
+void arena_get_stats(const arena_t *arena, arena_stats_t *stats) {
+    if (!stats) {
+        return;
+    }
+    stats->used = arena->used;
+    stats->high_water = arena->high_water;
+    stats->chunks = arena->chunks;
+    stats->backing_bytes = arena->backing_bytes;
+    stats->resets = arena->resets;
+    stats->failed_allocs = arena->failed_allocs;
+}
@@ -18,6 +18,7 @@ void bootlog_init(void) {
         bootlog_data->heads = 0;
         bootlog_data->sectors_per_track = 0;
         bootlog_data->memory_mb = 0;
+        bootlog_data->e820_count = 0;
         bootlog_data->bios_vendor[0] = '\0';
         bootlog_data->status_string[0] = '\0';
     }
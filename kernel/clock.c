@@ -0,0 +1,193 @@
+#include "../include/kernel/clock.h"
+#include "../include/drivers/hpet.h"
+#include "../include/drivers/pit.h"
+
+#define CLOCK_CALIBRATION_RUNS  3
+/* Give up on a reference that does not advance (~seconds of MMIO reads) */
+#define CLOCK_CALIBRATION_SPINS 10000000u
+
+#define CLOCK_RATING_TSC_INVARIANT 300
+#define CLOCK_RATING_HPET          250
+#define CLOCK_RATING_TSC           100
+
+#define FSEC_PER_NSEC  1000000u
+#define FSEC_PER_MSEC  1000000000000ULL
+
+static uint64_t tsc_read(void) {
+    return read_tsc();
+}
+
+static clocksource_t tsc_clocksource = {"tsc", tsc_read, 0, 0, 0};
+static clocksource_t hpet_clocksource = {"hpet", hpet_read_counter, 0, 0, 0};
+static clocksource_t *g_clocksource = 0;
+static uint64_t g_base = 0;
+static uint32_t g_tsc_khz = 0;
+static int g_tsc_reference = CLOCK_REF_NONE;
+static int g_tsc_invariant = 0;
+
+uint64_t div_u64_rem(uint64_t dividend, uint32_t divisor, uint32_t *remainder) {
+    uint32_t high = (uint32_t)(dividend >> 32);
+    uint32_t low = (uint32_t)dividend;
+    uint32_t quotient_high = high / divisor;
+    uint32_t rem = high % divisor;
+    uint32_t quotient_low;
+    /* rem < divisor, so the quotient of rem:low fits in 32 bits */
+    __asm__("divl %4" : "=a"(quotient_low), "=d"(rem) : "a"(low), "d"(rem), "rm"(divisor));
+    if (remainder) {
+        *remainder = rem;
+    }
+    return ((uint64_t)quotient_high << 32) | quotient_low;
+}
+
+/* ns per tick is numer/denom; use the largest shift whose mult fits */
+static void clocksource_set_scale(clocksource_t *cs, uint32_t numer, uint32_t denom) {
+    uint32_t shift = 32;
+    uint64_t mult = div_u64_rem((uint64_t)numer << shift, denom, 0);
+    while (mult > 0xFFFFFFFFull && shift > 0) {
+        shift--;
+        mult = div_u64_rem((uint64_t)numer << shift, denom, 0);
+    }
+    cs->mult = (uint32_t)mult;
+    cs->shift = shift;
+}
+
+static uint64_t clocksource_to_ns(const clocksource_t *cs, uint64_t delta) {
+    uint64_t low = (uint64_t)(uint32_t)delta * cs->mult;
+    uint64_t high = (delta >> 32) * cs->mult;
+    return (high << (32 - cs->shift)) + (low >> cs->shift);
+}
+
+static void cpuid(uint32_t leaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx) {
+    __asm__ volatile("cpuid" : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx) : "a"(leaf), "c"(0));
+}
+
+static int tsc_is_invariant(void) {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(0x80000000u, &eax, &ebx, &ecx, &edx);
+    if (eax < 0x80000007u) {
+        return 0;
+    }
+    cpuid(0x80000007u, &eax, &ebx, &ecx, &edx);
+    return (edx & (1u << 8)) != 0;
+}
+
+/* TSC cycles over one window of HPET time; 0 if the HPET is stuck */
+static uint64_t calibrate_with_hpet(uint32_t *elapsed_ns) {
+    uint32_t period = hpet_period_fs();
+    uint64_t window = div_u64_rem(CLOCK_CALIBRATION_MS * FSEC_PER_MSEC, period, 0);
+    uint64_t start = hpet_read_counter();
+    uint64_t tsc_start = read_tsc();
+    uint64_t now = start;
+    uint32_t spins = 0;
+    while (now - start < window) {
+        if (++spins > CLOCK_CALIBRATION_SPINS) {
+            return 0;
+        }
+        now = hpet_read_counter();
+    }
+    uint64_t cycles = read_tsc() - tsc_start;
+    *elapsed_ns = (uint32_t)div_u64_rem((now - start) * period, FSEC_PER_NSEC, 0);
+    return cycles;
+}
+
+/* Same against a channel 2 one-shot; the window is fixed */
+static uint64_t calibrate_with_pit(uint32_t *elapsed_ns) {
+    uint32_t count = PIT_FREQUENCY_HZ / 1000 * CLOCK_CALIBRATION_MS;
+    uint32_t spins = 0;
+    pit_oneshot_start((uint16_t)count);
+    uint64_t tsc_start = read_tsc();
+    while (!pit_oneshot_expired()) {
+        if (++spins > CLOCK_CALIBRATION_SPINS) {
+            pit_oneshot_stop();
+            return 0;
+        }
+    }
+    uint64_t cycles = read_tsc() - tsc_start;
+    pit_oneshot_stop();
+    *elapsed_ns = (uint32_t)div_u64_rem((uint64_t)count * NSEC_PER_SEC, PIT_FREQUENCY_HZ, 0);
+    return cycles;
+}
+
+/* Keeps the fastest of a few runs: polling delays only ever add cycles */
+static uint32_t calibrate_tsc_khz(uint64_t (*measure)(uint32_t *)) {
+    uint32_t best_khz = 0;
+    for (int run = 0; run < CLOCK_CALIBRATION_RUNS; run++) {
+        uint32_t elapsed_ns = 0;
+        uint64_t cycles = measure(&elapsed_ns);
+        if (cycles == 0 || elapsed_ns == 0) {
+            return 0;
+        }
+        uint32_t khz = (uint32_t)div_u64_rem(cycles * (NSEC_PER_SEC / 1000), elapsed_ns, 0);
+        if (best_khz == 0 || khz < best_khz) {
+            best_khz = khz;
+        }
+    }
+    return best_khz;
+}
+
+static void clock_consider(clocksource_t *cs) {
+    if (!g_clocksource || cs->rating > g_clocksource->rating) {
+        g_clocksource = cs;
+    }
+}
+
+int clock_init(void) {
+    if (g_clocksource) {
+        return 0;
+    }
+    g_tsc_invariant = tsc_is_invariant();
+    if (hpet_init() == 0) {
+        /* A tickless idle CPU may not read a 32-bit counter once per wrap,
+         * so such an HPET only serves to calibrate the TSC */
+        if (hpet_counter_is_64bit()) {
+            clocksource_set_scale(&hpet_clocksource, hpet_period_fs(), FSEC_PER_NSEC);
+            hpet_clocksource.rating = CLOCK_RATING_HPET;
+            clock_consider(&hpet_clocksource);
+        }
+        g_tsc_khz = calibrate_tsc_khz(calibrate_with_hpet);
+        g_tsc_reference = CLOCK_REF_HPET;
+    }
+    if (g_tsc_khz == 0) {
+        g_tsc_khz = calibrate_tsc_khz(calibrate_with_pit);
+        g_tsc_reference = CLOCK_REF_PIT;
+    }
+    if (g_tsc_khz == 0) {
+        g_tsc_reference = CLOCK_REF_NONE;
+    } else {
+        clocksource_set_scale(&tsc_clocksource, NSEC_PER_SEC / 1000, g_tsc_khz);
+        tsc_clocksource.rating = g_tsc_invariant ? CLOCK_RATING_TSC_INVARIANT : CLOCK_RATING_TSC;
+        clock_consider(&tsc_clocksource);
+    }
+    if (!g_clocksource) {
+        return -1;
+    }
+    g_base = g_clocksource->read();
+    return 0;
+}
+
+uint64_t ktime_ns(void) {
+    if (!g_clocksource) {
+        return 0;
+    }
+    return clocksource_to_ns(g_clocksource, g_clocksource->read() - g_base);
+}
+
+uint64_t clock_cycles_to_ns(uint64_t cycles) {
+    if (g_tsc_khz == 0) {
+        return 0;
+    }
+    return clocksource_to_ns(&tsc_clocksource, cycles);
+}
+
+void clock_get_info(clock_info_t *info) {
+    if (!info) {
+        return;
+    }
+    info->source = g_clocksource ? g_clocksource->name : 0;
+    info->tsc_khz = g_tsc_khz;
+    info->tsc_reference = g_tsc_reference;
+    info->tsc_invariant = g_tsc_invariant;
+    info->hpet_available = hpet_is_available();
+    info->hpet_period_fs = hpet_period_fs();
+    info->hpet_timers = hpet_timer_count();
+}
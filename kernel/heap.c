@@ -0,0 +1,261 @@
+#include "../include/kernel/heap.h"
+#include "../include/kernel/pmm.h"
+
+/* A slab is one frame: this header, then capacity objects of one class.
+ * Free objects hold the link to the next free object. */
+#define HEAP_SLAB_MAGIC   0x51AB51ABu
+
+typedef struct heap_slab {
+    uint32_t magic;
+    uint16_t class_index;
+    uint16_t capacity;
+    uint16_t free_count;
+    uint16_t reserved;
+    void *free_list;
+    struct heap_slab *next;
+    struct heap_slab *prev;
+} heap_slab_t;
+
+/* Objects start 16-byte aligned after the header */
+#define HEAP_SLAB_HEADER  ((sizeof(heap_slab_t) + 15) & ~(size_t)15)
+
+typedef struct {
+    heap_slab_t *partial;       /* slabs with at least one free object */
+    heap_slab_t *empty;         /* one fully free slab kept for reuse */
+    uint32_t slabs;
+    uint32_t in_use;
+} heap_class_t;
+
+typedef struct {
+    uint32_t address;           /* 0 = unused entry */
+    uint32_t pages;
+    uint32_t requested;
+} heap_large_t;
+
+static heap_class_t g_classes[HEAP_CLASS_COUNT];
+static heap_large_t g_large[HEAP_MAX_LARGE];
+static uint32_t g_large_count = 0;
+static uint32_t g_alloc_calls = 0;
+static uint32_t g_free_calls = 0;
+static uint32_t g_failed_allocs = 0;
+
+static uint32_t heap_class_size(uint32_t index) {
+    return 1u << (index + HEAP_MIN_CLASS_SHIFT);
+}
+
+static uint32_t heap_class_for(size_t size) {
+    uint32_t index = 0;
+    while (heap_class_size(index) < size) {
+        index++;
+    }
+    return index;
+}
+
+static void heap_unlink(heap_class_t *cls, heap_slab_t *slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        cls->partial = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+    slab->next = 0;
+    slab->prev = 0;
+}
+
+static void heap_push(heap_class_t *cls, heap_slab_t *slab) {
+    slab->prev = 0;
+    slab->next = cls->partial;
+    if (cls->partial) {
+        cls->partial->prev = slab;
+    }
+    cls->partial = slab;
+}
+
+static heap_slab_t *heap_new_slab(uint32_t index) {
+    uint32_t frame = pmm_alloc_frame();
+    if (frame == PMM_NO_FRAME) {
+        return 0;
+    }
+    heap_slab_t *slab = (heap_slab_t *)(uintptr_t)frame;
+    uint32_t size = heap_class_size(index);
+    uint32_t capacity = (PMM_FRAME_SIZE - HEAP_SLAB_HEADER) / size;
+    uint8_t *objects = (uint8_t *)slab + HEAP_SLAB_HEADER;
+
+    slab->magic = HEAP_SLAB_MAGIC;
+    slab->class_index = (uint16_t)index;
+    slab->capacity = (uint16_t)capacity;
+    slab->free_count = (uint16_t)capacity;
+    slab->reserved = 0;
+    slab->next = 0;
+    slab->prev = 0;
+    slab->free_list = objects;
+    for (uint32_t i = 0; i + 1 < capacity; i++) {
+        *(void **)(objects + i * size) = objects + (i + 1) * size;
+    }
+    *(void **)(objects + (capacity - 1) * size) = 0;
+    g_classes[index].slabs++;
+    return slab;
+}
+
+static void *heap_alloc_small(uint32_t index) {
+    heap_class_t *cls = &g_classes[index];
+    heap_slab_t *slab = cls->partial;
+    if (!slab) {
+        slab = cls->empty;
+        cls->empty = 0;
+        if (!slab) {
+            slab = heap_new_slab(index);
+            if (!slab) {
+                return 0;
+            }
+        }
+        heap_push(cls, slab);
+    }
+    void *object = slab->free_list;
+    slab->free_list = *(void **)object;
+    slab->free_count--;
+    if (slab->free_count == 0) {
+        heap_unlink(cls, slab);
+    }
+    cls->in_use++;
+    return object;
+}
+
+static void *heap_alloc_large(size_t size) {
+    if (g_large_count >= HEAP_MAX_LARGE) {
+        return 0;
+    }
+    uint32_t pages = (uint32_t)((size + PMM_FRAME_SIZE - 1) >> PMM_FRAME_SHIFT);
+    uint32_t address = pmm_alloc_frames(pages);
+    if (address == PMM_NO_FRAME) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < HEAP_MAX_LARGE; i++) {
+        if (g_large[i].address == 0) {
+            g_large[i].address = address;
+            g_large[i].pages = pages;
+            g_large[i].requested = (uint32_t)size;
+            g_large_count++;
+            break;
+        }
+    }
+    return (void *)(uintptr_t)address;
+}
+
+void *kmalloc(size_t size) {
+    void *ptr;
+    g_alloc_calls++;
+    if (size == 0) {
+        return 0;
+    }
+    if (size <= HEAP_MAX_SLAB_SIZE) {
+        ptr = heap_alloc_small(heap_class_for(size));
+    } else {
+        ptr = heap_alloc_large(size);
+    }
+    if (!ptr) {
+        g_failed_allocs++;
+    }
+    return ptr;
+}
+
+void *kzalloc(size_t size) {
+    uint8_t *ptr = (uint8_t *)kmalloc(size);
+    if (ptr) {
+        for (size_t i = 0; i < size; i++) {
+            ptr[i] = 0;
+        }
+    }
+    return ptr;
+}
+
+/* Slab objects never start on a frame boundary (the header is there), so a
+ * frame-aligned pointer can only be a large allocation */
+void kfree(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    g_free_calls++;
+    uint32_t address = (uint32_t)(uintptr_t)ptr;
+    uint32_t offset = address & (PMM_FRAME_SIZE - 1);
+
+    if (offset == 0) {
+        for (uint32_t i = 0; i < HEAP_MAX_LARGE; i++) {
+            if (g_large[i].address == address) {
+                pmm_free_frames(address, g_large[i].pages);
+                g_large[i].address = 0;
+                g_large_count--;
+                return;
+            }
+        }
+        return;
+    }
+
+    heap_slab_t *slab = (heap_slab_t *)(uintptr_t)(address - offset);
+    if (slab->magic != HEAP_SLAB_MAGIC || slab->class_index >= HEAP_CLASS_COUNT) {
+        return;
+    }
+    uint32_t size = heap_class_size(slab->class_index);
+    if (offset < HEAP_SLAB_HEADER || (offset - HEAP_SLAB_HEADER) % size != 0 ||
+        slab->free_count >= slab->capacity) {
+        return;
+    }
+
+    heap_class_t *cls = &g_classes[slab->class_index];
+    *(void **)ptr = slab->free_list;
+    slab->free_list = ptr;
+    slab->free_count++;
+    cls->in_use--;
+    if (slab->free_count == 1) {
+        heap_push(cls, slab);
+    }
+    if (slab->free_count == slab->capacity) {
+        heap_unlink(cls, slab);
+        if (!cls->empty) {
+            cls->empty = slab;
+        } else {
+            slab->magic = 0;
+            cls->slabs--;
+            pmm_free_frame(address - offset);
+        }
+    }
+}
+
+void heap_get_stats(heap_stats_t *stats) {
+    if (!stats) {
+        return;
+    }
+    stats->slab_pages = 0;
+    stats->bytes_in_use = 0;
+    for (uint32_t i = 0; i < HEAP_CLASS_COUNT; i++) {
+        uint32_t size = heap_class_size(i);
+        uint32_t capacity = (PMM_FRAME_SIZE - HEAP_SLAB_HEADER) / size;
+        stats->classes[i].object_size = size;
+        stats->classes[i].slabs = g_classes[i].slabs;
+        stats->classes[i].objects_in_use = g_classes[i].in_use;
+        stats->classes[i].objects_total = g_classes[i].slabs * capacity;
+        stats->slab_pages += g_classes[i].slabs;
+        stats->bytes_in_use += g_classes[i].in_use * size;
+    }
+    stats->large_allocations = g_large_count;
+    stats->large_pages = 0;
+    stats->large_bytes_requested = 0;
+    for (uint32_t i = 0; i < HEAP_MAX_LARGE; i++) {
+        if (g_large[i].address != 0) {
+            stats->large_pages += g_large[i].pages;
+            stats->large_bytes_requested += g_large[i].requested;
+        }
+    }
+    stats->bytes_in_use += stats->large_bytes_requested;
+    stats->bytes_backed = (stats->slab_pages + stats->large_pages) << PMM_FRAME_SHIFT;
+    stats->alloc_calls = g_alloc_calls;
+    stats->free_calls = g_free_calls;
+    stats->failed_allocs = g_failed_allocs;
+}
+
+void heap_get_footprint(uint32_t *static_bytes, uint32_t *heap_bytes) {
+    *static_bytes = sizeof(g_classes) + sizeof(g_large);
+    *heap_bytes = 0;
+}
@@ -0,0 +1,318 @@
+#include "../include/kernel/interrupts.h"
+#include "../include/drivers/console.h"
+#include "../include/kernel/clock.h"
+#include "../include/drivers/lapic.h"
+
+#define PIC1_COMMAND  0x20
+#define PIC1_DATA     0x21
+#define PIC2_COMMAND  0xA0
+#define PIC2_DATA     0xA1
+#define PIC_EOI       0x20
+#define PIC_READ_ISR  0x0B
+#define ICW1_INIT     0x11      /* edge triggered, cascaded, ICW4 follows */
+#define ICW4_8086     0x01
+
+#define IDT_GATE_INTERRUPT 0x8E /* present, ring 0, 32-bit interrupt gate */
+#define EFLAGS_IF          0x200
+
+typedef struct __attribute__((packed)) {
+    uint16_t offset_low;
+    uint16_t selector;
+    uint8_t zero;
+    uint8_t type_attr;
+    uint16_t offset_high;
+} idt_entry_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t limit;
+    uint32_t base;
+} descriptor_pointer_t;
+
+/* Entry points in kernel/isr.asm, one per exception and IRQ vector */
+extern uint32_t isr_stub_table[EXCEPTION_COUNT + IRQ_COUNT];
+extern void isr_stub_64(void);
+extern void isr_stub_255(void);
+extern void halt_cpu(void);
+
+/* Null, flat ring-0 code, flat ring-0 data. The loader's GDT may sit in
+ * memory the frame allocator hands out, so the kernel keeps its own. */
+static const uint64_t g_gdt[3] = {
+    0x0000000000000000ULL,
+    0x00CF9A000000FFFFULL,
+    0x00CF92000000FFFFULL,
+};
+
+static idt_entry_t g_idt[IDT_ENTRIES];
+static irq_handler_t g_irq_handlers[IRQ_COUNT];
+static irq_handler_t g_timer_handler = 0;
+static interrupt_stats_t g_stats;
+static uint16_t g_irq_mask = 0xFFFF;
+static int g_ready = 0;
+/* Target of MONITOR; with one CPU only an interrupt ends the wait */
+static volatile uint32_t g_idle_monitor = 0;
+
+static const char *const g_exception_names[EXCEPTION_COUNT] = {
+    "Divide error", "Debug", "NMI", "Breakpoint",
+    "Overflow", "BOUND range exceeded", "Invalid opcode", "Device not available",
+    "Double fault", "Coprocessor segment overrun", "Invalid TSS", "Segment not present",
+    "Stack-segment fault", "General protection fault", "Page fault", "Reserved",
+    "x87 floating-point error", "Alignment check", "Machine check", "SIMD floating-point error",
+    "Virtualization exception", "Control protection exception", "Reserved", "Reserved",
+    "Reserved", "Reserved", "Reserved", "Reserved",
+    "Hypervisor injection", "VMM communication", "Security exception", "Reserved",
+};
+
+const char *exception_name(uint32_t vector) {
+    if (vector < EXCEPTION_COUNT) {
+        return g_exception_names[vector];
+    }
+    return "Unknown";
+}
+
+static void io_wait(void) {
+    outb(0x80, 0);
+}
+
+static void print_hex32(uint32_t value) {
+    static const char digits[] = "0123456789ABCDEF";
+    console_print("0x");
+    for (int shift = 28; shift >= 0; shift -= 4) {
+        console_putchar(digits[(value >> shift) & 0xF]);
+    }
+}
+
+static void gdt_load(void) {
+    descriptor_pointer_t gdtr;
+    gdtr.limit = sizeof(g_gdt) - 1;
+    gdtr.base = (uint32_t)(uintptr_t)g_gdt;
+    __asm__ volatile(
+        "lgdt %0\n\t"
+        "ljmp %1, $1f\n"
+        "1:\n\t"
+        "mov %2, %%ax\n\t"
+        "mov %%ax, %%ds\n\t"
+        "mov %%ax, %%es\n\t"
+        "mov %%ax, %%fs\n\t"
+        "mov %%ax, %%gs\n\t"
+        "mov %%ax, %%ss\n\t"
+        : : "m"(gdtr), "i"(GDT_KERNEL_CODE), "i"(GDT_KERNEL_DATA) : "eax", "memory");
+}
+
+static void idt_set_gate(uint32_t vector, uint32_t handler) {
+    g_idt[vector].offset_low = (uint16_t)(handler & 0xFFFF);
+    g_idt[vector].selector = GDT_KERNEL_CODE;
+    g_idt[vector].zero = 0;
+    g_idt[vector].type_attr = IDT_GATE_INTERRUPT;
+    g_idt[vector].offset_high = (uint16_t)(handler >> 16);
+}
+
+static void pic_write_mask(void) {
+    outb(PIC1_DATA, (uint8_t)(g_irq_mask & 0xFF));
+    outb(PIC2_DATA, (uint8_t)(g_irq_mask >> 8));
+}
+
+/* The BIOS leaves the master PIC on vectors 8-15, on top of the CPU
+ * exceptions; move both controllers to 32-47 */
+static void pic_remap(void) {
+    outb(PIC1_COMMAND, ICW1_INIT);
+    io_wait();
+    outb(PIC2_COMMAND, ICW1_INIT);
+    io_wait();
+    outb(PIC1_DATA, IRQ_BASE_VECTOR);
+    io_wait();
+    outb(PIC2_DATA, IRQ_BASE_VECTOR + 8);
+    io_wait();
+    outb(PIC1_DATA, 1u << IRQ_CASCADE);
+    io_wait();
+    outb(PIC2_DATA, IRQ_CASCADE);
+    io_wait();
+    outb(PIC1_DATA, ICW4_8086);
+    io_wait();
+    outb(PIC2_DATA, ICW4_8086);
+    io_wait();
+    g_irq_mask = 0xFFFF & ~(1u << IRQ_CASCADE);
+    pic_write_mask();
+}
+
+static uint16_t pic_read_isr(void) {
+    outb(PIC1_COMMAND, PIC_READ_ISR);
+    outb(PIC2_COMMAND, PIC_READ_ISR);
+    return (uint16_t)(inb(PIC1_COMMAND) | (inb(PIC2_COMMAND) << 8));
+}
+
+void interrupts_init(void) {
+    if (g_ready) {
+        return;
+    }
+    gdt_load();
+    for (uint32_t vector = 0; vector < EXCEPTION_COUNT + IRQ_COUNT; vector++) {
+        idt_set_gate(vector, isr_stub_table[vector]);
+    }
+    idt_set_gate(LAPIC_TIMER_VECTOR, (uint32_t)(uintptr_t)isr_stub_64);
+    idt_set_gate(LAPIC_SPURIOUS_VECTOR, (uint32_t)(uintptr_t)isr_stub_255);
+    descriptor_pointer_t idtr;
+    idtr.limit = sizeof(g_idt) - 1;
+    idtr.base = (uint32_t)(uintptr_t)g_idt;
+    __asm__ volatile("lidt %0" : : "m"(idtr));
+    pic_remap();
+
+    uint32_t eax = 1, ebx, ecx, edx;
+    __asm__ volatile("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    g_stats.idle_method = (ecx & (1u << 3)) ? IDLE_METHOD_MWAIT : IDLE_METHOD_HLT;
+    g_ready = 1;
+}
+
+int interrupts_are_ready(void) {
+    return g_ready;
+}
+
+void interrupts_enable(void) {
+    if (g_ready) {
+        __asm__ volatile("sti" : : : "memory");
+    }
+}
+
+void interrupts_disable(void) {
+    __asm__ volatile("cli" : : : "memory");
+}
+
+uint32_t interrupts_save(void) {
+    uint32_t flags;
+    __asm__ volatile("pushfl\n\tpopl %0\n\tcli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+void interrupts_restore(uint32_t flags) {
+    if (flags & EFLAGS_IF) {
+        __asm__ volatile("sti" : : : "memory");
+    }
+}
+
+void interrupts_set_timer_handler(irq_handler_t handler) {
+    g_timer_handler = handler;
+}
+
+void irq_set_handler(int irq, irq_handler_t handler) {
+    if (irq >= 0 && irq < IRQ_COUNT) {
+        g_irq_handlers[irq] = handler;
+    }
+}
+
+void irq_unmask(int irq) {
+    if (irq < 0 || irq >= IRQ_COUNT) {
+        return;
+    }
+    g_irq_mask &= (uint16_t)~(1u << irq);
+    pic_write_mask();
+}
+
+void irq_mask(int irq) {
+    if (irq < 0 || irq >= IRQ_COUNT || irq == IRQ_CASCADE) {
+        return;
+    }
+    g_irq_mask |= (uint16_t)(1u << irq);
+    pic_write_mask();
+}
+
+void cpu_idle(void) {
+    if (!g_ready) {
+        return;
+    }
+    uint64_t start = ktime_ns();
+    g_stats.idle_entries++;
+    if (g_stats.idle_method == IDLE_METHOD_MWAIT) {
+        /* C1 hint; MWAIT honours the STI shadow just like HLT */
+        __asm__ volatile("monitor" : : "a"(&g_idle_monitor), "c"(0), "d"(0));
+        __asm__ volatile("sti\n\tmwait\n\tcli" : : "a"(0), "c"(0) : "memory");
+    } else {
+        __asm__ volatile("sti\n\thlt\n\tcli" : : : "memory");
+    }
+    g_stats.idle_ns += ktime_ns() - start;
+}
+
+void interrupts_get_stats(interrupt_stats_t *stats) {
+    if (stats) {
+        *stats = g_stats;
+    }
+}
+
+static void exception_panic(interrupt_frame_t *frame) {
+    console_print("\n*** CPU exception ");
+    print_unsigned(frame->vector);
+    console_print(": ");
+    console_print(exception_name(frame->vector));
+    console_print(" ***\n  EIP ");
+    print_hex32(frame->eip);
+    console_print("  error ");
+    print_hex32(frame->error_code);
+    console_print("  EFLAGS ");
+    print_hex32(frame->eflags);
+    if (frame->vector == 14) {
+        uint32_t cr2;
+        __asm__ volatile("mov %%cr2, %0" : "=r"(cr2));
+        console_print("\n  fault address ");
+        print_hex32(cr2);
+    }
+    console_print("\n  EAX ");
+    print_hex32(frame->eax);
+    console_print("  EBX ");
+    print_hex32(frame->ebx);
+    console_print("  ECX ");
+    print_hex32(frame->ecx);
+    console_print("  EDX ");
+    print_hex32(frame->edx);
+    console_print("\n  ESI ");
+    print_hex32(frame->esi);
+    console_print("  EDI ");
+    print_hex32(frame->edi);
+    console_print("  EBP ");
+    print_hex32(frame->ebp);
+    console_print("\nSystem halted.\n");
+    halt_cpu();
+}
+
+void isr_dispatch(interrupt_frame_t *frame) {
+    if (frame->vector < EXCEPTION_COUNT) {
+        exception_panic(frame);
+        return;
+    }
+    /* The local APIC expects no EOI for its spurious vector */
+    if (frame->vector == LAPIC_SPURIOUS_VECTOR) {
+        g_stats.spurious++;
+        return;
+    }
+    if (frame->vector == LAPIC_TIMER_VECTOR) {
+        g_stats.lapic_timer++;
+        if (g_timer_handler) {
+            g_timer_handler(frame);
+        } else {
+            /* Nobody to acknowledge it; without an EOI the in-service bit
+             * stays set and blocks every lower-priority vector */
+            lapic_eoi();
+        }
+        return;
+    }
+    int irq = (int)(frame->vector - IRQ_BASE_VECTOR);
+    if (irq < 0 || irq >= IRQ_COUNT) {
+        return;
+    }
+    /* IRQ 7 and 15 also show up when a request goes away before it is
+     * acknowledged; the in-service bit tells the two apart */
+    if (irq == 7 || irq == 15) {
+        if ((pic_read_isr() & (1u << irq)) == 0) {
+            g_stats.spurious++;
+            if (irq == 15) {
+                outb(PIC1_COMMAND, PIC_EOI);
+            }
+            return;
+        }
+    }
+    g_stats.irq_counts[irq]++;
+    if (g_irq_handlers[irq]) {
+        g_irq_handlers[irq](frame);
+    }
+    if (irq >= 8) {
+        outb(PIC2_COMMAND, PIC_EOI);
+    }
+    outb(PIC1_COMMAND, PIC_EOI);
+}
@@ -1,18 +1,45 @@
 #include "../include/kernel/main.h"
 #include "../include/kernel/bootlog.h"
+#include "../include/kernel/pmm.h"
+#include "../include/kernel/paging.h"
+#include "../include/kernel/interrupts.h"
+#include "../include/kernel/clock.h"
+#include "../include/kernel/timer.h"
+#include "../include/drivers/lapic.h"
 #include "../include/drivers/console.h"
 #include "../include/drivers/keyboard.h"
 #include "../include/drivers/storage/block_device.h"
+#include "../include/drivers/pci.h"
+#include "../include/drivers/acpi.h"
 #include "../include/shell/prompt.h"
 #include "../include/shell/commands.h"
 #include "../disk.h"
 #include "../fat12.h"
+#include "../include/fs/vfs.h"
+#include "../include/fs/fatfs.h"
+#include "../include/fs/ramfs.h"
 
 extern uint32_t multiboot_magic_storage;
 extern uint32_t multiboot_info_ptr_storage;
 
 static int boot_mode = BOOT_MODE_UNKNOWN;
 
+/* Boot phases are timed with the TSC from the first instruction on and
+ * converted once the clock has been calibrated */
+static void print_boot_duration(unsigned long long cycles) {
+    uint64_t ns = clock_cycles_to_ns(cycles);
+    if (ns == 0) {
+        print_unsigned((uint32_t)(cycles >> 10));
+        console_print(" Kcycles");
+        return;
+    }
+    uint32_t us = (uint32_t)div_u64_rem(ns, NSEC_PER_USEC, 0);
+    print_unsigned(us / 1000);
+    console_print(".");
+    print_unsigned((us % 1000) / 100);
+    console_print(" ms");
+}
+
 void detect_boot_mode(void) {
     boot_mode = BOOT_MODE_BIOS;
     if (multiboot_magic_storage != MULTIBOOT_BOOTLOADER_MAGIC) {
@@ -39,7 +66,30 @@ const char *get_boot_mode_name(void) {
     }
 }
 
+#define STACK_PAINT_PATTERN 0x5A5AA5A5u
+
+void kernel_stack_paint(void) {
+    uint32_t esp;
+    __asm__ volatile("mov %%esp, %0" : "=r"(esp));
+    /* Leave a margin below the live frame */
+    uint32_t *limit = (uint32_t *)(uintptr_t)((esp - 64) & ~3u);
+    for (uint32_t *word = (uint32_t *)(PMM_STACK_TOP - PMM_STACK_RESERVE); word < limit; word++) {
+        *word = STACK_PAINT_PATTERN;
+    }
+}
+
+uint32_t kernel_stack_high_water(void) {
+    const uint32_t *word = (const uint32_t *)(PMM_STACK_TOP - PMM_STACK_RESERVE);
+    while ((uint32_t)(uintptr_t)word < PMM_STACK_TOP && *word == STACK_PAINT_PATTERN) {
+        word++;
+    }
+    return PMM_STACK_TOP - (uint32_t)(uintptr_t)word;
+}
+
 void kernel_main(void) {
+    kernel_stack_paint();
+    unsigned long long boot_start = read_tsc();
+    unsigned long long mount_cycles = 0;
     detect_boot_mode();
     bootlog_init();
     vga_clear();
@@ -48,6 +98,55 @@ void kernel_main(void) {
     console_print("Boot mode: ");
     console_print(get_boot_mode_name());
     console_print("\n");
+
+    /* Exceptions from here on print a register dump instead of resetting */
+    console_print("Installing interrupt handlers... ");
+    interrupts_init();
+    console_print("OK (PIC at vectors 32-47)\n");
+    
+    console_print("Locating ACPI tables... ");
+    if (acpi_init() == 0) {
+        console_print("OK (ACPI revision ");
+        print_unsigned(acpi_get_rsdp()->revision);
+        console_print(")\n");
+    } else {
+        console_print("not found\n");
+    }
+
+    console_print("Calibrating clock... ");
+    if (clock_init() == 0) {
+        clock_info_t clock_info;
+        clock_get_info(&clock_info);
+        console_print("OK (");
+        console_print(clock_info.source);
+        if (clock_info.tsc_khz != 0) {
+            console_print(", TSC ");
+            print_unsigned(clock_info.tsc_khz / 1000);
+            console_print(" MHz via ");
+            console_print(clock_info.tsc_reference == CLOCK_REF_HPET ? "HPET" : "PIT");
+            if (!clock_info.tsc_invariant) {
+                console_print(", not invariant");
+            }
+        }
+        console_print(")\n");
+    } else {
+        console_print("FAILED (no usable timer)\n");
+    }
+
+    /* No periodic tick: IRQ 0 stays masked and the local APIC is armed
+     * only for the next pending deadline */
+    console_print("Starting one-shot timer... ");
+    if (timer_init() == 0) {
+        if (lapic_timer_mode() == LAPIC_TIMER_TSC_DEADLINE) {
+            console_print("OK (local APIC, TSC-deadline)\n");
+        } else {
+            console_print("OK (local APIC, one-shot at ");
+            print_unsigned(lapic_timer_khz());
+            console_print(" kHz)\n");
+        }
+    } else {
+        console_print("unavailable (no local APIC)\n");
+    }
     
     console_print("Initializing storage manager... ");
     int storage_devices = storage_manager_init();
@@ -55,6 +154,17 @@ void kernel_main(void) {
     print_decimal(storage_devices);
     console_print(" device(s) detected)\n");
     
+    pci_scan_stats_t pci_stats;
+    pci_get_scan_stats(&pci_stats);
+    console_print("PCI scan: ");
+    print_unsigned(pci_stats.functions_found);
+    console_print(" function(s) on ");
+    print_unsigned(pci_stats.buses_scanned);
+    console_print(" bus(es), ");
+    print_unsigned(pci_stats.config_reads);
+    console_print(" config reads via ");
+    console_print(pci_stats.ecam_regions > 0 ? "ECAM\n" : "mechanism 1\n");
+    
     if (boot_mode == BOOT_MODE_BIOS && bootlog_data->boot_method == 2) {
         console_print("\nFATAL: Disk read error during boot (status 0x");
         char hex[3];
@@ -93,6 +203,45 @@ void kernel_main(void) {
         console_print(" MB\n");
     }
     
+    const multiboot_info_t *mbi = 0;
+    if (multiboot_magic_storage == MULTIBOOT_BOOTLOADER_MAGIC) {
+        mbi = (const multiboot_info_t *)(uintptr_t)multiboot_info_ptr_storage;
+    }
+    console_print("Initializing physical memory... ");
+    if (pmm_init(mbi) == 0) {
+        pmm_stats_t pmm_stats;
+        pmm_get_stats(&pmm_stats);
+        console_print("OK (");
+        print_unsigned(pmm_stats.total_frames * (PMM_FRAME_SIZE / 1024));
+        console_print(" KB usable, ");
+        print_unsigned(pmm_stats.free_frames * (PMM_FRAME_SIZE / 1024));
+        console_print(" KB free, from ");
+        console_print(pmm_source_name(pmm_stats.source));
+        console_print(")\n");
+    } else {
+        console_print("FAILED (no memory map)\n");
+    }
+
+    console_print("Enabling paging... ");
+    if (paging_init() == 0) {
+        paging_stats_t paging_stats;
+        paging_get_stats(&paging_stats);
+        console_print("OK (");
+        print_unsigned(paging_stats.wb_large_pages);
+        console_print(" x 4 MiB RAM, ");
+        print_unsigned(paging_stats.uc_large_pages);
+        console_print(" x 4 MiB MMIO");
+        if (paging_stats.features & PAGING_FEATURE_PGE) {
+            console_print(", global");
+        }
+        if (paging_stats.features & PAGING_FEATURE_PAT) {
+            console_print(", PAT");
+        }
+        console_print(")\n");
+    } else {
+        console_print("skipped (no PSE or memory map)\n");
+    }
+    
     console_print("Initializing disk driver... ");
     int disk_result = disk_init();
     if (disk_result != 0) {
@@ -153,9 +302,14 @@ void kernel_main(void) {
         }
     }
     
+    commands_init();
+    vfs_init();
+    ramfs_init();
     if (disk_result == 0) {
-        console_print("Initializing FAT12 filesystem... ");
-        int fat_result = fat12_init(0);
+        console_print("Initializing FAT filesystem... ");
+        unsigned long long mount_start = read_tsc();
+        int fat_result = fat12_mount(0, FAT12_MOUNT_LAZY);
+        mount_cycles = read_tsc() - mount_start;
         if (fat_result != FAT12_OK) {
             console_print("FAILED (");
             console_print(fat12_error_string(fat_result));
@@ -165,12 +319,28 @@ void kernel_main(void) {
         } else {
             console_print("OK\n");
             commands_set_fat_ready(1);
+            vfs_mount("/", fatfs_get_ops());
             console_print("Mounted volume at ");
-            console_print(fat12_get_cwd());
+            console_print(vfs_getcwd());
             console_print("\n");
         }
     }
+    /* Scratch files live in RAM; without a disk the ramfs becomes the root */
+    const char *ramfs_path = vfs_is_ready() ? "/tmp" : "/";
+    if (vfs_mount(ramfs_path, ramfs_get_ops()) == VFS_OK) {
+        console_print("Mounted ramfs at ");
+        console_print(ramfs_path);
+        console_print("\n");
+    }
     
+    keyboard_enable_irq();
+    interrupts_enable();
+
+    console_print("Time to prompt: ");
+    print_boot_duration(read_tsc() - boot_start);
+    console_print(" (mount ");
+    print_boot_duration(mount_cycles);
+    console_print(")\n");
     console_print("Type 'help' for available commands\n\n");
     
     while (1) {
@@ -178,12 +348,11 @@ void kernel_main(void) {
         render_prompt_line();
         
         while (1) {
-            if (keyboard_ready()) {
-                handle_keyboard_input();
-                if (prompt_command_executed()) {
-                    prompt_clear_executed_flag();
-                    break;
-                }
+            /* Halts until IRQ 1 queues a scancode */
+            handle_keyboard_input();
+            if (prompt_command_executed()) {
+                prompt_clear_executed_flag();
+                break;
             }
         }
     }
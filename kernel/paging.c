@@ -0,0 +1,215 @@
+#include "../include/kernel/paging.h"
+#include "../include/kernel/pmm.h"
+
+#define PTE_PRESENT  0x001
+#define PTE_WRITE    0x002
+#define PTE_PWT      0x008
+#define PTE_PCD      0x010
+#define PDE_LARGE    0x080
+#define PTE_GLOBAL   0x100
+
+#define CR0_PG       0x80000000u
+#define CR4_PSE      0x00000010u
+#define CR4_PGE      0x00000080u
+
+#define MSR_IA32_PAT 0x277
+/* Power-on PAT with entry 1 (PWT alone) turned from write-through into
+ * write-combining: WB, WC, UC-, UC in both halves */
+#define PAT_VALUE_LOW   0x00070106u
+#define PAT_VALUE_HIGH  0x00070106u
+
+/* VGA memory and option/BIOS ROMs */
+#define PAGING_LEGACY_HOLE_START 0xA0000
+#define PAGING_LEGACY_HOLE_END   0x100000
+
+static uint32_t g_page_directory[PAGING_DIRECTORY_ENTRIES] __attribute__((aligned(4096)));
+static uint32_t g_low_table[PAGING_DIRECTORY_ENTRIES] __attribute__((aligned(4096)));
+static uint32_t g_features = 0;
+static int g_features_known = 0;
+static int g_low_ready = 0;
+static int g_enabled = 0;
+
+static void paging_detect_features(void) {
+    if (g_features_known) {
+        return;
+    }
+    uint32_t eax = 1, ebx, ecx, edx;
+    __asm__ volatile("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    g_features = 0;
+    if (edx & (1u << 3)) {
+        g_features |= PAGING_FEATURE_PSE;
+    }
+    if (edx & (1u << 13)) {
+        g_features |= PAGING_FEATURE_PGE;
+    }
+    if (edx & (1u << 16)) {
+        g_features |= PAGING_FEATURE_PAT;
+    }
+    g_features_known = 1;
+}
+
+static uint32_t paging_cache_bits(int cache) {
+    switch (cache) {
+        case PAGING_CACHE_WC: return PTE_PWT;
+        case PAGING_CACHE_UC: return PTE_PCD | PTE_PWT;
+        default: return 0;
+    }
+}
+
+/* Cache type of a present entry, -1 if not present */
+static int paging_entry_cache(uint32_t entry) {
+    if ((entry & PTE_PRESENT) == 0) {
+        return -1;
+    }
+    if (entry & PTE_PCD) {
+        return PAGING_CACHE_UC;
+    }
+    return (entry & PTE_PWT) ? PAGING_CACHE_WC : PAGING_CACHE_WB;
+}
+
+static void paging_invalidate(uint32_t address) {
+    if (g_enabled) {
+        __asm__ volatile("invlpg (%0)" : : "r"(address) : "memory");
+    }
+}
+
+/* The first 4 MiB holds the kernel, the boot data at 0x500 and the legacy
+ * hole, so it is always mapped, one 4 KiB page at a time */
+static void paging_low_init(void) {
+    if (g_low_ready) {
+        return;
+    }
+    for (uint32_t i = 0; i < PAGING_DIRECTORY_ENTRIES; i++) {
+        uint32_t address = i * PAGING_PAGE_SIZE;
+        uint32_t entry = address | PTE_PRESENT | PTE_WRITE | PTE_GLOBAL;
+        if (address >= PAGING_LEGACY_HOLE_START && address < PAGING_LEGACY_HOLE_END) {
+            entry |= paging_cache_bits(PAGING_CACHE_UC);
+        }
+        g_low_table[i] = entry;
+    }
+    g_page_directory[0] = (uint32_t)(uintptr_t)g_low_table | PTE_PRESENT | PTE_WRITE;
+    g_low_ready = 1;
+}
+
+static void paging_set_entry(uint32_t *entry, uint32_t address, uint32_t flags, int cache) {
+    if (paging_entry_cache(*entry) >= cache) {
+        return;
+    }
+    *entry = address | flags | PTE_PRESENT | PTE_WRITE | PTE_GLOBAL | paging_cache_bits(cache);
+    paging_invalidate(address);
+}
+
+int paging_map_identity(uint32_t phys, uint32_t size, int cache) {
+    if (size == 0) {
+        return 0;
+    }
+    unsigned long long end = (unsigned long long)phys + size;
+    if (end > 0x100000000ULL) {
+        return -1;
+    }
+    paging_detect_features();
+    paging_low_init();
+    if (cache == PAGING_CACHE_WC && (g_features & PAGING_FEATURE_PAT) == 0) {
+        cache = PAGING_CACHE_UC;
+    }
+
+    uint32_t last = (uint32_t)(end - 1);
+    uint32_t first_slot = phys >> PAGING_LARGE_PAGE_SHIFT;
+    uint32_t last_slot = last >> PAGING_LARGE_PAGE_SHIFT;
+    if (first_slot == 0) {
+        uint32_t low_last = (last_slot == 0) ? last : PAGING_LARGE_PAGE_SIZE - 1;
+        for (uint32_t page = phys / PAGING_PAGE_SIZE; page <= low_last / PAGING_PAGE_SIZE; page++) {
+            paging_set_entry(&g_low_table[page], page * PAGING_PAGE_SIZE, 0, cache);
+        }
+        first_slot = 1;
+    }
+    for (uint32_t slot = first_slot; slot <= last_slot; slot++) {
+        paging_set_entry(&g_page_directory[slot], slot << PAGING_LARGE_PAGE_SHIFT, PDE_LARGE, cache);
+        if (slot == PAGING_DIRECTORY_ENTRIES - 1) {
+            break;
+        }
+    }
+    return 0;
+}
+
+volatile void *paging_map_mmio(uint32_t phys, uint32_t size) {
+    if (paging_map_identity(phys, size, PAGING_CACHE_UC) != 0) {
+        return 0;
+    }
+    return (volatile void *)(uintptr_t)phys;
+}
+
+int paging_init(void) {
+    if (g_enabled) {
+        return 0;
+    }
+    paging_detect_features();
+    if (!pmm_is_ready() || (g_features & PAGING_FEATURE_PSE) == 0) {
+        return -1;
+    }
+    paging_low_init();
+    uint32_t base;
+    uint32_t end;
+    for (uint32_t i = 0; pmm_get_region(i, &base, &end) == 0; i++) {
+        paging_map_identity(base, end - base, PAGING_CACHE_WB);
+    }
+    paging_map_identity(PMM_STACK_TOP - PMM_STACK_RESERVE, PMM_STACK_RESERVE, PAGING_CACHE_WB);
+
+    if (g_features & PAGING_FEATURE_PAT) {
+        __asm__ volatile("wbinvd" : : : "memory");
+        __asm__ volatile("wrmsr" : : "c"(MSR_IA32_PAT), "a"(PAT_VALUE_LOW), "d"(PAT_VALUE_HIGH));
+    }
+
+    uint32_t cr4;
+    __asm__ volatile("mov %%cr4, %0" : "=r"(cr4));
+    cr4 |= CR4_PSE;
+    __asm__ volatile("mov %0, %%cr4" : : "r"(cr4));
+    __asm__ volatile("mov %0, %%cr3" : : "r"((uint32_t)(uintptr_t)g_page_directory) : "memory");
+    uint32_t cr0;
+    __asm__ volatile("mov %%cr0, %0" : "=r"(cr0));
+    cr0 |= CR0_PG;
+    __asm__ volatile("mov %0, %%cr0" : : "r"(cr0) : "memory");
+    /* Global entries survive CR3 reloads once PGE is on */
+    if (g_features & PAGING_FEATURE_PGE) {
+        cr4 |= CR4_PGE;
+        __asm__ volatile("mov %0, %%cr4" : : "r"(cr4) : "memory");
+    }
+    g_enabled = 1;
+    return 0;
+}
+
+int paging_is_enabled(void) {
+    return g_enabled;
+}
+
+void paging_get_stats(paging_stats_t *stats) {
+    if (!stats) {
+        return;
+    }
+    stats->enabled = g_enabled;
+    stats->features = g_features;
+    stats->wb_large_pages = 0;
+    stats->wc_large_pages = 0;
+    stats->uc_large_pages = 0;
+    stats->low_uc_pages = 0;
+    for (uint32_t slot = 1; slot < PAGING_DIRECTORY_ENTRIES; slot++) {
+        switch (paging_entry_cache(g_page_directory[slot])) {
+            case PAGING_CACHE_WB: stats->wb_large_pages++; break;
+            case PAGING_CACHE_WC: stats->wc_large_pages++; break;
+            case PAGING_CACHE_UC: stats->uc_large_pages++; break;
+            default: break;
+        }
+    }
+    if (g_low_ready) {
+        for (uint32_t i = 0; i < PAGING_DIRECTORY_ENTRIES; i++) {
+            if (paging_entry_cache(g_low_table[i]) == PAGING_CACHE_UC) {
+                stats->low_uc_pages++;
+            }
+        }
+    }
+}
+
+void paging_get_footprint(uint32_t *static_bytes, uint32_t *heap_bytes) {
+    *static_bytes = sizeof(g_page_directory) + sizeof(g_low_table);
+    *heap_bytes = 0;
+}
@@ -0,0 +1,312 @@
+#include "../include/kernel/pmm.h"
+#include "../include/kernel/bootlog.h"
+
+/* Usable RAM, trimmed inward to whole frames */
+typedef struct {
+    uint32_t base;
+    uint32_t end;
+} pmm_region_t;
+
+#define PMM_ADDRESS_LIMIT 0xFFFFF000ULL   /* last whole frame below 4 GiB */
+
+static pmm_region_t g_regions[PMM_MAX_REGIONS];
+static uint32_t g_region_count = 0;
+static uint32_t *g_bitmap = 0;            /* bit set = frame in use */
+static uint32_t g_frame_count = 0;
+static uint32_t g_bitmap_bytes = 0;
+static uint32_t g_total_frames = 0;
+static uint32_t g_free_frames = 0;
+static uint32_t g_reserved_frames = 0;
+static uint32_t g_search_hint = 0;        /* word index of the last allocation */
+static uint32_t g_highest_address = 0;
+static int g_source = PMM_SOURCE_NONE;
+static int g_ready = 0;
+
+static void pmm_add_region(unsigned long long base, unsigned long long length) {
+    unsigned long long end = base + length;
+    if (end > PMM_ADDRESS_LIMIT) {
+        end = PMM_ADDRESS_LIMIT;
+    }
+    if (base >= end || g_region_count >= PMM_MAX_REGIONS) {
+        return;
+    }
+    uint32_t start = (uint32_t)((base + PMM_FRAME_SIZE - 1) & ~(unsigned long long)(PMM_FRAME_SIZE - 1));
+    uint32_t stop = (uint32_t)(end & ~(unsigned long long)(PMM_FRAME_SIZE - 1));
+    if (start >= stop) {
+        return;
+    }
+    g_regions[g_region_count].base = start;
+    g_regions[g_region_count].end = stop;
+    g_region_count++;
+    if (stop > g_highest_address) {
+        g_highest_address = stop;
+    }
+}
+
+/* Sources in order of preference: the multiboot memory map, the E820 table
+ * stage2 left in low memory, then the coarse multiboot and bootlog sizes */
+static void pmm_collect_regions(const multiboot_info_t *mbi) {
+    if (mbi && (mbi->flags & MULTIBOOT_INFO_MEM_MAP) && mbi->mmap_length > 0) {
+        uint32_t cursor = mbi->mmap_addr;
+        uint32_t end = mbi->mmap_addr + mbi->mmap_length;
+        while (cursor + sizeof(multiboot_mmap_entry_t) <= end) {
+            const multiboot_mmap_entry_t *entry = (const multiboot_mmap_entry_t *)(uintptr_t)cursor;
+            if (entry->type == MULTIBOOT_MEMORY_AVAILABLE) {
+                pmm_add_region(entry->base_addr, entry->length);
+            }
+            cursor += entry->size + sizeof(entry->size);
+        }
+        if (g_region_count > 0) {
+            g_source = PMM_SOURCE_MULTIBOOT_MMAP;
+            return;
+        }
+    }
+
+    if (bootlog_data && bootlog_data->magic == BOOTLOG_MAGIC && bootlog_data->e820_count > 0) {
+        const bootlog_e820_entry_t *table = (const bootlog_e820_entry_t *)BOOTLOG_E820_ADDR;
+        uint32_t count = bootlog_data->e820_count;
+        if (count > BOOTLOG_E820_MAX) {
+            count = BOOTLOG_E820_MAX;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            if (table[i].type == E820_TYPE_USABLE) {
+                pmm_add_region(table[i].base, table[i].length);
+            }
+        }
+        if (g_region_count > 0) {
+            g_source = PMM_SOURCE_E820;
+            return;
+        }
+    }
+
+    if (mbi && (mbi->flags & MULTIBOOT_INFO_MEMORY)) {
+        pmm_add_region(0, (unsigned long long)mbi->mem_lower << 10);
+        pmm_add_region(0x100000, (unsigned long long)mbi->mem_upper << 10);
+        g_source = PMM_SOURCE_MULTIBOOT_MEM;
+        return;
+    }
+
+    if (bootlog_data && bootlog_data->magic == BOOTLOG_MAGIC && bootlog_data->memory_mb > 1) {
+        pmm_add_region(0x100000, ((unsigned long long)bootlog_data->memory_mb - 1) << 20);
+        g_source = PMM_SOURCE_BOOTLOG_SIZE;
+    }
+}
+
+/* Sets or clears the bits for [base, end) and returns how many changed */
+static uint32_t pmm_mark(uint32_t base, uint32_t end, int used) {
+    uint32_t first = base >> PMM_FRAME_SHIFT;
+    uint32_t last = (end + PMM_FRAME_SIZE - 1) >> PMM_FRAME_SHIFT;
+    if (last > g_frame_count) {
+        last = g_frame_count;
+    }
+    uint32_t changed = 0;
+    for (uint32_t frame = first; frame < last; frame++) {
+        uint32_t mask = 1u << (frame & 31);
+        uint32_t *word = &g_bitmap[frame >> 5];
+        if (used && (*word & mask) == 0) {
+            *word |= mask;
+            changed++;
+        } else if (!used && (*word & mask) != 0) {
+            *word &= ~mask;
+            changed++;
+        }
+    }
+    return changed;
+}
+
+/* Areas inside usable RAM that are already spoken for: the real-mode IVT,
+ * BDA, bootlog (0x500) and E820 table (0x620) page, the kernel image and
+ * the boot stack */
+static uint32_t pmm_reserved_ranges(pmm_region_t *ranges) {
+    ranges[0].base = 0;
+    ranges[0].end = PMM_FRAME_SIZE;
+    ranges[1].base = (uint32_t)(uintptr_t)_kernel_start & ~(uint32_t)(PMM_FRAME_SIZE - 1);
+    ranges[1].end = ((uint32_t)(uintptr_t)_kernel_end + PMM_FRAME_SIZE - 1) & ~(uint32_t)(PMM_FRAME_SIZE - 1);
+    ranges[2].base = PMM_STACK_TOP - PMM_STACK_RESERVE;
+    ranges[2].end = PMM_STACK_TOP;
+    return 3;
+}
+
+/* First address in a usable region where length bytes avoid every reserved
+ * range, or 0 */
+static uint32_t pmm_place(uint32_t length, const pmm_region_t *reserved, uint32_t reserved_count) {
+    for (uint32_t r = 0; r < g_region_count; r++) {
+        uint32_t pos = g_regions[r].base;
+        int moved = 1;
+        while (moved) {
+            moved = 0;
+            for (uint32_t i = 0; i < reserved_count; i++) {
+                if (pos < reserved[i].end && pos + length > reserved[i].base) {
+                    pos = reserved[i].end;
+                    moved = 1;
+                }
+            }
+        }
+        if (pos + length >= pos && pos + length <= g_regions[r].end) {
+            return pos;
+        }
+    }
+    return 0;
+}
+
+int pmm_init(const multiboot_info_t *mbi) {
+    g_ready = 0;
+    g_region_count = 0;
+    g_highest_address = 0;
+    g_source = PMM_SOURCE_NONE;
+    pmm_collect_regions(mbi);
+    if (g_region_count == 0) {
+        return -1;
+    }
+
+    g_frame_count = g_highest_address >> PMM_FRAME_SHIFT;
+    g_bitmap_bytes = ((g_frame_count + 31) / 32) * 4;
+    uint32_t bitmap_length = (g_bitmap_bytes + PMM_FRAME_SIZE - 1) & ~(uint32_t)(PMM_FRAME_SIZE - 1);
+
+    pmm_region_t reserved[4];
+    uint32_t reserved_count = pmm_reserved_ranges(reserved);
+    uint32_t bitmap_base = pmm_place(bitmap_length, reserved, reserved_count);
+    if (bitmap_base == 0) {
+        return -1;
+    }
+    reserved[reserved_count].base = bitmap_base;
+    reserved[reserved_count].end = bitmap_base + bitmap_length;
+    reserved_count++;
+
+    g_bitmap = (uint32_t *)(uintptr_t)bitmap_base;
+    for (uint32_t i = 0; i < g_bitmap_bytes / 4; i++) {
+        g_bitmap[i] = 0xFFFFFFFF;
+    }
+    /* Overlapping firmware entries are only counted once */
+    g_total_frames = 0;
+    for (uint32_t r = 0; r < g_region_count; r++) {
+        g_total_frames += pmm_mark(g_regions[r].base, g_regions[r].end, 0);
+    }
+    g_reserved_frames = 0;
+    for (uint32_t i = 0; i < reserved_count; i++) {
+        g_reserved_frames += pmm_mark(reserved[i].base, reserved[i].end, 1);
+    }
+    g_free_frames = g_total_frames - g_reserved_frames;
+    g_search_hint = 0;
+    g_ready = 1;
+    return 0;
+}
+
+int pmm_is_ready(void) {
+    return g_ready;
+}
+
+uint32_t pmm_alloc_frame(void) {
+    if (!g_ready || g_free_frames == 0) {
+        return PMM_NO_FRAME;
+    }
+    uint32_t words = g_bitmap_bytes / 4;
+    for (uint32_t n = 0; n < words; n++) {
+        uint32_t w = g_search_hint + n;
+        if (w >= words) {
+            w -= words;
+        }
+        if (g_bitmap[w] != 0xFFFFFFFF) {
+            uint32_t bit = (uint32_t)__builtin_ctz(~g_bitmap[w]);
+            g_bitmap[w] |= 1u << bit;
+            g_free_frames--;
+            g_search_hint = w;
+            return ((w << 5) + bit) << PMM_FRAME_SHIFT;
+        }
+    }
+    return PMM_NO_FRAME;
+}
+
+/* First fit; fully used words are skipped 32 frames at a time */
+uint32_t pmm_alloc_frames(uint32_t count) {
+    if (count <= 1) {
+        return count == 1 ? pmm_alloc_frame() : PMM_NO_FRAME;
+    }
+    if (!g_ready || g_free_frames < count) {
+        return PMM_NO_FRAME;
+    }
+    uint32_t run_start = 0;
+    uint32_t run = 0;
+    uint32_t frame = 0;
+    while (frame < g_frame_count) {
+        uint32_t word = g_bitmap[frame >> 5];
+        if ((frame & 31) == 0 && word == 0xFFFFFFFF) {
+            run = 0;
+            frame += 32;
+            continue;
+        }
+        if (word & (1u << (frame & 31))) {
+            run = 0;
+            frame++;
+            continue;
+        }
+        if (run == 0) {
+            run_start = frame;
+        }
+        run++;
+        frame++;
+        if (run == count) {
+            uint32_t base = run_start << PMM_FRAME_SHIFT;
+            pmm_mark(base, base + (count << PMM_FRAME_SHIFT), 1);
+            g_free_frames -= count;
+            return base;
+        }
+    }
+    return PMM_NO_FRAME;
+}
+
+void pmm_free_frames(uint32_t address, uint32_t count) {
+    if (!g_ready || (address & (PMM_FRAME_SIZE - 1)) != 0 || count == 0) {
+        return;
+    }
+    uint32_t first = address >> PMM_FRAME_SHIFT;
+    if (first >= g_frame_count || count > g_frame_count - first) {
+        return;
+    }
+    /* Double frees clear nothing and are not counted */
+    g_free_frames += pmm_mark(address, address + (count << PMM_FRAME_SHIFT), 0);
+    if ((first >> 5) < g_search_hint) {
+        g_search_hint = first >> 5;
+    }
+}
+
+void pmm_free_frame(uint32_t address) {
+    pmm_free_frames(address, 1);
+}
+
+void pmm_get_stats(pmm_stats_t *stats) {
+    if (!stats) {
+        return;
+    }
+    stats->total_frames = g_total_frames;
+    stats->free_frames = g_free_frames;
+    stats->reserved_frames = g_reserved_frames;
+    stats->region_count = g_region_count;
+    stats->highest_address = g_highest_address;
+    stats->bitmap_bytes = g_bitmap_bytes;
+    stats->source = g_source;
+}
+
+int pmm_get_region(uint32_t index, uint32_t *base, uint32_t *end) {
+    if (index >= g_region_count) {
+        return -1;
+    }
+    *base = g_regions[index].base;
+    *end = g_regions[index].end;
+    return 0;
+}
+
+const char *pmm_source_name(int source) {
+    switch (source) {
+        case PMM_SOURCE_MULTIBOOT_MMAP: return "multiboot memory map";
+        case PMM_SOURCE_E820: return "E820";
+        case PMM_SOURCE_MULTIBOOT_MEM: return "multiboot mem_lower/mem_upper";
+        case PMM_SOURCE_BOOTLOG_SIZE: return "bootlog size";
+        default: return "none";
+    }
+}
+
+void pmm_get_footprint(uint32_t *static_bytes, uint32_t *dynamic_bytes) {
+    *static_bytes = sizeof(g_regions);
+    *dynamic_bytes = g_ready ? g_bitmap_bytes : 0;
+}
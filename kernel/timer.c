@@ -0,0 +1,147 @@
+#include "../include/kernel/timer.h"
+#include "../include/kernel/interrupts.h"
+#include "../include/kernel/clock.h"
+#include "../include/drivers/lapic.h"
+
+static ktimer_t *g_pending = 0;
+static uint64_t g_armed_deadline = 0;  /* 0 = hardware idle */
+static timer_stats_t g_stats;
+static int g_ready = 0;
+
+/* Called with interrupts disabled whenever the head of the list may have
+ * changed; the hardware is only touched if the earliest deadline moved */
+static void timer_program(void) {
+    if (!g_pending) {
+        if (g_armed_deadline != 0) {
+            lapic_timer_cancel();
+            g_armed_deadline = 0;
+            g_stats.reprograms++;
+        }
+        return;
+    }
+    if (g_pending->deadline_ns == g_armed_deadline) {
+        return;
+    }
+    uint64_t now = ktime_ns();
+    uint64_t deadline = g_pending->deadline_ns;
+    lapic_timer_arm(deadline > now ? deadline - now : 0);
+    g_armed_deadline = deadline;
+    g_stats.reprograms++;
+}
+
+static void timer_unlink(ktimer_t *t) {
+    ktimer_t **link = &g_pending;
+    while (*link) {
+        if (*link == t) {
+            *link = t->next;
+            break;
+        }
+        link = &(*link)->next;
+    }
+    t->next = 0;
+    t->pending = 0;
+}
+
+static void timer_interrupt(interrupt_frame_t *frame) {
+    (void)frame;
+    g_stats.interrupts++;
+    /* The one-shot has fired, whatever happens below */
+    g_armed_deadline = 0;
+    uint64_t now = ktime_ns();
+    int ran = 0;
+    while (g_pending && g_pending->deadline_ns <= now) {
+        ktimer_t *t = g_pending;
+        g_pending = t->next;
+        t->next = 0;
+        t->pending = 0;
+        g_stats.fired++;
+        ran = 1;
+        t->fn(t->arg);
+    }
+    if (!ran) {
+        g_stats.early_interrupts++;
+    }
+    timer_program();
+    lapic_eoi();
+}
+
+int timer_init(void) {
+    if (g_ready) {
+        return 0;
+    }
+    if (lapic_init() != 0) {
+        return -1;
+    }
+    interrupts_set_timer_handler(timer_interrupt);
+    g_ready = 1;
+    return 0;
+}
+
+int timer_is_available(void) {
+    return g_ready;
+}
+
+void ktimer_start(ktimer_t *t, uint64_t deadline_ns, ktimer_fn_t fn, void *arg) {
+    uint32_t flags = interrupts_save();
+    if (t->pending) {
+        timer_unlink(t);
+    }
+    t->deadline_ns = deadline_ns;
+    t->fn = fn;
+    t->arg = arg;
+    ktimer_t **link = &g_pending;
+    while (*link && (*link)->deadline_ns <= deadline_ns) {
+        link = &(*link)->next;
+    }
+    t->next = *link;
+    *link = t;
+    t->pending = 1;
+    g_stats.started++;
+    if (g_ready) {
+        timer_program();
+    }
+    interrupts_restore(flags);
+}
+
+void ktimer_cancel(ktimer_t *t) {
+    uint32_t flags = interrupts_save();
+    if (t->pending) {
+        timer_unlink(t);
+        g_stats.cancelled++;
+        if (g_ready) {
+            timer_program();
+        }
+    }
+    interrupts_restore(flags);
+}
+
+static void timer_wake(void *arg) {
+    *(volatile int *)arg = 1;
+}
+
+void timer_sleep_ns(uint64_t ns) {
+    uint64_t deadline = ktime_ns() + ns;
+    if (!g_ready) {
+        clock_info_t clock;
+        clock_get_info(&clock);
+        while (clock.source && ktime_ns() < deadline) {
+        }
+        return;
+    }
+    volatile int done = 0;
+    ktimer_t t;
+    t.pending = 0;
+    t.next = 0;
+    ktimer_start(&t, deadline, timer_wake, (void *)&done);
+    uint32_t flags = interrupts_save();
+    while (!done) {
+        cpu_idle();
+    }
+    interrupts_restore(flags);
+}
+
+void timer_get_stats(timer_stats_t *stats) {
+    if (stats) {
+        *stats = g_stats;
+    }
+}
@@ -1,10 +1,23 @@
 #include "../include/shell/commands.h"
 #include "../include/shell/nano.h"
+#include "../include/shell/prompt.h"
 #include "../include/kernel/bootlog.h"
+#include "../include/kernel/pmm.h"
+#include "../include/kernel/heap.h"
+#include "../include/kernel/paging.h"
+#include "../include/kernel/clock.h"
+#include "../include/kernel/interrupts.h"
+#include "../include/kernel/timer.h"
+#include "../include/drivers/lapic.h"
+#include "../include/drivers/pci.h"
 #include "../include/drivers/console.h"
+#include "../include/drivers/keyboard.h"
 #include "../include/drivers/storage/block_device.h"
 #include "../disk.h"
 #include "../fat12.h"
+#include "../include/fs/vfs.h"
+#include "../include/fs/fatfs.h"
+#include "../include/fs/ramfs.h"
 
 extern void halt_cpu(void);
 extern const char *get_boot_mode_name(void);
@@ -12,7 +25,14 @@ extern void bootlog_print(void);
 extern bootlog_data_t *bootlog_data;
 
 static int fat_ready = 0;
-static uint8_t fs_io_buffer[FS_IO_BUFFER_SIZE];
+/* Taken from the heap the first time nano needs it; it outlives the
+ * command that opened the editor */
+static uint8_t *fs_io_buffer = 0;
+static arena_t scratch_arena;
+/* idlestat reports the interval since its previous run */
+static interrupt_stats_t idlestat_last;
+static uint64_t idlestat_last_ns = 0;
+static uint32_t idlestat_last_dropped = 0;
 
 static const char *os_name = "AltoniumOS";
 static const char *os_version = "1.0.0";
@@ -22,6 +42,7 @@ static const char *build_time = __TIME__;
 
 void commands_init(void) {
     fat_ready = 0;
+    arena_init(&scratch_arena, SHELL_SCRATCH_CHUNK_SIZE);
 }
 
 int commands_is_fat_ready(void) {
@@ -33,15 +54,26 @@ void commands_set_fat_ready(int ready) {
 }
 
 uint8_t *commands_get_io_buffer(void) {
+    if (!fs_io_buffer) {
+        fs_io_buffer = (uint8_t *)kmalloc(FS_IO_BUFFER_SIZE);
+    }
     return fs_io_buffer;
 }
 
+void *commands_scratch_alloc(size_t size) {
+    return arena_alloc(&scratch_arena, size);
+}
+
+void commands_get_scratch_stats(arena_stats_t *stats) {
+    arena_get_stats(&scratch_arena, stats);
+}
+
 const char *fat12_error_string(int code) {
     switch (code) {
         case FAT12_OK: return "ok";
         case FAT12_ERR_IO: return "io";
         case FAT12_ERR_BAD_BPB: return "bad bpb";
-        case FAT12_ERR_NOT_FAT12: return "not fat12";
+        case FAT12_ERR_NOT_FAT12: return "not fat";
         case FAT12_ERR_OUT_OF_RANGE: return "range";
         case FAT12_ERR_NO_FREE_CLUSTER: return "disk full";
         case FAT12_ERR_INVALID_NAME: return "name";
@@ -52,13 +84,25 @@ const char *fat12_error_string(int code) {
         case FAT12_ERR_BUFFER_SMALL: return "buffer";
         case FAT12_ERR_NOT_FILE: return "not file";
         case FAT12_ERR_NOT_INITIALIZED: return "fs offline";
+        case FAT12_ERR_BAD_HANDLE: return "bad handle";
+        case FAT12_ERR_TOO_MANY_OPEN: return "too many open";
+        case FAT12_ERR_NO_MEMORY: return "no memory";
         default: return "unknown";
     }
 }
 
+const char *vfs_error_string(int code) {
+    switch (code) {
+        case VFS_ERR_NOT_EMPTY: return "not empty";
+        case VFS_ERR_BUSY: return "busy";
+        case VFS_ERR_NOT_SUPPORTED: return "not supported";
+        default: return fat12_error_string(code);
+    }
+}
+
 void print_fs_error(int code) {
     console_print(" (");
-    console_print(fat12_error_string(code));
+    console_print(vfs_error_string(code));
     console_print(" code ");
     print_decimal(code);
     console_print(")");
@@ -68,16 +112,16 @@ typedef struct {
     int count;
 } ls_context_t;
 
-static int ls_callback(const fat12_dir_entry_info_t *entry, void *context) {
+static int ls_callback(const vfs_dir_entry_t *entry, void *context) {
     ls_context_t *ctx = (ls_context_t *)context;
     ctx->count++;
-    if (entry->attr & FAT12_ATTR_DIRECTORY) {
+    if (entry->type == VFS_TYPE_DIR) {
         console_print("[DIR] ");
     } else {
         console_print("      ");
     }
     console_print(entry->name);
-    if ((entry->attr & FAT12_ATTR_DIRECTORY) == 0) {
+    if (entry->type != VFS_TYPE_DIR) {
         console_print(" (");
         print_unsigned(entry->size);
         console_print(" bytes)");
@@ -122,7 +166,15 @@ void handle_fetch(void) {
     console_print(get_boot_mode_name());
     console_print("\n");
     
-    if (bootlog_data && bootlog_data->memory_mb > 0) {
+    if (pmm_is_ready()) {
+        pmm_stats_t pmm_stats;
+        pmm_get_stats(&pmm_stats);
+        console_print("Memory: ");
+        print_unsigned(pmm_stats.total_frames / (1024 * 1024 / PMM_FRAME_SIZE));
+        console_print(" MB (");
+        print_unsigned(pmm_stats.free_frames / (1024 * 1024 / PMM_FRAME_SIZE));
+        console_print(" MB free)\n");
+    } else if (bootlog_data && bootlog_data->memory_mb > 0) {
         console_print("Memory: ");
         unsigned int mem = bootlog_data->memory_mb;
         char buf[16];
@@ -160,11 +212,21 @@ void handle_help(void) {
     console_print("  cat FILE       - Print file contents\n");
     console_print("  touch FILE     - Create a zero-length file\n");
     console_print("  write FILE TXT - Create/overwrite a text file\n");
+    console_print("  append FILE TXT- Append text to a file (created if missing)\n");
     console_print("  mkdir NAME     - Create a directory\n");
     console_print("  rm FILE        - Delete a file\n");
     console_print("  nano FILE      - Text editor (Ctrl+S/Ctrl+X/Ctrl+T/Ctrl+H)\n");
+    console_print("  mount          - List mounted filesystems (ramfs at /tmp)\n");
     console_print("  theme [OPTION] - Switch theme (normal/blue/green) or 'list'\n");
     console_print("  fsstat         - Show filesystem/disk statistics\n");
+    console_print("  df             - Show free and used filesystem space\n");
+    console_print("  meminfo        - Show kernel memory use by subsystem\n");
+    console_print("  uptime         - Show time since boot and the clocksource\n");
+    console_print("  time COMMAND   - Run COMMAND and show how long it took\n");
+    console_print("  sleep MS       - Idle for MS milliseconds on a one-shot timer\n");
+    console_print("  idlestat       - Show CPU wakeups and idle time since the last run\n");
+    console_print("  frag FILE      - Show how many fragments a file is split into\n");
+    console_print("  defrag [FILE]  - Make a file (or every file) contiguous\n");
     console_print("  bootlog        - Show BIOS boot diagnostics\n");
     console_print("  shutdown       - Shut down the system\n");
     console_print("  help           - Display this help message\n");
@@ -172,8 +234,8 @@ void handle_help(void) {
 
 void handle_shutdown(void) {
     console_print("Attempting system shutdown...\n");
-    if (fat_ready) {
-        fat12_flush();
+    if (vfs_is_ready()) {
+        vfs_sync();
     }
     console_print("Halting CPU...\n");
     halt_cpu();
@@ -212,7 +274,11 @@ void handle_disk(void) {
     
     console_print("  Disk initialization: OK\n");
     
-    uint8_t buffer[512];
+    uint8_t *buffer = (uint8_t *)commands_scratch_alloc(512);
+    if (!buffer) {
+        console_print("  Sector 0 read: FAILED (out of memory)\n");
+        return;
+    }
     result = disk_read_sector(0, buffer);
     if (result != 0) {
         console_print("  Sector 0 read: FAILED (error ");
@@ -298,12 +364,12 @@ void handle_disk(void) {
 }
 
 void handle_ls(const char *args) {
-    if (!fat_ready) {
+    if (!vfs_is_ready()) {
         console_print("Filesystem not initialized\n");
         return;
     }
     const char *path = skip_whitespace(args);
-    char path_buf[FAT12_PATH_MAX];
+    char path_buf[VFS_PATH_MAX];
     int path_len = 0;
     if (path && *path) {
         path_len = copy_path_argument(path, path_buf, sizeof(path_buf));
@@ -314,13 +380,8 @@ void handle_ls(const char *args) {
     }
     ls_context_t ctx;
     ctx.count = 0;
-    int result;
-    if (path_len > 0) {
-        result = fat12_iterate_path(path_buf, ls_callback, &ctx);
-    } else {
-        result = fat12_iterate_current_directory(ls_callback, &ctx);
-    }
-    if (result != FAT12_OK) {
+    int result = vfs_iterate(path_len > 0 ? path_buf : "", ls_callback, &ctx);
+    if (result != VFS_OK) {
         console_print("ls failed");
         print_fs_error(result);
         console_print("\n");
@@ -332,21 +393,21 @@ void handle_ls(const char *args) {
 }
 
 void handle_pwd(void) {
-    if (!fat_ready) {
+    if (!vfs_is_ready()) {
         console_print("Filesystem not initialized\n");
         return;
     }
-    console_print(fat12_get_cwd());
+    console_print(vfs_getcwd());
     console_print("\n");
 }
 
 void handle_cd(const char *args) {
-    if (!fat_ready) {
+    if (!vfs_is_ready()) {
         console_print("Filesystem not initialized\n");
         return;
     }
     const char *path = skip_whitespace(args);
-    char path_buf[FAT12_PATH_MAX];
+    char path_buf[VFS_PATH_MAX];
     int path_len = 0;
     if (path && *path) {
         path_len = copy_path_argument(path, path_buf, sizeof(path_buf));
@@ -359,24 +420,24 @@ void handle_cd(const char *args) {
         path_buf[0] = '/';
         path_buf[1] = '\0';
     }
-    int result = fat12_change_directory(path_buf);
-    if (result != FAT12_OK) {
+    int result = vfs_chdir(path_buf);
+    if (result != VFS_OK) {
         console_print("cd failed");
         print_fs_error(result);
         console_print("\n");
         return;
     }
-    console_print(fat12_get_cwd());
+    console_print(vfs_getcwd());
     console_print("\n");
 }
 
 void handle_cat(const char *args) {
-    if (!fat_ready) {
+    if (!vfs_is_ready()) {
         console_print("Filesystem not initialized\n");
         return;
     }
     const char *path = skip_whitespace(args);
-    char path_buf[FAT12_PATH_MAX];
+    char path_buf[VFS_PATH_MAX];
     int path_len = copy_path_argument(path, path_buf, sizeof(path_buf));
     if (path_len < 0) {
         console_print("cat failed (path too long)\n");
@@ -386,35 +447,59 @@ void handle_cat(const char *args) {
         console_print("Usage: cat FILE\n");
         return;
     }
-    uint32_t size = 0;
-    int result = fat12_read_file(path_buf, fs_io_buffer, FS_IO_BUFFER_SIZE - 1, &size);
-    if (result != FAT12_OK) {
+    uint8_t *buffer = (uint8_t *)commands_scratch_alloc(FS_IO_BUFFER_SIZE);
+    if (!buffer) {
+        console_print("cat failed (out of memory)\n");
+        return;
+    }
+    /* Stream through the buffer so file size is not limited by it */
+    int handle = vfs_open(path_buf, VFS_OPEN_READ);
+    if (handle < 0) {
         console_print("cat failed");
-        print_fs_error(result);
+        print_fs_error(handle);
         console_print("\n");
         return;
     }
-    for (uint32_t i = 0; i < size; i++) {
-        console_putchar((char)fs_io_buffer[i]);
+    uint32_t total = 0;
+    uint8_t last = 0;
+    for (;;) {
+        uint32_t chunk = 0;
+        int result = vfs_read(handle, buffer, FS_IO_BUFFER_SIZE, &chunk);
+        if (result != VFS_OK) {
+            vfs_close(handle);
+            console_print("\ncat failed");
+            print_fs_error(result);
+            console_print("\n");
+            return;
+        }
+        if (chunk == 0) {
+            break;
+        }
+        for (uint32_t i = 0; i < chunk; i++) {
+            console_putchar((char)buffer[i]);
+        }
+        last = buffer[chunk - 1];
+        total += chunk;
     }
-    if (size == 0 || fs_io_buffer[size - 1] != '\n') {
+    vfs_close(handle);
+    if (total == 0 || last != '\n') {
         console_print("\n");
     }
 }
 
 void handle_touch(const char *args) {
-    if (!fat_ready) {
+    if (!vfs_is_ready()) {
         console_print("Filesystem not initialized\n");
         return;
     }
     const char *cursor = args;
-    char name_buf[FAT12_PATH_MAX];
+    char name_buf[VFS_PATH_MAX];
     if (read_token(&cursor, name_buf, sizeof(name_buf)) == 0) {
         console_print("Usage: touch NAME\n");
         return;
     }
-    int result = fat12_write_file(name_buf, 0, 0);
-    if (result != FAT12_OK) {
+    int result = vfs_write_file(name_buf, 0, 0);
+    if (result != VFS_OK) {
         console_print("touch failed");
         print_fs_error(result);
         console_print("\n");
@@ -426,30 +511,20 @@ void handle_touch(const char *args) {
 }
 
 void handle_write_command(const char *args) {
-    if (!fat_ready) {
+    if (!vfs_is_ready()) {
         console_print("Filesystem not initialized\n");
         return;
     }
     const char *cursor = args;
-    char name_buf[FAT12_PATH_MAX];
+    char name_buf[VFS_PATH_MAX];
     if (read_token(&cursor, name_buf, sizeof(name_buf)) == 0) {
         console_print("Usage: write NAME TEXT\n");
         return;
     }
     const char *payload = skip_whitespace(cursor);
-    uint32_t length = 0;
-    if (payload) {
-        while (payload[length] != '\0') {
-            if (length >= FS_IO_BUFFER_SIZE) {
-                console_print("write failed (data too large)\n");
-                return;
-            }
-            fs_io_buffer[length] = (uint8_t)payload[length];
-            length++;
-        }
-    }
-    int result = fat12_write_file(name_buf, fs_io_buffer, length);
-    if (result != FAT12_OK) {
+    uint32_t length = payload ? (uint32_t)strlen_impl(payload) : 0;
+    int result = vfs_write_file(name_buf, (const uint8_t *)payload, length);
+    if (result != VFS_OK) {
         console_print("write failed");
         print_fs_error(result);
         console_print("\n");
@@ -460,19 +535,56 @@ void handle_write_command(const char *args) {
     console_print(" bytes\n");
 }
 
+void handle_append_command(const char *args) {
+    if (!vfs_is_ready()) {
+        console_print("Filesystem not initialized\n");
+        return;
+    }
+    const char *cursor = args;
+    char name_buf[VFS_PATH_MAX];
+    if (read_token(&cursor, name_buf, sizeof(name_buf)) == 0) {
+        console_print("Usage: append NAME TEXT\n");
+        return;
+    }
+    const char *payload = skip_whitespace(cursor);
+    uint32_t length = payload ? (uint32_t)strlen_impl(payload) : 0;
+    /* Only the tail cluster and the directory entry are rewritten */
+    int handle = vfs_open(name_buf, VFS_OPEN_APPEND | VFS_OPEN_CREATE);
+    if (handle < 0) {
+        console_print("append failed");
+        print_fs_error(handle);
+        console_print("\n");
+        return;
+    }
+    int result = vfs_write(handle, (const uint8_t *)payload, length, 0);
+    int close_result = vfs_close(handle);
+    if (result == VFS_OK) {
+        result = close_result;
+    }
+    if (result != VFS_OK) {
+        console_print("append failed");
+        print_fs_error(result);
+        console_print("\n");
+        return;
+    }
+    console_print("Appended ");
+    print_unsigned(length);
+    console_print(" bytes\n");
+}
+
 void handle_mkdir_command(const char *args) {
-    if (!fat_ready) {
+    if (!vfs_is_ready()) {
         console_print("Filesystem not initialized\n");
         return;
     }
     const char *cursor = args;
-    char name_buf[FAT12_PATH_MAX];
+    char name_buf[VFS_PATH_MAX];
     if (read_token(&cursor, name_buf, sizeof(name_buf)) == 0) {
         console_print("Usage: mkdir NAME\n");
         return;
     }
-    int result = fat12_create_directory(name_buf);
-    if (result != FAT12_OK) {
+    int result = vfs_mkdir(name_buf);
+    if (result != VFS_OK) {
         console_print("mkdir failed");
         print_fs_error(result);
         console_print("\n");
@@ -482,18 +594,18 @@ void handle_mkdir_command(const char *args) {
 }
 
 void handle_rm_command(const char *args) {
-    if (!fat_ready) {
+    if (!vfs_is_ready()) {
         console_print("Filesystem not initialized\n");
         return;
     }
     const char *cursor = args;
-    char name_buf[FAT12_PATH_MAX];
+    char name_buf[VFS_PATH_MAX];
     if (read_token(&cursor, name_buf, sizeof(name_buf)) == 0) {
         console_print("Usage: rm NAME\n");
         return;
     }
-    int result = fat12_delete_file(name_buf);
-    if (result != FAT12_OK) {
+    int result = vfs_unlink(name_buf);
+    if (result != VFS_OK) {
         console_print("rm failed");
         print_fs_error(result);
         console_print("\n");
@@ -503,19 +615,21 @@ void handle_rm_command(const char *args) {
 }
 
 void handle_nano_command(const char *args) {
-    if (!fat_ready) {
+    if (!vfs_is_ready()) {
         console_print("Filesystem not initialized\n");
         return;
     }
     
     const char *cursor = args;
-    char filename_buf[FAT12_PATH_MAX];
+    char filename_buf[VFS_PATH_MAX];
     if (read_token(&cursor, filename_buf, sizeof(filename_buf)) == 0) {
         console_print("Usage: nano FILENAME\n");
         return;
     }
     
-    nano_init_editor(filename_buf);
+    if (nano_init_editor(filename_buf) != 0) {
+        console_print("nano failed (out of memory)\n");
+    }
 }
 
 void handle_fsstat_command(void) {
@@ -555,6 +669,530 @@ void handle_fsstat_command(void) {
         print_unsigned(multi_pct);
         console_print("%\n");
     }
+
+    if (disk_stats.read_ops > 0) {
+        console_print("  Avg read time:      ");
+        print_unsigned(disk_stats.read_us / disk_stats.read_ops);
+        console_print(" us/op\n");
+    }
+    if (disk_stats.write_ops > 0) {
+        console_print("  Avg write time:     ");
+        print_unsigned(disk_stats.write_us / disk_stats.write_ops);
+        console_print(" us/op\n");
+    }
+    
+    if (!fat_ready) {
+        return;
+    }
+    
+    fat12_stats_t fs_stats;
+    fat12_get_stats(&fs_stats);
+    
+    console_print("Filesystem Statistics:\n");
+    console_print("  Mount reads:        ");
+    print_unsigned(fs_stats.mount_sector_reads);
+    console_print(" sectors\n");
+    
+    console_print("  FAT cache hits:     ");
+    print_unsigned(fs_stats.fat_cache_hits);
+    console_print("\n");
+    
+    console_print("  FAT cache misses:   ");
+    print_unsigned(fs_stats.fat_cache_misses);
+    console_print("\n");
+    
+    console_print("  FAT sector writes:  ");
+    print_unsigned(fs_stats.fat_sector_writes);
+    console_print("\n");
+    
+    console_print("  Root sector writes: ");
+    print_unsigned(fs_stats.root_sector_writes);
+    console_print("\n");
+    
+    console_print("  Allocated extents:  ");
+    print_unsigned(fs_stats.alloc_extents);
+    console_print(" (");
+    print_unsigned(fs_stats.alloc_clusters);
+    console_print(" clusters");
+    if (fs_stats.alloc_extents > 0) {
+        console_print(", ");
+        print_unsigned(fs_stats.alloc_clusters / fs_stats.alloc_extents);
+        console_print(" per extent");
+    }
+    console_print(")\n");
+    
+    console_print("  Extent map builds:  ");
+    print_unsigned(fs_stats.extent_map_builds);
+    console_print(" (");
+    print_unsigned(fs_stats.chain_walk_steps);
+    console_print(" chain steps)\n");
+    
+    uint32_t dentry_lookups = fs_stats.dentry_hits + fs_stats.dentry_misses;
+    console_print("  Dentry cache hits:  ");
+    print_unsigned(fs_stats.dentry_hits);
+    console_print(" (");
+    print_unsigned(fs_stats.dentry_negative_hits);
+    console_print(" negative), misses: ");
+    print_unsigned(fs_stats.dentry_misses);
+    if (dentry_lookups > 0) {
+        console_print(", ");
+        print_unsigned((fs_stats.dentry_hits * 100) / dentry_lookups);
+        console_print("% hit rate");
+    }
+    console_print("\n");
+    
+    console_print("  Directory indexes:  ");
+    print_unsigned(fs_stats.dir_index_builds);
+    console_print(" built\n");
+}
+
+/* Multiplies before dividing only as far as needed, so 512-byte clusters do
+ * not round down to zero and large FAT32 volumes do not overflow */
+static uint32_t clusters_to_kb(uint32_t clusters, uint32_t cluster_size) {
+    if (cluster_size >= 1024) {
+        return clusters * (cluster_size / 1024);
+    }
+    return clusters / (1024 / cluster_size);
+}
+
+static void print_two_digits(uint32_t value) {
+    console_putchar((char)('0' + value / 10));
+    console_putchar((char)('0' + value % 10));
+}
+
+/* kHz as "MHz.kHz" */
+static void print_khz_as_mhz(uint32_t khz) {
+    print_unsigned(khz / 1000);
+    console_print(".");
+    console_putchar((char)('0' + (khz % 1000) / 100));
+    print_two_digits(khz % 100);
+    console_print(" MHz");
+}
+
+void handle_uptime_command(void) {
+    clock_info_t info;
+    clock_get_info(&info);
+    if (!info.source) {
+        console_print("uptime unavailable (no clocksource)\n");
+        return;
+    }
+    /* Seconds from the 64-bit count, so the day field does not wrap */
+    uint32_t rem_ns;
+    uint32_t seconds = (uint32_t)div_u64_rem(ktime_ns(), NSEC_PER_SEC, &rem_ns);
+    uint32_t ms = rem_ns / NSEC_PER_MSEC;
+    console_print("up ");
+    if (seconds >= 86400) {
+        print_unsigned(seconds / 86400);
+        console_print("d ");
+    }
+    print_unsigned((seconds / 3600) % 24);
+    console_print(":");
+    print_two_digits((seconds / 60) % 60);
+    console_print(":");
+    print_two_digits(seconds % 60);
+    console_print(".");
+    console_putchar((char)('0' + ms / 100));
+    print_two_digits(ms % 100);
+    console_print("\n");
+
+    console_print("Clocksource: ");
+    console_print(info.source);
+    console_print("\n");
+    if (info.tsc_khz != 0) {
+        console_print("TSC: ");
+        print_khz_as_mhz(info.tsc_khz);
+        console_print(", calibrated against ");
+        console_print(info.tsc_reference == CLOCK_REF_HPET ? "HPET" : "PIT");
+        console_print(info.tsc_invariant ? ", invariant\n" : ", not invariant\n");
+    }
+    if (info.hpet_available) {
+        console_print("HPET: ");
+        print_khz_as_mhz((uint32_t)div_u64_rem(1000000000000ULL, info.hpet_period_fs, 0));
+        console_print(", ");
+        print_unsigned(info.hpet_timers);
+        console_print(" comparators\n");
+    }
+}
+
+/* Runs the rest of the line as a command and reports its wall-clock time */
+void handle_time_command(const char *args) {
+    const char *command = skip_whitespace(args);
+    if (*command == '\0') {
+        console_print("Usage: time COMMAND\n");
+        return;
+    }
+    uint64_t start = ktime_ns();
+    execute_command(command);
+    uint32_t us = (uint32_t)div_u64_rem(ktime_ns() - start, NSEC_PER_USEC, 0);
+    console_print("real ");
+    print_unsigned(us / 1000);
+    console_print(".");
+    console_putchar((char)('0' + (us % 1000) / 100));
+    print_two_digits(us % 100);
+    console_print(" ms\n");
+}
+
+void handle_sleep_command(const char *args) {
+    const char *cursor = skip_whitespace(args);
+    uint32_t ms = 0;
+    if (*cursor < '0' || *cursor > '9') {
+        console_print("Usage: sleep MILLISECONDS\n");
+        return;
+    }
+    while (*cursor >= '0' && *cursor <= '9') {
+        uint32_t digit = (uint32_t)(*cursor - '0');
+        if (ms > (0xFFFFFFFFu - digit) / 10) {
+            console_print("Usage: sleep MILLISECONDS (at most 4294967295)\n");
+            return;
+        }
+        ms = ms * 10 + digit;
+        cursor++;
+    }
+    uint64_t start = ktime_ns();
+    timer_sleep_ns((uint64_t)ms * NSEC_PER_MSEC);
+    console_print("Slept ");
+    print_unsigned((uint32_t)div_u64_rem(ktime_ns() - start, NSEC_PER_USEC, 0));
+    console_print(" us\n");
+}
+
+void handle_idlestat_command(void) {
+    interrupt_stats_t now;
+    interrupts_get_stats(&now);
+    uint64_t now_ns = ktime_ns();
+    uint32_t window_ms = (uint32_t)div_u64_rem(now_ns - idlestat_last_ns, NSEC_PER_MSEC, 0);
+    uint32_t idle_ms = (uint32_t)div_u64_rem(now.idle_ns - idlestat_last.idle_ns, NSEC_PER_MSEC, 0);
+    uint32_t wakeups = now.idle_entries - idlestat_last.idle_entries;
+    uint32_t keyboard = now.irq_counts[IRQ_KEYBOARD] - idlestat_last.irq_counts[IRQ_KEYBOARD];
+    uint32_t timer = now.lapic_timer - idlestat_last.lapic_timer;
+    uint32_t other = now.spurious - idlestat_last.spurious;
+    uint32_t dropped_total = keyboard_dropped_scancodes();
+    uint32_t dropped = dropped_total - idlestat_last_dropped;
+    for (int irq = 0; irq < IRQ_COUNT; irq++) {
+        if (irq != IRQ_KEYBOARD) {
+            other += now.irq_counts[irq] - idlestat_last.irq_counts[irq];
+        }
+    }
+
+    console_print(idlestat_last_ns == 0 ? "Since boot: " : "Since last idlestat: ");
+    print_unsigned(window_ms / 1000);
+    console_print(".");
+    console_putchar((char)('0' + (window_ms % 1000) / 100));
+    console_print(" s, ");
+    print_unsigned(wakeups);
+    console_print(" wakeups (");
+    if (window_ms > 0) {
+        uint32_t centi = (uint32_t)div_u64_rem((uint64_t)wakeups * 100000, window_ms, 0);
+        print_unsigned(centi / 100);
+        console_print(".");
+        print_two_digits(centi % 100);
+        console_print("/s), ");
+        print_unsigned((uint32_t)div_u64_rem((uint64_t)idle_ms * 100, window_ms, 0));
+        console_print("% idle\n");
+    } else {
+        console_print("-)\n");
+    }
+    console_print("  Interrupts: keyboard ");
+    print_unsigned(keyboard);
+    console_print(", timer ");
+    print_unsigned(timer);
+    console_print(", other ");
+    print_unsigned(other);
+    console_print(", scancodes dropped ");
+    print_unsigned(dropped);
+    console_print("\n");
+
+    console_print("  Idle via ");
+    console_print(now.idle_method == IDLE_METHOD_MWAIT ? "mwait" : "hlt");
+    console_print(", timer ");
+    switch (lapic_timer_mode()) {
+        case LAPIC_TIMER_TSC_DEADLINE:
+            console_print("TSC-deadline");
+            break;
+        case LAPIC_TIMER_ONESHOT:
+            console_print("one-shot at ");
+            print_unsigned(lapic_timer_khz());
+            console_print(" kHz");
+            break;
+        default:
+            console_print("unavailable");
+            break;
+    }
+    timer_stats_t timer_stats;
+    timer_get_stats(&timer_stats);
+    console_print(" (");
+    print_unsigned(timer_stats.fired);
+    console_print(" fired, ");
+    print_unsigned(timer_stats.early_interrupts);
+    console_print(" early, ");
+    print_unsigned(timer_stats.reprograms);
+    console_print(" reprograms)\n");
+
+    idlestat_last = now;
+    idlestat_last_ns = now_ns;
+    idlestat_last_dropped = dropped_total;
+}
+
+void handle_df_command(void) {
+    if (!fat_ready) {
+        console_print("Filesystem not initialized\n");
+        return;
+    }
+    fat12_space_info_t space;
+    int result = fat12_get_space(&space);
+    if (result != FAT12_OK) {
+        console_print("df failed");
+        print_fs_error(result);
+        console_print("\n");
+        return;
+    }
+    uint32_t used = space.total_clusters - space.free_clusters;
+    
+    console_print("FAT");
+    print_unsigned(space.fat_type);
+    console_print(" filesystem space (");
+    print_unsigned(space.cluster_size);
+    console_print("-byte clusters):\n");
+    console_print("  Total: ");
+    print_unsigned(clusters_to_kb(space.total_clusters, space.cluster_size));
+    console_print(" KB (");
+    print_unsigned(space.total_clusters);
+    console_print(" clusters)\n");
+    console_print("  Used:  ");
+    print_unsigned(clusters_to_kb(used, space.cluster_size));
+    console_print(" KB (");
+    print_unsigned(used);
+    console_print(" clusters)\n");
+    console_print("  Free:  ");
+    print_unsigned(clusters_to_kb(space.free_clusters, space.cluster_size));
+    console_print(" KB (");
+    print_unsigned(space.free_clusters);
+    console_print(" clusters)\n");
+}
+
+static void print_unsigned_width(uint32_t value, int width) {
+    int digits = 1;
+    for (uint32_t rest = value; rest >= 10; rest /= 10) {
+        digits++;
+    }
+    for (int i = digits; i < width; i++) {
+        console_putchar(' ');
+    }
+    print_unsigned(value);
+}
+
+/* Adds the subsystem's static bytes to *attributed so the remainder of
+ * data+bss can be reported as "other" */
+static void meminfo_row(const char *name, void (*footprint)(uint32_t *, uint32_t *), uint32_t *attributed) {
+    uint32_t static_bytes = 0;
+    uint32_t heap_bytes = 0;
+    footprint(&static_bytes, &heap_bytes);
+    *attributed += static_bytes;
+    console_print("  ");
+    console_print(name);
+    for (int i = (int)strlen_impl(name); i < 16; i++) {
+        console_putchar(' ');
+    }
+    print_unsigned_width(static_bytes, 8);
+    print_unsigned_width(heap_bytes, 10);
+    console_print("\n");
+}
+
+static void shell_get_footprint(uint32_t *static_bytes, uint32_t *heap_bytes) {
+    arena_stats_t arena;
+    arena_get_stats(&scratch_arena, &arena);
+    *static_bytes = sizeof(shell_context_t) + sizeof(scratch_arena);
+    *heap_bytes = arena.backing_bytes + (fs_io_buffer ? FS_IO_BUFFER_SIZE : 0);
+}
+
+void handle_meminfo_command(void) {
+    uint32_t image = (uint32_t)(_kernel_end - _kernel_start);
+    uint32_t data_bss = (uint32_t)(_data_end - _data_start) + (uint32_t)(_bss_end - _bss_start);
+    console_print("Kernel image: ");
+    print_unsigned(image / 1024);
+    console_print(" KB (text ");
+    print_unsigned((uint32_t)(_text_end - _text_start));
+    console_print(", rodata ");
+    print_unsigned((uint32_t)(_rodata_end - _rodata_start));
+    console_print(", data ");
+    print_unsigned((uint32_t)(_data_end - _data_start));
+    console_print(", bss ");
+    print_unsigned((uint32_t)(_bss_end - _bss_start));
+    console_print(" bytes)\n");
+    console_print("Stack: ");
+    print_unsigned(kernel_stack_high_water());
+    console_print(" of ");
+    print_unsigned(PMM_STACK_RESERVE);
+    console_print(" bytes used at most\n");
+
+    console_print("  Subsystem         static   dynamic\n");
+    uint32_t attributed = 0;
+    meminfo_row("FAT driver", fat12_get_footprint, &attributed);
+    meminfo_row("VFS", vfs_get_footprint, &attributed);
+    meminfo_row("ramfs", ramfs_get_footprint, &attributed);
+    meminfo_row("PCI table", pci_get_footprint, &attributed);
+    meminfo_row("Storage", storage_get_footprint, &attributed);
+    meminfo_row("Shell + arena", shell_get_footprint, &attributed);
+    meminfo_row("nano", nano_get_footprint, &attributed);
+    meminfo_row("Frame bitmap", pmm_get_footprint, &attributed);
+    meminfo_row("Page tables", paging_get_footprint, &attributed);
+    meminfo_row("Heap metadata", heap_get_footprint, &attributed);
+    console_print("  Other           ");
+    print_unsigned_width(data_bss > attributed ? data_bss - attributed : 0, 8);
+    console_print("\n");
+
+    if (!pmm_is_ready()) {
+        console_print("Heap: unavailable (no memory map)\n");
+        return;
+    }
+    heap_stats_t heap;
+    heap_get_stats(&heap);
+    console_print("Heap: ");
+    print_unsigned(heap.bytes_in_use / 1024);
+    console_print(" KB in use of ");
+    print_unsigned(heap.bytes_backed / 1024);
+    console_print(" KB backed (");
+    print_unsigned(heap.slab_pages);
+    console_print(" slab pages, ");
+    print_unsigned(heap.large_allocations);
+    console_print(" large in ");
+    print_unsigned(heap.large_pages);
+    console_print(" pages), ");
+    print_unsigned(heap.failed_allocs);
+    console_print(" failed\n");
+    console_print("  Slabs:");
+    for (int i = 0; i < HEAP_CLASS_COUNT; i++) {
+        if (heap.classes[i].slabs == 0) {
+            continue;
+        }
+        console_print(" ");
+        print_unsigned(heap.classes[i].object_size);
+        console_print("B ");
+        print_unsigned(heap.classes[i].objects_in_use);
+        console_print("/");
+        print_unsigned(heap.classes[i].objects_total);
+    }
+    console_print("\n");
+    arena_stats_t arena;
+    arena_get_stats(&scratch_arena, &arena);
+    console_print("  Scratch arena: high-water ");
+    print_unsigned(arena.high_water);
+    console_print(" bytes, ");
+    print_unsigned(arena.chunks);
+    console_print(" chunk(s) held\n");
+    pmm_stats_t pmm_stats;
+    pmm_get_stats(&pmm_stats);
+    console_print("Physical memory: ");
+    print_unsigned(pmm_stats.free_frames * (PMM_FRAME_SIZE / 1024));
+    console_print(" KB free of ");
+    print_unsigned(pmm_stats.total_frames * (PMM_FRAME_SIZE / 1024));
+    console_print(" KB\n");
+}
+
+/* frag and defrag work on FAT volumes only; map a shell path (relative to
+ * the VFS cwd) to a path on the FAT mount */
+static int resolve_fat_path(const char *path, char *out, uint32_t out_size) {
+    const vfs_ops_t *ops;
+    int result = vfs_resolve(path, &ops, out, out_size);
+    if (result == VFS_OK && ops != fatfs_get_ops()) {
+        result = VFS_ERR_NOT_SUPPORTED;
+    }
+    return result;
+}
+
+void handle_frag_command(const char *args) {
+    if (!fat_ready) {
+        console_print("Filesystem not initialized\n");
+        return;
+    }
+    const char *cursor = args;
+    char name_buf[VFS_PATH_MAX];
+    if (read_token(&cursor, name_buf, sizeof(name_buf)) == 0) {
+        console_print("Usage: frag FILE\n");
+        return;
+    }
+    char fat_path[VFS_PATH_MAX];
+    fat12_frag_info_t info;
+    int result = resolve_fat_path(name_buf, fat_path, sizeof(fat_path));
+    if (result == VFS_OK) {
+        result = fat12_get_fragmentation(fat_path, &info);
+    }
+    if (result != FAT12_OK) {
+        console_print("frag failed");
+        print_fs_error(result);
+        console_print("\n");
+        return;
+    }
+    console_print(name_buf);
+    console_print(": ");
+    print_unsigned(info.clusters);
+    console_print(" clusters in ");
+    print_unsigned(info.extents);
+    console_print(" extent(s), largest run ");
+    print_unsigned(info.largest_run);
+    console_print(" clusters\n");
+}
+
+void handle_defrag_command(const char *args) {
+    if (!fat_ready) {
+        console_print("Filesystem not initialized\n");
+        return;
+    }
+    const char *cursor = args;
+    char name_buf[VFS_PATH_MAX];
+    int has_name = read_token(&cursor, name_buf, sizeof(name_buf)) != 0;
+    char fat_path[VFS_PATH_MAX];
+    fat12_defrag_stats_t stats;
+    int result = VFS_OK;
+    if (has_name) {
+        result = resolve_fat_path(name_buf, fat_path, sizeof(fat_path));
+    }
+    if (result == VFS_OK) {
+        result = fat12_defragment(has_name ? fat_path : 0, &stats);
+    }
+    if (result != FAT12_OK) {
+        console_print("defrag failed");
+        print_fs_error(result);
+        console_print("\n");
+        return;
+    }
+    console_print("Checked ");
+    print_unsigned(stats.files_checked);
+    console_print(" file(s), moved ");
+    print_unsigned(stats.files_moved);
+    console_print(" (");
+    print_unsigned(stats.clusters_moved);
+    console_print(" clusters)");
+    if (stats.files_skipped > 0) {
+        console_print(", skipped ");
+        print_unsigned(stats.files_skipped);
+    }
+    console_print("\n");
+}
+
+void handle_mount_command(void) {
+    int count = vfs_mount_count();
+    if (count == 0) {
+        console_print("No filesystems mounted\n");
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        const char *path;
+        const vfs_ops_t *ops;
+        vfs_get_mount(i, &path, &ops);
+        console_print(ops->name);
+        console_print(" on ");
+        console_print(path);
+        if (ops == ramfs_get_ops()) {
+            ramfs_usage_t usage;
+            ramfs_get_usage(&usage);
+            console_print(" (");
+            print_unsigned((usage.blocks_used * usage.block_size) / 1024);
+            console_print(" of ");
+            print_unsigned((usage.total_blocks * usage.block_size) / 1024);
+            console_print(" KB used)");
+        }
+        console_print("\n");
+    }
 }
 
 void handle_theme_command(const char *args) {
@@ -686,6 +1324,18 @@ void execute_command(const char *cmd_line) {
                (cmd_line[5] == '\0' || cmd_line[5] == ' ' || cmd_line[5] == '\n')) {
         const char *args = cmd_line + 5;
         handle_write_command(args);
+    } else if (strncmp_impl(cmd_line, "append", 6) == 0 &&
+               (cmd_line[6] == '\0' || cmd_line[6] == ' ' || cmd_line[6] == '\n')) {
+        const char *args = cmd_line + 6;
+        handle_append_command(args);
+    } else if (strncmp_impl(cmd_line, "frag", 4) == 0 &&
+               (cmd_line[4] == '\0' || cmd_line[4] == ' ' || cmd_line[4] == '\n')) {
+        const char *args = cmd_line + 4;
+        handle_frag_command(args);
+    } else if (strncmp_impl(cmd_line, "defrag", 6) == 0 &&
+               (cmd_line[6] == '\0' || cmd_line[6] == ' ' || cmd_line[6] == '\n')) {
+        const char *args = cmd_line + 6;
+        handle_defrag_command(args);
     } else if (strncmp_impl(cmd_line, "mkdir", 5) == 0 &&
                (cmd_line[5] == '\0' || cmd_line[5] == ' ' || cmd_line[5] == '\n')) {
         const char *args = cmd_line + 5;
@@ -698,6 +1348,9 @@ void execute_command(const char *cmd_line) {
                (cmd_line[4] == '\0' || cmd_line[4] == ' ' || cmd_line[4] == '\n')) {
         const char *args = cmd_line + 4;
         handle_nano_command(args);
+    } else if (strncmp_impl(cmd_line, "mount", 5) == 0 &&
+               (cmd_line[5] == '\0' || cmd_line[5] == ' ' || cmd_line[5] == '\n')) {
+        handle_mount_command();
     } else if (strncmp_impl(cmd_line, "theme", 5) == 0 &&
                (cmd_line[5] == '\0' || cmd_line[5] == ' ' || cmd_line[5] == '\n')) {
         const char *args = cmd_line + 5;
@@ -705,6 +1358,26 @@ void execute_command(const char *cmd_line) {
     } else if (strncmp_impl(cmd_line, "fsstat", 6) == 0 &&
                (cmd_line[6] == '\0' || cmd_line[6] == ' ' || cmd_line[6] == '\n')) {
         handle_fsstat_command();
+    } else if (strncmp_impl(cmd_line, "meminfo", 7) == 0 &&
+               (cmd_line[7] == '\0' || cmd_line[7] == ' ' || cmd_line[7] == '\n')) {
+        handle_meminfo_command();
+    } else if (strncmp_impl(cmd_line, "uptime", 6) == 0 &&
+               (cmd_line[6] == '\0' || cmd_line[6] == ' ' || cmd_line[6] == '\n')) {
+        handle_uptime_command();
+    } else if (strncmp_impl(cmd_line, "time", 4) == 0 &&
+               (cmd_line[4] == '\0' || cmd_line[4] == ' ' || cmd_line[4] == '\n')) {
+        const char *args = cmd_line + 4;
+        handle_time_command(args);
+    } else if (strncmp_impl(cmd_line, "sleep", 5) == 0 &&
+               (cmd_line[5] == '\0' || cmd_line[5] == ' ' || cmd_line[5] == '\n')) {
+        const char *args = cmd_line + 5;
+        handle_sleep_command(args);
+    } else if (strncmp_impl(cmd_line, "idlestat", 8) == 0 &&
+               (cmd_line[8] == '\0' || cmd_line[8] == ' ' || cmd_line[8] == '\n')) {
+        handle_idlestat_command();
+    } else if (strncmp_impl(cmd_line, "df", 2) == 0 &&
+               (cmd_line[2] == '\0' || cmd_line[2] == ' ' || cmd_line[2] == '\n')) {
+        handle_df_command();
     } else if (strncmp_impl(cmd_line, "shutdown", 8) == 0 && 
                (cmd_line[8] == '\0' || cmd_line[8] == ' ' || cmd_line[8] == '\n')) {
         handle_shutdown();
@@ -722,4 +1395,5 @@ void execute_command(const char *cmd_line) {
         console_print(cmd_line);
         console_print("\n");
     }
+    arena_reset(&scratch_arena);
 }
@@ -2,7 +2,8 @@
 #include "../include/shell/commands.h"
 #include "../include/drivers/console.h"
 #include "../include/drivers/keyboard.h"
-#include "../fat12.h"
+#include "../include/fs/vfs.h"
+#include "../include/kernel/heap.h"
 
 static nano_state_t nano_state = {0};
 
@@ -22,7 +23,21 @@ int nano_is_active(void) {
     return nano_state.editor_active;
 }
 
-void nano_init_editor(const char *filename) {
+static void nano_free_buffers(void) {
+    kfree(nano_state.lines);
+    kfree(nano_state.line_lengths);
+    nano_state.lines = 0;
+    nano_state.line_lengths = 0;
+}
+
+int nano_init_editor(const char *filename) {
+    uint8_t *fs_io_buffer = commands_get_io_buffer();
+    nano_state.lines = (char (*)[NANO_MAX_LINE_LENGTH])kmalloc(NANO_MAX_LINES * NANO_MAX_LINE_LENGTH);
+    nano_state.line_lengths = (int *)kmalloc(NANO_MAX_LINES * sizeof(int));
+    if (!fs_io_buffer || !nano_state.lines || !nano_state.line_lengths) {
+        nano_free_buffers();
+        return -1;
+    }
     strcpy_impl(nano_state.filename, filename);
     nano_state.total_lines = 0;
     nano_state.cursor_x = 0;
@@ -40,10 +55,9 @@ void nano_init_editor(const char *filename) {
     }
     
     uint32_t file_size = 0;
-    uint8_t *fs_io_buffer = commands_get_io_buffer();
-    int result = fat12_read_file(filename, fs_io_buffer, FS_IO_BUFFER_SIZE - 1, &file_size);
+    int result = vfs_read_file(filename, fs_io_buffer, FS_IO_BUFFER_SIZE - 1, &file_size);
     
-    if (result == FAT12_OK && file_size > 0) {
+    if (result == VFS_OK && file_size > 0) {
         int line = 0;
         int line_pos = 0;
         
@@ -75,6 +89,7 @@ void nano_init_editor(const char *filename) {
     
     vga_clear();
     nano_render_editor();
+    return 0;
 }
 
 void nano_render_editor(void) {
@@ -464,8 +479,8 @@ int nano_save_file(void) {
         }
     }
     
-    int result = fat12_write_file(nano_state.filename, fs_io_buffer, file_size);
-    if (result == FAT12_OK) {
+    int result = vfs_write_file(nano_state.filename, fs_io_buffer, file_size);
+    if (result == VFS_OK) {
         nano_state.dirty = 0;
         return 1;
     }
@@ -488,6 +503,7 @@ void nano_exit_editor(int save_action) {
     nano_state.editor_active = 0;
     nano_state.prompt_state = NANO_PROMPT_NONE;
     nano_state.help_overlay_visible = 0;
+    nano_free_buffers();
     
     vga_clear();
     console_print("Welcome to AltoniumOS 1.0.0\n\n");
@@ -502,9 +518,9 @@ void nano_exit_editor(int save_action) {
         console_print("\n");
     }
     
-    if (commands_is_fat_ready()) {
+    if (vfs_is_ready()) {
         console_print("Current directory: ");
-        console_print(fat12_get_cwd());
+        console_print(vfs_getcwd());
         console_print("\n");
     }
 }
@@ -644,3 +660,14 @@ void nano_set_status_message(const char *msg) {
 void nano_reset_status_message(void) {
     nano_state.status_message[0] = '\0';
 }
+
+void nano_get_footprint(uint32_t *static_bytes, uint32_t *heap_bytes) {
+    *static_bytes = sizeof(nano_state);
+    *heap_bytes = 0;
+    if (nano_state.lines) {
+        *heap_bytes += NANO_MAX_LINES * NANO_MAX_LINE_LENGTH;
+    }
+    if (nano_state.line_lengths) {
+        *heap_bytes += NANO_MAX_LINES * sizeof(int);
+    }
+}
@@ -0,0 +1,73 @@
+#!/bin/bash
+# Benchmark the FAT driver on a multi-GB FAT32 volume
+
+set -e
+
+IMAGE=${1:-/tmp/altonium_fat32.img}
+SIZE_MB=${SIZE_MB:-4096}
+
+echo "=== AltoniumOS FAT32 Benchmark ==="
+echo
+
+if [ ! -f dist/kernel.elf ]; then
+    echo "Error: Build artifacts missing. Run 'make build' first."
+    exit 1
+fi
+
+if ! command -v mkfs.fat >/dev/null 2>&1; then
+    echo "Error: mkfs.fat not found (install dosfstools)."
+    exit 1
+fi
+
+# Sparse image: only the metadata mkfs writes takes real disk space
+rm -f "$IMAGE"
+truncate -s "${SIZE_MB}M" "$IMAGE"
+mkfs.fat -F 32 -s 8 -n ALTONIUM "$IMAGE" >/dev/null
+echo "✓ Created ${SIZE_MB} MB FAT32 image at $IMAGE"
+
+# Seed a large file when mtools is available so reads have something to chew on
+if command -v mcopy >/dev/null 2>&1; then
+    head -c $((16 * 1024 * 1024)) /dev/urandom > /tmp/altonium_seed.bin
+    mcopy -i "$IMAGE" /tmp/altonium_seed.bin ::SEED.BIN
+    rm -f /tmp/altonium_seed.bin
+    echo "✓ Copied 16 MB SEED.BIN onto the volume"
+fi
+echo
+
+cat > /tmp/test_fat32_commands.txt <<'EOF2'
+df
+fsstat
+ls
+cat SEED.BIN
+fsstat
+mkdir DATA
+cd DATA
+write A.TXT Hello FAT32
+ls
+cd ..
+df
+fsstat
+EOF2
+
+echo "Benchmark command sequence:"
+echo "---------------------------"
+cat /tmp/test_fat32_commands.txt
+echo "---------------------------"
+echo
+
+echo "To run the benchmark:"
+echo "1. Start QEMU with:"
+echo "   qemu-system-i386 -kernel dist/kernel.elf -drive format=raw,file=$IMAGE,if=ide"
+echo
+echo "2. Type the commands listed above and compare:"
+echo "   - 'df' should report FAT32 and the full volume size"
+echo "   - 'fsstat' mount reads show the one-off FAT scan cost"
+echo "   - FAT cache hit rate should stay high while streaming SEED.BIN"
+echo
+
+echo "=== Quick QEMU test (5 seconds) ==="
+timeout 5 qemu-system-i386 -kernel dist/kernel.elf -drive format=raw,file="$IMAGE",if=ide -nographic -serial mon:stdio 2>&1 | head -30 || true
+
+echo
+echo "=== Test Complete ==="
+echo "Image left at $IMAGE for manual runs."